@@ -0,0 +1,177 @@
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+
+#include "ContentHashCache.h"
+
+#include "Logging.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#ifndef Q_OS_WIN
+#include <sys/stat.h>
+#endif
+
+namespace {
+constexpr quint32 fileMagic = 0x4B444843; // "KDHC"
+constexpr quint32 fileVersion = 2;
+// Files written less than this long ago may still change without a new modification time.
+constexpr qint64 settleTime = 2000000000;
+// A cache that was only read is written again once the use times it holds are older than this.
+constexpr qint64 useTimeResolution = 24 * 3600 * 1000;
+} // namespace
+
+ContentHashCache& ContentHashCache::instance()
+{
+    static ContentHashCache cache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/filehashes"));
+    return cache;
+}
+
+std::optional<ContentHashCache::Key> ContentHashCache::keyOf(const QString& path)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(path);
+    return {};
+#else
+    struct stat st;
+    if(::stat(QFile::encodeName(path).constData(), &st) != 0 || !S_ISREG(st.st_mode))
+        return {};
+
+#ifdef Q_OS_MACOS
+    const timespec& modified = st.st_mtimespec;
+    const timespec& changed = st.st_ctimespec;
+#else
+    const timespec& modified = st.st_mtim;
+    const timespec& changed = st.st_ctim;
+#endif
+    return Key{(quint64)st.st_dev, (quint64)st.st_ino, (qint64)st.st_size, (qint64)modified.tv_sec * 1000000000 + modified.tv_nsec,
+               (qint64)changed.tv_sec * 1000000000 + changed.tv_nsec};
+#endif
+}
+
+std::optional<QByteArray> ContentHashCache::find(const Key& key)
+{
+    QMutexLocker locker(&mMutex);
+    load();
+
+    const auto it = mEntries.find(key);
+    if(it == mEntries.end())
+        return {};
+
+    use(it->second);
+    return it->second.hash;
+}
+
+void ContentHashCache::insert(const Key& key, const QByteArray& hash)
+{
+    if(QDateTime::currentMSecsSinceEpoch() * 1000000 - std::max(key.modified, key.changed) < settleTime)
+        return;
+
+    QMutexLocker locker(&mMutex);
+    load();
+
+    Entry& entry = mEntries[key];
+    if(entry.hash != hash)
+    {
+        entry.hash = hash;
+        mbModified = true;
+    }
+    use(entry);
+}
+
+void ContentHashCache::use(Entry& entry)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if(now - entry.lastUsed > useTimeResolution)
+        mbModified = true;
+    entry.lastUsed = now;
+}
+
+void ContentHashCache::load()
+{
+    if(mbLoaded)
+        return;
+    mbLoaded = true;
+
+    QFile file(mFileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return;
+
+    QDataStream stream(&file);
+    quint32 magic = 0, version = 0, hashAlgorithm = 0;
+    quint64 count = 0;
+    stream >> magic >> version >> hashAlgorithm >> count;
+    // Anything else is started over, the cache only saves time.
+    if(magic != fileMagic || version != fileVersion || hashAlgorithm != (quint32)algorithm)
+        return;
+
+    mEntries.reserve(std::min<quint64>(count, mMaxEntries));
+    for(quint64 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+    {
+        Key key;
+        Entry entry;
+        stream >> key.device >> key.inode >> key.size >> key.modified >> key.changed >> entry.hash >> entry.lastUsed;
+        if(stream.status() == QDataStream::Ok)
+            mEntries[key] = entry;
+    }
+
+    if(stream.status() != QDataStream::Ok)
+    {
+        qCWarning(kdiffMergeFileInfo) << "Ignoring damaged hash cache" << mFileName;
+        mEntries.clear();
+    }
+}
+
+bool ContentHashCache::save()
+{
+    QMutexLocker locker(&mMutex);
+    if(!mbModified)
+        return true;
+
+    if(mEntries.size() > (size_t)mMaxEntries)
+    {
+        // Keep the most recently used ones.
+        std::vector<decltype(mEntries)::iterator> byUse;
+        byUse.reserve(mEntries.size());
+        for(auto it = mEntries.begin(); it != mEntries.end(); ++it)
+            byUse.push_back(it);
+        std::nth_element(byUse.begin(), byUse.begin() + mMaxEntries, byUse.end(), [](const auto& a, const auto& b) { return a->second.lastUsed > b->second.lastUsed; });
+        std::for_each(byUse.begin() + mMaxEntries, byUse.end(), [this](const auto& it) { mEntries.erase(it); });
+    }
+
+    QDir().mkpath(QFileInfo(mFileName).absolutePath());
+    QSaveFile file(mFileName);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        qCWarning(kdiffMergeFileInfo) << "Unable to write hash cache" << mFileName << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << fileMagic << fileVersion << (quint32)algorithm << (quint64)mEntries.size();
+    for(const auto& [key, entry]: mEntries)
+        stream << key.device << key.inode << key.size << key.modified << key.changed << entry.hash << entry.lastUsed;
+
+    if(!file.commit())
+    {
+        qCWarning(kdiffMergeFileInfo) << "Unable to write hash cache" << mFileName << file.errorString();
+        return false;
+    }
+
+    mbModified = false;
+    return true;
+}
@@ -0,0 +1,95 @@
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+
+#ifndef CONTENTHASHCACHE_H
+#define CONTENTHASHCACHE_H
+
+#include <functional>
+#include <optional>
+#include <unordered_map>
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QMutex>
+#include <QString>
+
+/*
+    Remembers a strong hash of the content of local files across runs, so the binary comparison of a folder
+    only reads files that changed since the last time.
+
+    A file is identified by device, inode, size, modification time and status change time. Any write changes the
+    status change time, also when a tool sets the modification time back, so a file with an unchanged key still has
+    the content that was hashed. Files modified in the last few seconds are not remembered, a second write might not
+    change the times on file systems with coarse timestamps.
+
+    All functions may be called from any thread.
+*/
+class ContentHashCache
+{
+  public:
+    struct Key {
+        quint64 device = 0;
+        quint64 inode = 0;
+        qint64 size = 0;
+        // Nanoseconds since the epoch.
+        qint64 modified = 0;
+        qint64 changed = 0;
+
+        bool operator==(const Key& other) const
+        {
+            return device == other.device && inode == other.inode && size == other.size && modified == other.modified && changed == other.changed;
+        }
+        bool operator!=(const Key& other) const { return !(*this == other); }
+    };
+
+    static constexpr QCryptographicHash::Algorithm algorithm = QCryptographicHash::Blake2b_256;
+    // The least recently used entries are dropped when saving a cache larger than this.
+    static constexpr qsizetype defaultMaxEntries = 250000;
+
+    // The cache kept under the user's cache folder.
+    [[nodiscard]] static ContentHashCache& instance();
+
+    explicit ContentHashCache(const QString& fileName, const qsizetype maxEntries = defaultMaxEntries): mFileName(fileName), mMaxEntries(maxEntries) {}
+
+    // Returns nothing for anything but a regular local file and on platforms without inodes.
+    [[nodiscard]] static std::optional<Key> keyOf(const QString& path);
+
+    [[nodiscard]] std::optional<QByteArray> find(const Key& key);
+    // Ignored for files modified just now.
+    void insert(const Key& key, const QByteArray& hash);
+
+    // Writes the cache if anything was added since it was loaded or the use times it holds are outdated.
+    bool save();
+
+  private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const
+        {
+            return std::hash<quint64>()(key.inode) ^ (std::hash<qint64>()(key.modified) << 1) ^ (std::hash<quint64>()(key.device) << 2) ^
+                   (std::hash<qint64>()(key.changed) << 3);
+        }
+    };
+
+    struct Entry {
+        QByteArray hash;
+        // Milliseconds since the epoch.
+        qint64 lastUsed = 0;
+    };
+
+    void load();
+    void use(Entry& entry);
+
+    QString mFileName;
+    qsizetype mMaxEntries;
+    QMutex mMutex;
+    bool mbLoaded = false;
+    bool mbModified = false;
+    std::unordered_map<Key, Entry, KeyHash> mEntries;
+};
+
+#endif /* CONTENTHASHCACHE_H */
@@ -40,7 +40,7 @@ class EncodedData: public QByteArray
 
     char curData = '\0';
     QByteArray mBuf = QByteArray::fromRawData(&curData, sizeof(curData));
-    QByteArray::iterator it = end();
+    QByteArray::const_iterator it = cend();
 
   public:
     using QByteArray::QByteArray;
@@ -48,7 +48,7 @@ class EncodedData: public QByteArray
     EncodedData(const QByteArray &a):
         QByteArray(a)
     {
-        it = begin();
+        it = cbegin();
     }
 
     EncodedData(const MergeBlockList &mbl, const QString &lineFeed, const QByteArray &inEncoding)
@@ -82,7 +82,7 @@ class EncodedData: public QByteArray
             }
         }
 
-        it = begin();
+        it = cbegin();
     }
 
     void setGenerateByteOrderMark(bool generate) { mGenerateBOM = generate; }
@@ -123,7 +123,7 @@ class EncodedData: public QByteArray
         */
         do
         {
-            if(it == end())
+            if(it == cend())
                 break;
 
             len++;
@@ -140,10 +140,32 @@ class EncodedData: public QByteArray
         return len;
     }
 
+    /*
+        Decode everything from the current read position in one go. This avoids the per byte decoder calls readNext
+        needs and is the fast path for well formed input. Nothing is consumed if the data can not be decoded cleanly,
+        callers are expected to fall back to readNext in that case so errors are reported one char at a time.
+    */
+    bool readAll(QString &s)
+    {
+        if(!mDecoder.isValid()) return false;
+
+        //Stateless makes the decoder report a truncated sequence at the end of input as an error.
+        QStringDecoder decoder = QStringDecoder(mEncoding, (mGenerateBOM ? QStringConverter::Flag::WriteBom : QStringConverter::Flag::ConvertInitialBom) | QStringConverter::Flag::Stateless);
+        s = decoder(QByteArrayView(it, cend()));
+        if(decoder.hasError())
+        {
+            s.clear();
+            return false;
+        }
+
+        it = cend();
+        return true;
+    }
+
     quint64 peekChar(QString &s)
     {
         QStringDecoder decoder = QStringDecoder(mEncoding);
-        qsizetype dis = std::distance(it, end());
+        qsizetype dis = std::distance(it, cend());
         qsizetype len = std::min<qsizetype>(4, dis);
         /*
             This assumes EncodedDataStream is contiguous.
@@ -176,7 +198,7 @@ class EncodedData: public QByteArray
     }
 
     [[nodiscard]] bool hasError() const { return mError; }
-    [[nodiscard]] bool atEnd() const { return it == end(); }
+    [[nodiscard]] bool atEnd() const { return it == cend(); }
 
   private:
     quint64 writeString(const QString &s)
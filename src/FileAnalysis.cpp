@@ -0,0 +1,165 @@
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+
+#include "FileAnalysis.h"
+
+#include "diff.h"
+#include "Logging.h"
+#include "MergeEditLine.h"
+#include "options.h"
+#include "SourceData.h"
+
+#include <array>
+#include <exception>
+#include <memory>
+#include <new>
+
+#include <KLocalizedString>
+
+bool FileAnalysis::isPossible()
+{
+    return gOptions->m_PreProcessorCmd.isEmpty() && gOptions->m_LineMatchingPreProcessorCmd.isEmpty() &&
+           !gOptions->m_bRunHistoryAutoMergeOnMergeStart && !gOptions->m_bRunRegExpAutoMergeOnMergeStart;
+}
+
+/*
+    Follows KDiff3App::mainInit() for loading files with automatic solving, up to what MergeResultWindow::merge()
+    counts. The three diffs run one after the other, analysing several files at once keeps the cores busy.
+*/
+void FileAnalysis::analyse(const QString& fileNameA, const QString& fileNameB, const QString& fileNameC, TotalDiffStatus& status, QStringList& errors)
+{
+    const std::array<std::shared_ptr<SourceData>, 3> sources = {std::make_shared<SourceData>(), std::make_shared<SourceData>(), std::make_shared<SourceData>()};
+    const std::array<QByteArray, 3> encodings = {gOptions->mEncodingA, gOptions->mEncodingB, gOptions->mEncodingC};
+    const std::array<bool, 3> autoDetect = {gOptions->mAutoDetectA, gOptions->mAutoDetectB, gOptions->mAutoDetectC};
+    const std::shared_ptr<SourceData>& sdA = sources[0];
+    const std::shared_ptr<SourceData>& sdB = sources[1];
+    const std::shared_ptr<SourceData>& sdC = sources[2];
+
+    IgnoreFlags eIgnoreFlags = IgnoreFlag::none;
+    if(gOptions->ignoreComments())
+        eIgnoreFlags |= IgnoreFlag::ignoreComments;
+
+    if(gOptions->whiteSpaceIsEqual())
+        eIgnoreFlags |= IgnoreFlag::ignoreWhiteSpace;
+
+    sdA->setFilename(fileNameA);
+    sdB->setFilename(fileNameB);
+    sdC->setFilename(fileNameC);
+
+    const bool bTripleDiff = !sdC->isEmpty();
+    for(size_t i = 0; i < (bTripleDiff ? 3 : 2); ++i)
+        sources[i]->readAndPreprocess(encodings[i], autoDetect[i]);
+
+    QStringList fileErrors = sdA->getErrors() + sdB->getErrors();
+    status.reset();
+
+    ManualDiffHelpList manualDiffHelpList;
+    Diff3LineList diff3LineList;
+    if(fileErrors.isEmpty())
+    {
+        try
+        {
+            if(!bTripleDiff)
+            {
+                status.setBinaryEqualAB(sdA->isBinaryEqualWith(sdB));
+
+                if(sdA->isText() && sdB->isText())
+                {
+                    DiffList diffListAB;
+                    manualDiffHelpList.runDiff(sdA->getLineDataForDiff(), sdA->lineCount(), sdB->getLineDataForDiff(), sdB->lineCount(), diffListAB, e_SrcSelector::A, e_SrcSelector::B, nullptr);
+                    diff3LineList.calcDiff3LineListUsingAB(&diffListAB);
+
+                    Diff3LineVector d3lv;
+                    diff3LineList.calcDiff3LineVector(d3lv);
+                    status.setTextEqualAB(diff3LineList.fineDiffForStatus(d3lv, e_SrcSelector::A, sdA->getLineDataForDisplay(), sdB->getLineDataForDisplay(), eIgnoreFlags));
+                    if(sdA->getSizeBytes() == 0) status.setTextEqualAB(false);
+                }
+            }
+            else
+            {
+                status.setBinaryEqualAB(sdA->isBinaryEqualWith(sdB));
+                status.setBinaryEqualAC(sdA->isBinaryEqualWith(sdC));
+                status.setBinaryEqualBC(sdC->isBinaryEqualWith(sdB));
+
+                const bool bTextAB = sdA->isText() && sdB->isText();
+                const bool bTextAC = sdA->isText() && sdC->isText();
+                const bool bTextBC = sdB->isText() && sdC->isText();
+
+                DiffList diffListAB, diffListAC, diffListBC;
+                if(bTextAB)
+                    manualDiffHelpList.runDiff(sdA->getLineDataForDiff(), sdA->lineCount(), sdB->getLineDataForDiff(), sdB->lineCount(), diffListAB, e_SrcSelector::A, e_SrcSelector::B, nullptr);
+                if(bTextAC)
+                    manualDiffHelpList.runDiff(sdA->getLineDataForDiff(), sdA->lineCount(), sdC->getLineDataForDiff(), sdC->lineCount(), diffListAC, e_SrcSelector::A, e_SrcSelector::C, nullptr);
+                if(bTextBC)
+                    manualDiffHelpList.runDiff(sdB->getLineDataForDiff(), sdB->lineCount(), sdC->getLineDataForDiff(), sdC->lineCount(), diffListBC, e_SrcSelector::B, e_SrcSelector::C, nullptr);
+
+                if(bTextAB)
+                    diff3LineList.calcDiff3LineListUsingAB(&diffListAB);
+
+                if(bTextAC)
+                {
+                    diff3LineList.calcDiff3LineListUsingAC(&diffListAC);
+                    diff3LineList.correctManualDiffAlignment(&manualDiffHelpList);
+                    diff3LineList.calcDiff3LineListTrim(sdA->getLineDataForDiff(), sdB->getLineDataForDiff(), sdC->getLineDataForDiff(), &manualDiffHelpList);
+                }
+
+                if(bTextBC && gOptions->m_bDiff3AlignBC)
+                {
+                    diff3LineList.calcDiff3LineListUsingBC(&diffListBC);
+                    diff3LineList.correctManualDiffAlignment(&manualDiffHelpList);
+                    diff3LineList.calcDiff3LineListTrim(sdA->getLineDataForDiff(), sdB->getLineDataForDiff(), sdC->getLineDataForDiff(), &manualDiffHelpList);
+                }
+
+                Diff3LineVector d3lv;
+                diff3LineList.calcDiff3LineVector(d3lv);
+
+                if(sdA->hasData() && sdB->hasData() && sdA->isText() && sdB->isText())
+                    status.setTextEqualAB(diff3LineList.fineDiffForStatus(d3lv, e_SrcSelector::A, sdA->getLineDataForDisplay(), sdB->getLineDataForDisplay(), eIgnoreFlags));
+                if(sdB->hasData() && sdC->hasData() && sdB->isText() && sdC->isText())
+                    status.setTextEqualBC(diff3LineList.fineDiffForStatus(d3lv, e_SrcSelector::B, sdB->getLineDataForDisplay(), sdC->getLineDataForDisplay(), eIgnoreFlags));
+                if(sdA->hasData() && sdC->hasData() && sdA->isText() && sdC->isText())
+                    status.setTextEqualAC(diff3LineList.fineDiffForStatus(d3lv, e_SrcSelector::C, sdC->getLineDataForDisplay(), sdA->getLineDataForDisplay(), eIgnoreFlags));
+
+                if(sdA->getSizeBytes() == 0)
+                {
+                    status.setTextEqualAB(false);
+                    status.setTextEqualAC(false);
+                }
+                if(sdB->getSizeBytes() == 0)
+                {
+                    status.setTextEqualAB(false);
+                    status.setTextEqualBC(false);
+                }
+
+                fileErrors.append(sdC->getErrors());
+            }
+        }
+        catch(const std::bad_alloc&)
+        {
+            fileErrors.append(i18nc("Error message", "Not enough memory to complete request."));
+        }
+        catch(const std::exception& e)
+        {
+            qCCritical(kdiffMain) << "An internal error occurred:" << e.what();
+
+            fileErrors.append(i18n("An internal error occurred: %1", QString::fromStdString(e.what())));
+        }
+    }
+
+    if(fileErrors.isEmpty() && sdA->isText() && sdB->isText())
+    {
+        diff3LineList.calcWhiteDiff3Lines(sdA->getLineDataForDiff(), sdB->getLineDataForDiff(), sdC->getLineDataForDiff(), gOptions->ignoreComments());
+
+        // Automatic solving only changes which lines are picked, never the counts.
+        MergeBlockList mergeBlockList;
+        mergeBlockList.buildFromDiff3(diff3LineList, bTripleDiff);
+        mergeBlockList.countConflicts(status);
+    }
+
+    errors.append(fileErrors);
+}
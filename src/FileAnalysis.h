@@ -0,0 +1,37 @@
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+
+#ifndef FILEANALYSIS_H
+#define FILEANALYSIS_H
+
+#include <QString>
+#include <QStringList>
+
+class TotalDiffStatus;
+
+/*
+    Full analysis of two or three files without any widgets, as the directory comparison needs it.
+
+    Loads the files, runs the line diffs and the fine diffs and classifies the merge blocks like opening the files
+    in the main window would, then fills in a TotalDiffStatus. Nothing global is touched so any number of files
+    can be analysed at the same time, on any thread.
+*/
+class FileAnalysis
+{
+  public:
+    /*
+        Whether analyse() gets the same result as the main window with the current options. Preprocessor commands
+        and the automatic merges on merge start need the GUI thread.
+    */
+    [[nodiscard]] static bool isPossible();
+
+    // fileNameC is empty for two files. Errors are appended to errors.
+    static void analyse(const QString& fileNameA, const QString& fileNameB, const QString& fileNameC, TotalDiffStatus& status, QStringList& errors);
+};
+
+#endif /* FILEANALYSIS_H */
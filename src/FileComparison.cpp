@@ -0,0 +1,376 @@
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+
+#include "FileComparison.h"
+
+#include "ContentHashCache.h"
+#include "fileaccess.h"
+#include "Logging.h"
+#include "options.h"
+#include "ProgressProxy.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <QByteArrayView>
+#include <QCryptographicHash>
+#include <QFileInfo>
+
+#include <KLocalizedString>
+
+bool FileComparison::compare(FileAccess& fi1, FileAccess& fi2, bool& bError, QString& status)
+{
+    ProgressScope pp;
+    bool bEqual = false;
+
+    status = "";
+    bError = true;
+
+    qCDebug(kdiffMergeFileInfo) << "Entering FileComparison::compare";
+    if(fi1.isNormal() != fi2.isNormal())
+    {
+        qCDebug(kdiffMergeFileInfo) << "Have: \'" << fi2.fileName() << "\' , isNormal = " << fi2.isNormal();
+
+        status = i18n("Unable to compare non-normal file with normal file.");
+        return false;
+    }
+
+    if(!fi1.isNormal())
+    {
+        qCInfo(kdiffMergeFileInfo) << "Skipping not a normal file.";
+        bError = false;
+        return false;
+    }
+
+    if(!gOptions->m_bDmFollowFileLinks)
+    {
+        qCInfo(kdiffMergeFileInfo) << "Have: \'" << fi2.fileName() << "\' , isSymLink = " << fi2.isSymLink();
+        /*
+            "git difftool --dir-diff"
+            sets up directory comparisons with symlinks to the current work tree being compared with real files.
+
+            m_bAllowMismatch is a compatibility work around.
+        */
+        if(fi1.isSymLink() != fi2.isSymLink())
+        {
+            qCDebug(kdiffMergeFileInfo) << "Rejecting comparison of link to file. With the same relitive path.";
+            status = i18n("Mix of links and normal files.");
+            return bEqual;
+        }
+        else if(fi1.isSymLink() && fi2.isSymLink())
+        {
+            qCDebug(kdiffMergeFileInfo) << "Comparison of link to link. OK.";
+            bError = false;
+            bEqual = fi1.readLink() == fi2.readLink();
+            status = i18n("Link: ");
+            return bEqual;
+        }
+    }
+
+    if(fi1.size() != fi2.size())
+    {
+        qCInfo(kdiffMergeFileInfo) << "Sizes differ.";
+        bError = false;
+        bEqual = false;
+        status = i18n("Size. ");
+        return bEqual;
+    }
+    else if(gOptions->m_bDmTrustSize)
+    {
+        qCInfo(kdiffMergeFileInfo) << "Same size. Trusting result.";
+
+        bEqual = true;
+        bError = false;
+        return bEqual;
+    }
+
+    if(gOptions->m_bDmTrustDate)
+    {
+        bEqual = (fi1.lastModified() == fi2.lastModified() && fi1.size() == fi2.size());
+        bError = false;
+        status = i18n("Date & Size: ");
+        return bEqual;
+    }
+
+    if(gOptions->m_bDmTrustDateFallbackToBinary)
+    {
+        bEqual = (fi1.lastModified() == fi2.lastModified() && fi1.size() == fi2.size());
+        if(bEqual)
+        {
+            bError = false;
+            status = i18n("Date & Size: ");
+            return bEqual;
+        }
+    }
+
+    // Files seen before need no reading, see ContentHashCache.
+    std::optional<ContentHashCache::Key> key1, key2;
+    if(gOptions->m_bDmHashCache && fi1.isLocal() && fi2.isLocal())
+    {
+        key1 = ContentHashCache::keyOf(fi1.absoluteFilePath());
+        key2 = ContentHashCache::keyOf(fi2.absoluteFilePath());
+    }
+
+    std::optional<QCryptographicHash> hash1, hash2;
+    if(key1 && key2)
+    {
+        // The same file twice, through a hard link for example.
+        if(*key1 == *key2)
+        {
+            bError = false;
+            return true;
+        }
+
+        const std::optional<QByteArray> knownHash1 = ContentHashCache::instance().find(*key1);
+        const std::optional<QByteArray> knownHash2 = ContentHashCache::instance().find(*key2);
+        if(knownHash1 && knownHash2)
+        {
+            qCInfo(kdiffMergeFileInfo) << "Comparing known content hashes.";
+            bError = false;
+            status = i18n("Content hash: ");
+            return *knownHash1 == *knownHash2;
+        }
+
+        // Hashed while reading so the next comparison is faster.
+        hash1.emplace(ContentHashCache::algorithm);
+        hash2.emplace(ContentHashCache::algorithm);
+    }
+
+    const auto rememberHashes = [&]() {
+        // A file changed while reading has a new key by now.
+        if(hash1 && ContentHashCache::keyOf(fi1.absoluteFilePath()) == key1 && ContentHashCache::keyOf(fi2.absoluteFilePath()) == key2)
+        {
+            ContentHashCache::instance().insert(*key1, hash1->result());
+            ContentHashCache::instance().insert(*key2, hash2->result());
+        }
+    };
+
+    qCInfo(kdiffMergeFileInfo) << "Comparing files...";
+    ProgressProxy::setInformation(i18nc("Status message", "Comparing file..."), 0, false);
+    typedef qint64 t_FileSize;
+    t_FileSize fullSize = fi1.size();
+    t_FileSize sizeLeft = fullSize;
+
+    /*
+        Files of the same size that differ, like builds or archives, mostly do so close to the start, in the middle
+        or at the end. Comparing samples from there first rejects them after reading a few blocks.
+        Smaller files are simply read completely.
+    */
+    const t_FileSize sampleSize = 64 * 1024;
+    const bool bSample = fullSize >= 16 * sampleSize;
+    const std::array<t_FileSize, 3> sampleOffsets = {0, (fullSize - sampleSize) / 2, fullSize - sampleSize};
+    // Per file, for the status.
+    t_FileSize bytesRead = 0;
+
+    const auto samplesDiffer = [&]() {
+        qCInfo(kdiffMergeFileInfo) << "Samples differ after reading" << bytesRead << "bytes.";
+        status = i18n("Samples of start, middle and end, %1 bytes of each file read: ", bytesRead);
+        bError = false;
+    };
+    const auto contentCompared = [&]() {
+        status = bSample ? i18n("All content after matching samples, %1 bytes of each file read: ", bytesRead) : i18n("All content, %1 bytes of each file read: ", bytesRead);
+    };
+
+    /*
+        Local files are compared in place instead of being copied through buffers. Reading a mapping past the end
+        of a file truncated meanwhile raises SIGBUS, so the sizes are checked before each block and files that
+        change are read through buffers instead. That leaves only a truncation between check and read.
+    */
+    const auto sizesUnchanged = [&]() {
+        return QFileInfo(fi1.absoluteFilePath()).size() == fullSize && QFileInfo(fi2.absoluteFilePath()).size() == fullSize;
+    };
+    // Sampling jumps around, read ahead would only fetch data not compared.
+    const std::shared_ptr<const FileMapping> mapping1 = fi1.mapForReading(!bSample);
+    const std::shared_ptr<const FileMapping> mapping2 = mapping1 != nullptr ? fi2.mapForReading(!bSample) : nullptr;
+    bool bMapped = mapping2 != nullptr && mapping1->size() == fullSize && mapping2->size() == fullSize && sizesUnchanged();
+    if(bMapped && bSample)
+    {
+        for(const t_FileSize offset: sampleOffsets)
+        {
+            if(!sizesUnchanged())
+            {
+                bMapped = false;
+                break;
+            }
+
+            bytesRead += sampleSize;
+            if(memcmp(mapping1->data() + offset, mapping2->data() + offset, sampleSize) != 0)
+            {
+                samplesDiffer();
+                return bEqual;
+            }
+        }
+    }
+
+    if(bMapped)
+    {
+        // Small enough to stop soon after the first difference.
+        const t_FileSize blockSize = 1024 * 1024;
+        ProgressProxy::setMaxNofSteps(fullSize / blockSize);
+
+        while(sizeLeft > 0 && !ProgressProxy::wasCancelled())
+        {
+            if(!sizesUnchanged())
+            {
+                bMapped = false;
+                break;
+            }
+
+            const t_FileSize offset = fullSize - sizeLeft;
+            const qint64 len = std::min(sizeLeft, blockSize);
+            const char* data1 = mapping1->data() + offset;
+            const char* data2 = mapping2->data() + offset;
+
+            if(hash1)
+            {
+                hash1->addData(QByteArrayView(data1, len));
+                hash2->addData(QByteArrayView(data2, len));
+            }
+
+            bytesRead += len;
+            if(memcmp(data1, data2, len) != 0)
+            {
+                if(len == sizeLeft)
+                    rememberHashes();
+
+                contentCompared();
+                bError = false;
+                return bEqual;
+            }
+            sizeLeft -= len;
+            ProgressProxy::step();
+        }
+    }
+
+    if(!bMapped)
+    {
+        if(mapping2 != nullptr)
+        {
+            qCInfo(kdiffMergeFileInfo) << "File changed while comparing, reading it instead.";
+            sizeLeft = fullSize;
+            bytesRead = 0;
+            if(hash1)
+            {
+                hash1->reset();
+                hash2->reset();
+            }
+        }
+
+        std::vector<char> buf1(100000);
+        std::vector<char> buf2(buf1.size());
+
+        if(!fi1.open(QIODevice::ReadOnly))
+        {
+            status = fi1.errorString();
+            return bEqual;
+        }
+
+        if(!fi2.open(QIODevice::ReadOnly))
+        {
+            fi1.close();
+            status = fi2.errorString();
+            return bEqual;
+        }
+
+        const auto readBlocks = [&](const qint64 len) {
+            if(len != fi1.read(&buf1[0], len))
+            {
+                status = fi1.errorString();
+                return false;
+            }
+
+            if(len != fi2.read(&buf2[0], len))
+            {
+                status = fi2.errorString();
+                return false;
+            }
+
+            bytesRead += len;
+            return true;
+        };
+
+        if(bSample)
+        {
+            for(const t_FileSize offset: sampleOffsets)
+            {
+                if(!fi1.seek(offset) || !fi2.seek(offset) || !readBlocks(sampleSize))
+                {
+                    status = !fi1.errorString().isEmpty() ? fi1.errorString() : fi2.errorString();
+                    fi1.close();
+                    fi2.close();
+                    return bEqual;
+                }
+
+                if(memcmp(&buf1[0], &buf2[0], sampleSize) != 0)
+                {
+                    samplesDiffer();
+                    fi1.close();
+                    fi2.close();
+                    return bEqual;
+                }
+            }
+
+            if(!fi1.seek(0) || !fi2.seek(0))
+            {
+                status = !fi1.errorString().isEmpty() ? fi1.errorString() : fi2.errorString();
+                fi1.close();
+                fi2.close();
+                return bEqual;
+            }
+        }
+
+        ProgressProxy::setMaxNofSteps(fullSize / buf1.size());
+
+        while(sizeLeft > 0 && !ProgressProxy::wasCancelled())
+        {
+            qint64 len = std::min(sizeLeft, (t_FileSize)buf1.size());
+            if(!readBlocks(len))
+            {
+                fi1.close();
+                fi2.close();
+                return bEqual;
+            }
+
+            if(hash1)
+            {
+                hash1->addData(QByteArrayView(buf1.data(), len));
+                hash2->addData(QByteArrayView(buf2.data(), len));
+            }
+
+            if(memcmp(&buf1[0], &buf2[0], len) != 0)
+            {
+                // Both files are read completely if the difference is in the last block.
+                if(len == sizeLeft)
+                    rememberHashes();
+
+                contentCompared();
+                bError = false;
+                fi1.close();
+                fi2.close();
+                return bEqual;
+            }
+            sizeLeft -= len;
+            ProgressProxy::step();
+        }
+        fi1.close();
+        fi2.close();
+    }
+
+    if(sizeLeft == 0)
+        rememberHashes();
+
+    contentCompared();
+    // If the program really arrives here, then the files are really equal.
+    bError = false;
+    bEqual = true;
+    return bEqual;
+}
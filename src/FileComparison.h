@@ -0,0 +1,30 @@
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+
+#ifndef FILECOMPARISON_H
+#define FILECOMPARISON_H
+
+#include <QString>
+
+class FileAccess;
+
+/*
+    Binary comparison of two files as the directory comparison does it without full analysis. Honours the trust
+    options, uses the content hash cache and compares large files by samples before reading them completely.
+*/
+class FileComparison
+{
+  public:
+    /*
+        Returns whether the contents are equal. bError is set if the files could not be compared. status says why
+        or tells how the files were compared, for the user.
+    */
+    static bool compare(FileAccess& fi1, FileAccess& fi2, bool& bError, QString& status);
+};
+
+#endif /* FILECOMPARISON_H */
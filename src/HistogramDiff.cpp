@@ -0,0 +1,276 @@
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+
+#include "HistogramDiff.h"
+
+#include "options.h"
+
+#include <algorithm>
+
+static inline QChar toQChar(QChar c) { return c; }
+static inline QChar toQChar(char c) { return QChar::fromLatin1(c); }
+
+HistogramDiff::HistogramDiff(const std::shared_ptr<const LineDataVector>& p1, const size_t index1, const LineType size1,
+                             const std::shared_ptr<const LineDataVector>& p2, const size_t index2, const LineType size2):
+    mP1(p1),
+    mP2(p2),
+    mIndex1(index1),
+    mIndex2(index2),
+    mSize1(size1),
+    mSize2(size2),
+    mbIgnoreNumbers(gOptions->m_bIgnoreNumbers)
+{
+    assert(size1 >= 0 && size2 >= 0);
+    assert(index1 + size1 <= p1->size() && index2 + size2 <= p2->size());
+}
+
+template <typename Char1, typename Char2>
+bool HistogramDiff::equalRanges(const Char1* p1, const Char1* const end1, const Char2* p2, const Char2* const end2) const
+{
+    for(;; ++p1, ++p2)
+    {
+        while(p1 != end1 && isIgnored(toQChar(*p1)))
+            ++p1;
+        while(p2 != end2 && isIgnored(toQChar(*p2)))
+            ++p2;
+
+        if(p1 == end1 || p2 == end2)
+            return p1 == end1 && p2 == end2;
+        if(toQChar(*p1) != toQChar(*p2))
+            return false;
+    }
+}
+
+bool HistogramDiff::equalLines(const LineData& line1, const LineData& line2) const
+{
+    // Only the placeholder line of an empty file has no buffer.
+    if(!line1.hasBuffer() || !line2.hasBuffer())
+        return !line1.hasBuffer() && !line2.hasBuffer();
+
+    if(line1.isLatin1())
+    {
+        if(line2.isLatin1())
+            return equalRanges(line1.latin1Data(), line1.latin1Data() + line1.size(), line2.latin1Data(), line2.latin1Data() + line2.size());
+        return equalRanges(line1.latin1Data(), line1.latin1Data() + line1.size(), line2.unicodeData(), line2.unicodeData() + line2.size());
+    }
+
+    if(line2.isLatin1())
+        return equalRanges(line1.unicodeData(), line1.unicodeData() + line1.size(), line2.latin1Data(), line2.latin1Data() + line2.size());
+    return equalRanges(line1.unicodeData(), line1.unicodeData() + line1.size(), line2.unicodeData(), line2.unicodeData() + line2.size());
+}
+
+qint32 HistogramDiff::classOf(const LineData& line, const size_t h)
+{
+    qint32& bucket = mBuckets[h & (mBuckets.size() - 1)];
+
+    for(qint32 id = bucket; id >= 0; id = mClassNext[id])
+    {
+        if(mClassHashes[id] == h && equalLines(*mClassLines[id], line))
+            return id;
+    }
+
+    const qint32 id = SafeInt<qint32>(mClassLines.size());
+    mClassLines.push_back(&line);
+    mClassHashes.push_back(h);
+    mClassNext.push_back(bucket);
+    bucket = id;
+    return id;
+}
+
+void HistogramDiff::classifyLines()
+{
+    size_t buckets = 64;
+    while(buckets < 2 * ((size_t)mSize1 + mSize2))
+        buckets *= 2;
+    mBuckets.assign(buckets, -1);
+
+    const LineHashOptions hashOptions{true, mbIgnoreNumbers, false};
+    const std::shared_ptr<const std::vector<size_t>> hashes1 = mP1->lineHashes(hashOptions, mIndex1, mSize1);
+    const std::shared_ptr<const std::vector<size_t>> hashes2 = mP2->lineHashes(hashOptions, mIndex2, mSize2);
+
+    mIds1.resize(mSize1);
+    for(LineType i = 0; i < mSize1; ++i)
+        mIds1[i] = classOf((*mP1)[mIndex1 + i], (*hashes1)[mIndex1 + i]);
+
+    mIds2.resize(mSize2);
+    for(LineType i = 0; i < mSize2; ++i)
+        mIds2[i] = classOf((*mP2)[mIndex2 + i], (*hashes2)[mIndex2 + i]);
+
+    mCount.assign(mClassLines.size(), 0);
+    mFirstOccurrence.assign(mClassLines.size(), -1);
+    mNextOccurrence.assign(mSize1, -1);
+}
+
+bool HistogramDiff::findAnchor(const Range& r, Range& anchor, bool& bHasCommon)
+{
+    // Chain the lines of each class in order. Backwards so the first occurrence ends up first.
+    for(LineType i = r.end1 - 1; i >= r.begin1; --i)
+    {
+        const qint32 id = mIds1[i];
+        ++mCount[id];
+        mNextOccurrence[i] = mFirstOccurrence[id];
+        mFirstOccurrence[id] = i;
+    }
+
+    bHasCommon = false;
+    LineType bestLength = 0;
+    // Lines with more occurrences are skipped below, runs of them never become an anchor.
+    qint32 bestCount = maxChainLength;
+    for(LineType j = r.begin2; j < r.end2;)
+    {
+        const qint32 id = mIds2[j];
+        LineType nextJ = j + 1;
+
+        if(mCount[id] > 0)
+            bHasCommon = true;
+
+        if(mCount[id] == 0 || mCount[id] > bestCount)
+        {
+            j = nextJ;
+            continue;
+        }
+
+        for(LineType i = mFirstOccurrence[id]; i >= 0; i = mNextOccurrence[i])
+        {
+            // Grow the match in both directions, remembering the rarest line in it.
+            qint32 rarest = mCount[id];
+            LineType s1 = i, s2 = j;
+            while(s1 > r.begin1 && s2 > r.begin2 && mIds1[s1 - 1] == mIds2[s2 - 1])
+            {
+                --s1;
+                --s2;
+                rarest = std::min(rarest, mCount[mIds1[s1]]);
+            }
+
+            LineType e1 = i + 1, e2 = j + 1;
+            while(e1 < r.end1 && e2 < r.end2 && mIds1[e1] == mIds2[e2])
+            {
+                rarest = std::min(rarest, mCount[mIds1[e1]]);
+                ++e1;
+                ++e2;
+            }
+
+            nextJ = std::max(nextJ, e2);
+            if(e1 - s1 > bestLength || rarest < bestCount)
+            {
+                anchor.begin1 = s1;
+                anchor.end1 = e1;
+                anchor.begin2 = s2;
+                anchor.end2 = e2;
+                bestLength = e1 - s1;
+                bestCount = rarest;
+            }
+        }
+        j = nextJ;
+    }
+
+    for(LineType i = r.begin1; i < r.end1; ++i)
+    {
+        mCount[mIds1[i]] = 0;
+        mFirstOccurrence[mIds1[i]] = -1;
+    }
+
+    return bestLength > 0;
+}
+
+void HistogramDiff::addEqual(const LineType count)
+{
+    if(count == 0)
+        return;
+
+    if(mCurrent.diff1() > 0 || mCurrent.diff2() > 0)
+    {
+        mDiffList->push_back(mCurrent);
+        mCurrent = Diff(count, 0, 0);
+    }
+    else
+        mCurrent.adjustNumberOfEquals(count);
+}
+
+void HistogramDiff::addChange(const quint64 count1, const quint64 count2)
+{
+    mCurrent.adjustDiff1(count1);
+    mCurrent.adjustDiff2(count2);
+}
+
+void HistogramDiff::run(DiffList& diffList)
+{
+    mDiffList = &diffList;
+    mCurrent = Diff();
+    classifyLines();
+
+    // Ranges are taken from the back, so the parts of a range are pushed last to first.
+    std::vector<Range> ranges;
+    ranges.push_back({0, mSize1, 0, mSize2, false});
+    while(!ranges.empty())
+    {
+        Range r = ranges.back();
+        ranges.pop_back();
+
+        if(r.bEqual)
+        {
+            addEqual(r.end1 - r.begin1);
+            continue;
+        }
+
+        LineType prefix = 0;
+        while(r.begin1 < r.end1 && r.begin2 < r.end2 && mIds1[r.begin1] == mIds2[r.begin2])
+        {
+            ++r.begin1;
+            ++r.begin2;
+            ++prefix;
+        }
+        addEqual(prefix);
+
+        LineType suffix = 0;
+        while(r.begin1 < r.end1 && r.begin2 < r.end2 && mIds1[r.end1 - 1] == mIds2[r.end2 - 1])
+        {
+            --r.end1;
+            --r.end2;
+            ++suffix;
+        }
+        if(suffix > 0)
+            ranges.push_back({r.end1, r.end1 + suffix, r.end2, r.end2 + suffix, true});
+
+        if(r.begin1 == r.end1 || r.begin2 == r.end2)
+        {
+            addChange(r.end1 - r.begin1, r.end2 - r.begin2);
+            continue;
+        }
+
+        Range anchor;
+        bool bHasCommon = false;
+        if(findAnchor(r, anchor, bHasCommon))
+        {
+            ranges.push_back({anchor.end1, r.end1, anchor.end2, r.end2, false});
+            ranges.push_back({anchor.begin1, anchor.end1, anchor.begin2, anchor.end2, true});
+            ranges.push_back({r.begin1, anchor.begin1, r.begin2, anchor.begin2, false});
+        }
+        else if(bHasCommon)
+        {
+            // Only frequent lines in common, GnuDiff does better on these.
+            DiffList gnuDiffList;
+            gnuDiffList.runGnuDiff(mP1, mIndex1 + r.begin1, r.end1 - r.begin1, mP2, mIndex2 + r.begin2, r.end2 - r.begin2);
+            for(const Diff& d: gnuDiffList)
+            {
+                addEqual(d.numberOfEquals());
+                addChange(d.diff1(), d.diff2());
+            }
+            if(gnuDiffList.usedFastMode())
+                diffList.setUsedFastMode(true);
+        }
+        else
+        {
+            addChange(r.end1 - r.begin1, r.end2 - r.begin2);
+        }
+    }
+
+    if(!mCurrent.isEmpty())
+        diffList.push_back(mCurrent);
+    mDiffList = nullptr;
+}
@@ -0,0 +1,91 @@
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+
+#ifndef HISTOGRAMDIFF_H
+#define HISTOGRAMDIFF_H
+
+#include "diff.h"
+
+#include <cctype>
+#include <memory>
+#include <vector>
+
+#include <QChar>
+
+/*
+    Line matching in the style of git's histogram diff.
+
+    The range is split at the longest run of matching lines that contains the rarest line, then both sides are
+    handled the same way. Lines that occur more than maxChainLength times are never used to split. If only
+    such lines are left in common the range is handed to GnuDiff instead.
+
+    Lines are compared like GnuDiff does: white space is ignored, so are numbers if that option is set.
+*/
+class HistogramDiff
+{
+  public:
+    HistogramDiff(const std::shared_ptr<const LineDataVector>& p1, const size_t index1, const LineType size1,
+                  const std::shared_ptr<const LineDataVector>& p2, const size_t index2, const LineType size2);
+
+    // Appends the result to diffList, which should be empty.
+    void run(DiffList& diffList);
+
+  private:
+    static constexpr qint32 maxChainLength = 64;
+
+    struct Range {
+        LineType begin1 = 0;
+        LineType end1 = 0;
+        LineType begin2 = 0;
+        LineType end2 = 0;
+        // Set for a run of equal lines of length end1 - begin1 that only needs to be written out.
+        bool bEqual = false;
+    };
+
+    void classifyLines();
+    // h is the line's hash from LineDataVector::lineHashes.
+    [[nodiscard]] qint32 classOf(const LineData& line, const size_t h);
+    [[nodiscard]] bool isIgnored(const QChar c) const { return isspace((unsigned char)c.unicode()) || (mbIgnoreNumbers && (c.isDigit() || c == u'-' || c == u'.')); }
+    [[nodiscard]] bool equalLines(const LineData& line1, const LineData& line2) const;
+    template <typename Char1, typename Char2>
+    [[nodiscard]] bool equalRanges(const Char1* p1, const Char1* end1, const Char2* p2, const Char2* end2) const;
+
+    // Finds the anchor for r. Returns false if there is none, bHasCommon tells if r has any lines in common.
+    [[nodiscard]] bool findAnchor(const Range& r, Range& anchor, bool& bHasCommon);
+
+    void addEqual(const LineType count);
+    void addChange(const quint64 count1, const quint64 count2);
+
+    std::shared_ptr<const LineDataVector> mP1;
+    std::shared_ptr<const LineDataVector> mP2;
+    size_t mIndex1;
+    size_t mIndex2;
+    LineType mSize1;
+    LineType mSize2;
+    bool mbIgnoreNumbers;
+
+    // Equivalence class of each line, equal lines share one.
+    std::vector<qint32> mIds1;
+    std::vector<qint32> mIds2;
+    // Per class: a line of that class, its hash and the next class in the same hash bucket.
+    std::vector<const LineData*> mClassLines;
+    std::vector<size_t> mClassHashes;
+    std::vector<qint32> mClassNext;
+    std::vector<qint32> mBuckets;
+
+    // Histogram of the current range in the first file, indexed by class. Reset after each use.
+    std::vector<qint32> mCount;
+    std::vector<LineType> mFirstOccurrence;
+    // Next line of the same class in the first file.
+    std::vector<LineType> mNextOccurrence;
+
+    DiffList* mDiffList = nullptr;
+    Diff mCurrent;
+};
+
+#endif /* HISTOGRAMDIFF_H */
@@ -0,0 +1,373 @@
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+
+#include "LineScanner.h"
+
+#include <cstring>
+
+#include <QtAlgorithms>
+#include <QtGlobal>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KDIFF3_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Only gcc and clang let us compile single functions for AVX2 without enabling it globally.
+#if KDIFF3_HAS_SSE2 && defined(__GNUC__)
+#define KDIFF3_HAS_AVX2 1
+#include <immintrin.h>
+#define KDIFF3_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+using ScanFunction = const QChar* (*)(const QChar*, const QChar*);
+using ScanFunction8 = const char* (*)(const char*, const char*);
+
+constexpr char16_t kFirstSpecial = 0xFDD0;
+
+inline bool isLineEndOrSpecial(const char16_t c)
+{
+    return c == u'\n' || c == u'\r' || c == 0 || c >= kFirstSpecial;
+}
+
+inline bool isAsciiWhiteSpace(const char16_t c)
+{
+    return c == u' ' || (c >= u'\t' && c <= u'\r');
+}
+
+const QChar* findLineEndOrSpecialScalar(const QChar* p, const QChar* end)
+{
+    while(p < end && !isLineEndOrSpecial(p->unicode()))
+        ++p;
+    return p;
+}
+
+const QChar* findNewLineScalar(const QChar* p, const QChar* end)
+{
+    while(p < end && p->unicode() != u'\n')
+        ++p;
+    return p;
+}
+
+const QChar* skipAsciiWhiteSpaceScalar(const QChar* p, const QChar* end)
+{
+    while(p < end && isAsciiWhiteSpace(p->unicode()))
+        ++p;
+    return p;
+}
+
+const char* findLineEndOrSpecialScalar(const char* p, const char* end)
+{
+    while(p < end && *p != '\n' && *p != '\r' && *p != '\0')
+        ++p;
+    return p;
+}
+
+const char* skipAsciiWhiteSpaceScalar(const char* p, const char* end)
+{
+    while(p < end && isAsciiWhiteSpace((uchar)*p))
+        ++p;
+    return p;
+}
+
+#ifdef KDIFF3_HAS_SSE2
+/*
+    movemask yields two bits per 16-bit lane, so the index of the first set bit divided by two is the matching QChar.
+    SSE2 has no unsigned 16-bit compare, saturating subtraction is used instead: subs(x, n) == 0 <=> x <= n.
+*/
+inline const __m128i* asVector128(const QChar* p)
+{
+    return reinterpret_cast<const __m128i*>(p);
+}
+
+const QChar* findLineEndOrSpecialSSE2(const QChar* p, const QChar* end)
+{
+    const __m128i newLine = _mm_set1_epi16(u'\n');
+    const __m128i carriageReturn = _mm_set1_epi16(u'\r');
+    const __m128i belowSpecial = _mm_set1_epi16((short)(kFirstSpecial - 1));
+    const __m128i zero = _mm_setzero_si128();
+
+    for(; end - p >= 8; p += 8)
+    {
+        const __m128i v = _mm_loadu_si128(asVector128(p));
+        const __m128i plain = _mm_cmpeq_epi16(_mm_subs_epu16(v, belowSpecial), zero);
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi16(v, newLine), _mm_cmpeq_epi16(v, carriageReturn));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi16(v, zero));
+        hit = _mm_or_si128(hit, _mm_andnot_si128(plain, _mm_set1_epi16(-1)));
+
+        const quint32 mask = (quint32)_mm_movemask_epi8(hit);
+        if(mask != 0)
+            return p + qCountTrailingZeroBits(mask) / 2;
+    }
+
+    return findLineEndOrSpecialScalar(p, end);
+}
+
+const QChar* findNewLineSSE2(const QChar* p, const QChar* end)
+{
+    const __m128i newLine = _mm_set1_epi16(u'\n');
+
+    for(; end - p >= 8; p += 8)
+    {
+        const quint32 mask = (quint32)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128(asVector128(p)), newLine));
+        if(mask != 0)
+            return p + qCountTrailingZeroBits(mask) / 2;
+    }
+
+    return findNewLineScalar(p, end);
+}
+
+const QChar* skipAsciiWhiteSpaceSSE2(const QChar* p, const QChar* end)
+{
+    const __m128i space = _mm_set1_epi16(u' ');
+    const __m128i tab = _mm_set1_epi16(u'\t');
+    const __m128i controlRange = _mm_set1_epi16(u'\r' - u'\t');
+    const __m128i zero = _mm_setzero_si128();
+
+    for(; end - p >= 8; p += 8)
+    {
+        const __m128i v = _mm_loadu_si128(asVector128(p));
+        const __m128i control = _mm_cmpeq_epi16(_mm_subs_epu16(_mm_sub_epi16(v, tab), controlRange), zero);
+        const __m128i white = _mm_or_si128(_mm_cmpeq_epi16(v, space), control);
+
+        const quint32 mask = (quint32)_mm_movemask_epi8(white) ^ 0xFFFFu;
+        if(mask != 0)
+            return p + qCountTrailingZeroBits(mask) / 2;
+    }
+
+    return skipAsciiWhiteSpaceScalar(p, end);
+}
+
+inline const __m128i* asVector128(const char* p)
+{
+    return reinterpret_cast<const __m128i*>(p);
+}
+
+const char* findLineEndOrSpecialSSE2(const char* p, const char* end)
+{
+    const __m128i newLine = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    const __m128i zero = _mm_setzero_si128();
+
+    for(; end - p >= 16; p += 16)
+    {
+        const __m128i v = _mm_loadu_si128(asVector128(p));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, newLine), _mm_cmpeq_epi8(v, carriageReturn));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, zero));
+
+        const quint32 mask = (quint32)_mm_movemask_epi8(hit);
+        if(mask != 0)
+            return p + qCountTrailingZeroBits(mask);
+    }
+
+    return findLineEndOrSpecialScalar(p, end);
+}
+
+const char* skipAsciiWhiteSpaceSSE2(const char* p, const char* end)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i controlRange = _mm_set1_epi8('\r' - '\t');
+    const __m128i zero = _mm_setzero_si128();
+
+    for(; end - p >= 16; p += 16)
+    {
+        const __m128i v = _mm_loadu_si128(asVector128(p));
+        const __m128i control = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(v, tab), controlRange), zero);
+        const __m128i white = _mm_or_si128(_mm_cmpeq_epi8(v, space), control);
+
+        const quint32 mask = (quint32)_mm_movemask_epi8(white) ^ 0xFFFFu;
+        if(mask != 0)
+            return p + qCountTrailingZeroBits(mask);
+    }
+
+    return skipAsciiWhiteSpaceScalar(p, end);
+}
+#endif
+
+#ifdef KDIFF3_HAS_AVX2
+inline const __m256i* asVector256(const QChar* p)
+{
+    return reinterpret_cast<const __m256i*>(p);
+}
+
+KDIFF3_TARGET_AVX2 const QChar* findLineEndOrSpecialAVX2(const QChar* p, const QChar* end)
+{
+    const __m256i newLine = _mm256_set1_epi16(u'\n');
+    const __m256i carriageReturn = _mm256_set1_epi16(u'\r');
+    const __m256i belowSpecial = _mm256_set1_epi16((short)(kFirstSpecial - 1));
+    const __m256i zero = _mm256_setzero_si256();
+
+    for(; end - p >= 16; p += 16)
+    {
+        const __m256i v = _mm256_loadu_si256(asVector256(p));
+        const __m256i plain = _mm256_cmpeq_epi16(_mm256_subs_epu16(v, belowSpecial), zero);
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi16(v, newLine), _mm256_cmpeq_epi16(v, carriageReturn));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi16(v, zero));
+        hit = _mm256_or_si256(hit, _mm256_andnot_si256(plain, _mm256_set1_epi16(-1)));
+
+        const quint32 mask = (quint32)_mm256_movemask_epi8(hit);
+        if(mask != 0)
+            return p + qCountTrailingZeroBits(mask) / 2;
+    }
+
+    return findLineEndOrSpecialSSE2(p, end);
+}
+
+KDIFF3_TARGET_AVX2 const QChar* findNewLineAVX2(const QChar* p, const QChar* end)
+{
+    const __m256i newLine = _mm256_set1_epi16(u'\n');
+
+    for(; end - p >= 16; p += 16)
+    {
+        const quint32 mask = (quint32)_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256(asVector256(p)), newLine));
+        if(mask != 0)
+            return p + qCountTrailingZeroBits(mask) / 2;
+    }
+
+    return findNewLineSSE2(p, end);
+}
+
+KDIFF3_TARGET_AVX2 const QChar* skipAsciiWhiteSpaceAVX2(const QChar* p, const QChar* end)
+{
+    const __m256i space = _mm256_set1_epi16(u' ');
+    const __m256i tab = _mm256_set1_epi16(u'\t');
+    const __m256i controlRange = _mm256_set1_epi16(u'\r' - u'\t');
+    const __m256i zero = _mm256_setzero_si256();
+
+    for(; end - p >= 16; p += 16)
+    {
+        const __m256i v = _mm256_loadu_si256(asVector256(p));
+        const __m256i control = _mm256_cmpeq_epi16(_mm256_subs_epu16(_mm256_sub_epi16(v, tab), controlRange), zero);
+        const __m256i white = _mm256_or_si256(_mm256_cmpeq_epi16(v, space), control);
+
+        const quint32 mask = ~(quint32)_mm256_movemask_epi8(white);
+        if(mask != 0)
+            return p + qCountTrailingZeroBits(mask) / 2;
+    }
+
+    return skipAsciiWhiteSpaceSSE2(p, end);
+}
+
+inline const __m256i* asVector256(const char* p)
+{
+    return reinterpret_cast<const __m256i*>(p);
+}
+
+KDIFF3_TARGET_AVX2 const char* findLineEndOrSpecialAVX2(const char* p, const char* end)
+{
+    const __m256i newLine = _mm256_set1_epi8('\n');
+    const __m256i carriageReturn = _mm256_set1_epi8('\r');
+    const __m256i zero = _mm256_setzero_si256();
+
+    for(; end - p >= 32; p += 32)
+    {
+        const __m256i v = _mm256_loadu_si256(asVector256(p));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, newLine), _mm256_cmpeq_epi8(v, carriageReturn));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, zero));
+
+        const quint32 mask = (quint32)_mm256_movemask_epi8(hit);
+        if(mask != 0)
+            return p + qCountTrailingZeroBits(mask);
+    }
+
+    return findLineEndOrSpecialSSE2(p, end);
+}
+
+KDIFF3_TARGET_AVX2 const char* skipAsciiWhiteSpaceAVX2(const char* p, const char* end)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i controlRange = _mm256_set1_epi8('\r' - '\t');
+    const __m256i zero = _mm256_setzero_si256();
+
+    for(; end - p >= 32; p += 32)
+    {
+        const __m256i v = _mm256_loadu_si256(asVector256(p));
+        const __m256i control = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(v, tab), controlRange), zero);
+        const __m256i white = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), control);
+
+        const quint32 mask = ~(quint32)_mm256_movemask_epi8(white);
+        if(mask != 0)
+            return p + qCountTrailingZeroBits(mask);
+    }
+
+    return skipAsciiWhiteSpaceSSE2(p, end);
+}
+#endif
+
+struct ScanKernels {
+    ScanFunction lineEndOrSpecial = findLineEndOrSpecialScalar;
+    ScanFunction newLine = findNewLineScalar;
+    ScanFunction asciiWhiteSpace = skipAsciiWhiteSpaceScalar;
+    ScanFunction8 lineEndOrSpecial8 = findLineEndOrSpecialScalar;
+    ScanFunction8 asciiWhiteSpace8 = skipAsciiWhiteSpaceScalar;
+};
+
+ScanKernels selectKernels()
+{
+    ScanKernels kernels;
+#ifdef KDIFF3_HAS_SSE2
+    kernels = {findLineEndOrSpecialSSE2, findNewLineSSE2, skipAsciiWhiteSpaceSSE2, findLineEndOrSpecialSSE2, skipAsciiWhiteSpaceSSE2};
+#endif
+#ifdef KDIFF3_HAS_AVX2
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        kernels = {findLineEndOrSpecialAVX2, findNewLineAVX2, skipAsciiWhiteSpaceAVX2, findLineEndOrSpecialAVX2, skipAsciiWhiteSpaceAVX2};
+#endif
+    return kernels;
+}
+
+const ScanKernels& kernels()
+{
+    static const ScanKernels selected = selectKernels();
+    return selected;
+}
+} // namespace
+
+const QChar* LineScanner::findLineEndOrSpecial(const QChar* p, const QChar* end)
+{
+    return kernels().lineEndOrSpecial(p, end);
+}
+
+const QChar* LineScanner::findNewLine(const QChar* p, const QChar* end)
+{
+    return kernels().newLine(p, end);
+}
+
+const QChar* LineScanner::skipAsciiWhiteSpace(const QChar* p, const QChar* end)
+{
+    return kernels().asciiWhiteSpace(p, end);
+}
+
+const char* LineScanner::findLineEndOrSpecial(const char* p, const char* end)
+{
+    return kernels().lineEndOrSpecial8(p, end);
+}
+
+const char* LineScanner::findNewLine(const char* p, const char* end)
+{
+    // The C library already has a vectorized version of this.
+    const void* found = p < end ? memchr(p, '\n', end - p) : nullptr;
+    return found != nullptr ? static_cast<const char*>(found) : end;
+}
+
+const char* LineScanner::skipAsciiWhiteSpace(const char* p, const char* end)
+{
+    return kernels().asciiWhiteSpace8(p, end);
+}
+
+bool LineScanner::isAscii(const char* p, const char* end)
+{
+    // Simple enough for the compiler to vectorize on its own.
+    uchar bits = 0;
+    for(; p < end; ++p)
+        bits |= (uchar)*p;
+    return (bits & 0x80) == 0;
+}
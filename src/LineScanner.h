@@ -0,0 +1,40 @@
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+
+#ifndef LINESCANNER_H
+#define LINESCANNER_H
+
+#include <QChar>
+
+/*
+    Vectorized helpers for the hot loops that walk decoded text one QChar at a time.
+    An SSE2 or AVX2 kernel is picked at runtime depending on what the CPU supports, other platforms use plain loops.
+    All functions return end if nothing matches.
+*/
+class LineScanner
+{
+  public:
+    /*
+        Find the first '\n', '\r', U+0000 or code unit at or above U+FDD0. The last two are rare in text but need
+        a closer look by the caller (non-characters, replacement character).
+    */
+    [[nodiscard]] static const QChar* findLineEndOrSpecial(const QChar* p, const QChar* end);
+    // Find the first '\n'. Used on buffers where all line endings have already been converted.
+    [[nodiscard]] static const QChar* findNewLine(const QChar* p, const QChar* end);
+    // Skip ASCII white space (tab to carriage return and space). Other Unicode spaces are left to the caller.
+    [[nodiscard]] static const QChar* skipAsciiWhiteSpace(const QChar* p, const QChar* end);
+
+    // Same as above for text stored as Latin-1. Only '\n', '\r' and '\0' are special here.
+    [[nodiscard]] static const char* findLineEndOrSpecial(const char* p, const char* end);
+    [[nodiscard]] static const char* findNewLine(const char* p, const char* end);
+    [[nodiscard]] static const char* skipAsciiWhiteSpace(const char* p, const char* end);
+    // True if no byte has its high bit set.
+    [[nodiscard]] static bool isAscii(const char* p, const char* end);
+};
+
+#endif /* LINESCANNER_H */
@@ -305,6 +305,28 @@ void MergeBlockList::updateDefaults(const e_SrcSelector defaultSelector, const b
     }
 }
 
+void MergeBlockList::countConflicts(TotalDiffStatus& status) const
+{
+    qint32 nrOfSolvedConflicts = 0;
+    qint32 nrOfUnsolvedConflicts = 0;
+    qint32 nrOfWhiteSpaceConflicts = 0;
+
+    for(const MergeBlock& mb: *this)
+    {
+        if(mb.isConflict())
+            ++nrOfUnsolvedConflicts;
+        else if(mb.isDelta())
+            ++nrOfSolvedConflicts;
+
+        if(mb.isWhiteSpaceConflict())
+            ++nrOfWhiteSpaceConflicts;
+    }
+
+    status.setUnsolvedConflicts(nrOfUnsolvedConflicts);
+    status.setSolvedConflicts(nrOfSolvedConflicts);
+    status.setWhitespaceConflicts(nrOfWhiteSpaceConflicts);
+}
+
 void MergeBlock::dectectWhiteSpaceConflict(const Diff3Line &d, const bool isThreeWay)
 {
     // Automatic solving for only whitespace changes.
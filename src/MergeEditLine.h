@@ -189,6 +189,9 @@ class MergeBlockList: public std::list<MergeBlock>
     void updateDefaults(const e_SrcSelector defaultSelector, const bool bConflictsOnly, const bool bWhiteSpaceOnly);
 
     MergeBlockList::iterator splitAtDiff3LineIdx(qint32 d3lLineIdx);
+
+    // Sets the number of solved, unsolved and whitespace conflicts in status.
+    void countConflicts(TotalDiffStatus& status) const;
 };
 
 inline std::shared_ptr<LineDataVector> gLineVector[4];
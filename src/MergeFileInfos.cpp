@@ -13,6 +13,8 @@
 #include "DirectoryInfo.h"
 #include "directorymergewindow.h"
 #include "fileaccess.h"
+#include "FileAnalysis.h"
+#include "FileComparison.h"
 #include "Logging.h"
 #include "options.h"
 #include "progress.h"
@@ -213,12 +215,15 @@ bool MergeFileInfos::compareFilesAndCalcAges(QStringList& errors, DirectoryMerge
         }
         else
         {
-            Q_EMIT pDMW->startDiffMerge(errors,
-                existsInA() ? getFileInfoA()->absoluteFilePath() : QString(""),
-                existsInB() ? getFileInfoB()->absoluteFilePath() : QString(""),
-                existsInC() ? getFileInfoC()->absoluteFilePath() : QString(""),
-                "",
-                "", "", "", &diffStatus());
+            const QString fileNameA = existsInA() ? getFileInfoA()->absoluteFilePath() : QString("");
+            const QString fileNameB = existsInB() ? getFileInfoB()->absoluteFilePath() : QString("");
+            const QString fileNameC = existsInC() ? getFileInfoC()->absoluteFilePath() : QString("");
+
+            // Without widgets where possible, this may run on a worker thread.
+            if(isLocal() && FileAnalysis::isPossible())
+                FileAnalysis::analyse(fileNameA, fileNameB, fileNameC, diffStatus(), errors);
+            else
+                Q_EMIT pDMW->startDiffMerge(errors, fileNameA, fileNameB, fileNameC, "", "", "", "", &diffStatus());
             qint32 nofNonwhiteConflicts = diffStatus().getNonWhitespaceConflicts();
 
             if(gOptions->m_bDmWhiteSpaceEqual && nofNonwhiteConflicts == 0)
@@ -246,19 +251,38 @@ bool MergeFileInfos::compareFilesAndCalcAges(QStringList& errors, DirectoryMerge
     {
         bool bError = false;
         QString eqStatus;
+        m_compareStatus.clear();
+        const auto addCompareStatus = [this, &eqStatus](const QString& files) {
+            QString text = eqStatus.trimmed();
+            if(text.endsWith(u':'))
+                text.chop(1);
+            if(text.isEmpty())
+                return;
+
+            if(!m_compareStatus.isEmpty())
+                m_compareStatus += u'\n';
+            m_compareStatus += isThreeWay() ? files + QStringLiteral(": ") + text : text;
+        };
+
         if(existsInA() && existsInB())
         {
             if(isDirA())
                 m_bEqualAB = true;
             else
-                m_bEqualAB = fastFileComparison(*getFileInfoA(), *getFileInfoB(), bError, eqStatus);
+            {
+                m_bEqualAB = FileComparison::compare(*getFileInfoA(), *getFileInfoB(), bError, eqStatus);
+                addCompareStatus(QStringLiteral("A/B"));
+            }
         }
         if(existsInA() && existsInC())
         {
             if(isDirA())
                 m_bEqualAC = true;
             else
-                m_bEqualAC = fastFileComparison(*getFileInfoA(), *getFileInfoC(), bError, eqStatus);
+            {
+                m_bEqualAC = FileComparison::compare(*getFileInfoA(), *getFileInfoC(), bError, eqStatus);
+                addCompareStatus(QStringLiteral("A/C"));
+            }
         }
         if(existsInB() && existsInC())
         {
@@ -266,7 +290,8 @@ bool MergeFileInfos::compareFilesAndCalcAges(QStringList& errors, DirectoryMerge
                 m_bEqualBC = true;
             else
             {
-                m_bEqualBC = fastFileComparison(*getFileInfoB(), *getFileInfoC(), bError, eqStatus);
+                m_bEqualBC = FileComparison::compare(*getFileInfoB(), *getFileInfoC(), bError, eqStatus);
+                addCompareStatus(QStringLiteral("B/C"));
             }
         }
         if(bError)
@@ -375,154 +400,6 @@ bool MergeFileInfos::compareFilesAndCalcAges(QStringList& errors, DirectoryMerge
     return true;
 }
 
-bool MergeFileInfos::fastFileComparison(
-    FileAccess& fi1, FileAccess& fi2,
-    bool& bError, QString& status)
-{
-    ProgressScope pp;
-    bool bEqual = false;
-
-    status = "";
-    bError = true;
-
-    qCDebug(kdiffMergeFileInfo) << "Entering MergeFileInfos::fastFileComparison";
-    if(fi1.isNormal() != fi2.isNormal())
-    {
-        qCDebug(kdiffMergeFileInfo) << "Have: \'" << fi2.fileName() << "\' , isNormal = " << fi2.isNormal();
-
-        status = i18n("Unable to compare non-normal file with normal file.");
-        return false;
-    }
-
-    if(!fi1.isNormal())
-    {
-        qCInfo(kdiffMergeFileInfo) << "Skipping not a normal file.";
-        bError = false;
-        return false;
-    }
-
-    if(!gOptions->m_bDmFollowFileLinks)
-    {
-        qCInfo(kdiffMergeFileInfo) << "Have: \'" << fi2.fileName() << "\' , isSymLink = " << fi2.isSymLink();
-        /*
-            "git difftool --dir-diff"
-            sets up directory comparisons with symlinks to the current work tree being compared with real files.
-
-            m_bAllowMismatch is a compatibility work around.
-        */
-        if(fi1.isSymLink() != fi2.isSymLink())
-        {
-            qCDebug(kdiffMergeFileInfo) << "Rejecting comparison of link to file. With the same relitive path.";
-            status = i18n("Mix of links and normal files.");
-            return bEqual;
-        }
-        else if(fi1.isSymLink() && fi2.isSymLink())
-        {
-            qCDebug(kdiffMergeFileInfo) << "Comparison of link to link. OK.";
-            bError = false;
-            bEqual = fi1.readLink() == fi2.readLink();
-            status = i18n("Link: ");
-            return bEqual;
-        }
-    }
-
-    if(fi1.size() != fi2.size())
-    {
-        qCInfo(kdiffMergeFileInfo) << "Sizes differ.";
-        bError = false;
-        bEqual = false;
-        status = i18n("Size. ");
-        return bEqual;
-    }
-    else if(gOptions->m_bDmTrustSize)
-    {
-        qCInfo(kdiffMergeFileInfo) << "Same size. Trusting result.";
-
-        bEqual = true;
-        bError = false;
-        return bEqual;
-    }
-
-    if(gOptions->m_bDmTrustDate)
-    {
-        bEqual = (fi1.lastModified() == fi2.lastModified() && fi1.size() == fi2.size());
-        bError = false;
-        status = i18n("Date & Size: ");
-        return bEqual;
-    }
-
-    if(gOptions->m_bDmTrustDateFallbackToBinary)
-    {
-        bEqual = (fi1.lastModified() == fi2.lastModified() && fi1.size() == fi2.size());
-        if(bEqual)
-        {
-            bError = false;
-            status = i18n("Date & Size: ");
-            return bEqual;
-        }
-    }
-
-    std::vector<char> buf1(100000);
-    std::vector<char> buf2(buf1.size());
-
-    if(!fi1.open(QIODevice::ReadOnly))
-    {
-        status = fi1.errorString();
-        return bEqual;
-    }
-
-    if(!fi2.open(QIODevice::ReadOnly))
-    {
-        fi1.close();
-        status = fi2.errorString();
-        return bEqual;
-    }
-    qCInfo(kdiffMergeFileInfo) << "Comparing files...";
-    ProgressProxy::setInformation(i18nc("Status message", "Comparing file..."), 0, false);
-    typedef qint64 t_FileSize;
-    t_FileSize fullSize = fi1.size();
-    t_FileSize sizeLeft = fullSize;
-
-    ProgressProxy::setMaxNofSteps(fullSize / buf1.size());
-
-    while(sizeLeft > 0 && !ProgressProxy::wasCancelled())
-    {
-        qint64 len = std::min(sizeLeft, (t_FileSize)buf1.size());
-        if(len != fi1.read(&buf1[0], len))
-        {
-            status = fi1.errorString();
-            fi1.close();
-            fi2.close();
-            return bEqual;
-        }
-
-        if(len != fi2.read(&buf2[0], len))
-        {
-            status = fi2.errorString();
-            fi1.close();
-            fi2.close();
-            return bEqual;
-        }
-
-        if(memcmp(&buf1[0], &buf2[0], len) != 0)
-        {
-            bError = false;
-            fi1.close();
-            fi2.close();
-            return bEqual;
-        }
-        sizeLeft -= len;
-        ProgressProxy::step();
-    }
-    fi1.close();
-    fi2.close();
-
-    // If the program really arrives here, then the files are really equal.
-    bError = false;
-    bEqual = true;
-    return bEqual;
-}
-
 void MergeFileInfos::updateAge()
 {
     if(isDirA() || isDirB() || isDirC())
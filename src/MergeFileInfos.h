@@ -77,6 +77,12 @@ class MergeFileInfos
     [[nodiscard]] bool isDirB() const { return m_pFileInfoB != nullptr ? m_pFileInfoB->isDir() : false; }
     [[nodiscard]] bool isDirC() const { return m_pFileInfoC != nullptr ? m_pFileInfoC->isDir() : false; }
     [[nodiscard]] bool hasDir() const { return isDirA() || isDirB() || isDirC(); }
+    // True if none of the files needs KIO.
+    [[nodiscard]] bool isLocal() const
+    {
+        return (m_pFileInfoA == nullptr || m_pFileInfoA->isLocal()) && (m_pFileInfoB == nullptr || m_pFileInfoB->isLocal()) &&
+               (m_pFileInfoC == nullptr || m_pFileInfoC->isLocal());
+    }
 
     [[nodiscard]] bool isLinkA() const { return m_pFileInfoA != nullptr ? m_pFileInfoA->isSymLink() : false; }
     [[nodiscard]] bool isLinkB() const { return m_pFileInfoB != nullptr ? m_pFileInfoB->isSymLink() : false; }
@@ -115,6 +121,8 @@ class MergeFileInfos
     [[nodiscard]] QString getDirNameDest() const { return gDirInfo->destDir().prettyAbsPath(); }
 
     [[nodiscard]] TotalDiffStatus& diffStatus() { return m_totalDiffStatus; }
+    // How the binary comparison came to its result, one line per pair of files. Empty after a full analysis.
+    [[nodiscard]] const QString& compareStatus() const { return m_compareStatus; }
 
     [[nodiscard]] e_MergeOperation getOperation() const { return m_eMergeOperation; }
     void setOperation(const e_MergeOperation op) { m_eMergeOperation = op; }
@@ -178,7 +186,6 @@ class MergeFileInfos
         return age;
     }
 
-    bool fastFileComparison(FileAccess& fi1, FileAccess& fi2, bool& bError, QString& status);
     void setAgeA(const e_Age inAge) { m_ageA = inAge; }
     void setAgeB(const e_Age inAge) { m_ageB = inAge; }
     void setAgeC(const e_Age inAge) { m_ageC = inAge; }
@@ -191,6 +198,7 @@ class MergeFileInfos
     FileAccess* m_pFileInfoC = nullptr;
 
     TotalDiffStatus m_totalDiffStatus;
+    QString m_compareStatus;
 
     e_MergeOperation m_eMergeOperation = eNoOperation;
     e_OperationStatus m_eOpStatus = eOpStatusNone;
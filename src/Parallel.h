@@ -0,0 +1,127 @@
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "ProgressProxy.h"
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+
+#include <QAtomicInteger>
+#include <QCoreApplication>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+/*
+    Minimal work sharing on top of a QThreadPool, the global one unless the caller has a pool of its own.
+
+    Tasks must not touch widgets. Of the ProgressProxy functions only wasCancelled() has an effect when called from
+    a worker, everything else is ignored there. Instead forEach() steps the progress once for every finished task.
+*/
+class Parallel
+{
+  public:
+    [[nodiscard]] static bool isGuiThread()
+    {
+        return QCoreApplication::instance() != nullptr && QThread::currentThread() == QCoreApplication::instance()->thread();
+    }
+
+    /*
+        Calls task(i) for every i in [0, count) and returns once all calls have finished. Indexes are handed out
+        one at a time so uneven tasks balance themselves.
+
+        Off the GUI thread the caller works on the tasks too, so nested calls and a busy pool can not deadlock.
+        The GUI thread only waits and keeps processing events so progress and the cancel button stay alive.
+        Called from the GUI thread, the current progress level is stepped once per task, tasks must not step it.
+        Elsewhere progress is not reported at all.
+        The first exception thrown by a task is rethrown here after all other tasks are done.
+
+        A separate pool fits tasks that mostly wait for I/O, these may use more threads than there are cores.
+    */
+    template <typename Task>
+    static void forEach(const qsizetype count, const Task& task, QThreadPool* pool = QThreadPool::globalInstance())
+    {
+        if(count <= 0)
+            return;
+
+        struct State {
+            QAtomicInteger<qsizetype> next = 0;
+            QAtomicInteger<qsizetype> done = 0;
+            QMutex mutex;
+            QWaitCondition finished;
+            std::exception_ptr error;
+        };
+        // Helpers that start late only look at the counters, so task may go out of scope before they run.
+        std::shared_ptr<State> state = std::make_shared<State>();
+
+        auto work = [state, count, &task]() {
+            for(qsizetype i = state->next.fetchAndAddRelaxed(1); i < count; i = state->next.fetchAndAddRelaxed(1))
+            {
+                try
+                {
+                    task(i);
+                }
+                catch(...)
+                {
+                    QMutexLocker locker(&state->mutex);
+                    if(!state->error)
+                        state->error = std::current_exception();
+                }
+
+                if(state->done.fetchAndAddOrdered(1) + 1 == count)
+                {
+                    QMutexLocker locker(&state->mutex);
+                    state->finished.wakeAll();
+                }
+            }
+        };
+
+        const bool bGuiThread = isGuiThread();
+        const qsizetype helpers = std::min<qsizetype>(bGuiThread ? count : count - 1, pool->maxThreadCount());
+        qsizetype started = 0;
+        while(started < helpers && pool->tryStart(work))
+            ++started;
+
+        if(!bGuiThread || started == 0)
+            work();
+
+        qsizetype reported = 0;
+        const auto reportProgress = [&reported](const qsizetype done) {
+            for(; reported < done; ++reported)
+                ProgressProxy::step(false);
+        };
+
+        QMutexLocker locker(&state->mutex);
+        while(state->done.loadAcquire() < count)
+        {
+            if(!state->finished.wait(&state->mutex, 100) && bGuiThread)
+            {
+                locker.unlock();
+                reportProgress(state->done.loadAcquire());
+                // Processes pending events on the GUI thread.
+                ProgressProxy::wasCancelled();
+                locker.relock();
+            }
+        }
+        locker.unlock();
+
+        if(bGuiThread)
+            reportProgress(count);
+
+        if(state->error)
+            std::rethrow_exception(state->error);
+    }
+};
+
+#endif /* PARALLEL_H */
@@ -37,11 +37,13 @@ Optimizations: Skip unneeded steps.
 #include "diff.h"
 #include "EncodedData.h"
 #include "LineRef.h"
+#include "LineScanner.h"
 #include "Logging.h"
 #include "options.h"
 #include "Utils.h"
 
 #include <algorithm>         // for min
+#include <cstring>
 #include <memory>
 #include <optional>
 #include <vector>            // for vector
@@ -49,10 +51,17 @@ Optimizations: Skip unneeded steps.
 #include <QtGlobal>
 
 #include <QByteArray>
+#include <QByteArrayView>
+#include <QCryptographicHash>
 #include <QProcess>
 #include <QString>
 #include <QTemporaryFile>
 
+namespace {
+// Strong enough that equal digests mean equal data, see SourceData::isBinaryEqualWith().
+constexpr QCryptographicHash::Algorithm digestAlgorithm = QCryptographicHash::Blake2b_256;
+} // namespace
+
 void SourceData::reset()
 {
     mFromClipBoard = false;
@@ -88,7 +97,7 @@ bool SourceData::isEmpty() const
 
 bool SourceData::hasData() const
 {
-    return m_normalData.m_pBuf != nullptr;
+    return m_normalData.hasData();
 }
 
 bool SourceData::isValid() const
@@ -158,7 +167,7 @@ void SourceData::setData(const QString& data)
 
 const std::shared_ptr<LineDataVector>& SourceData::getLineDataForDiff() const
 {
-    if(m_lmppData.m_pBuf == nullptr)
+    if(!m_lmppData.hasData())
     {
         return m_normalData.m_v;
     }
@@ -185,11 +194,15 @@ qint64 SourceData::getSizeBytes() const
 
 const char* SourceData::getBuf() const
 {
-    return m_normalData.m_pBuf.get();
+    return m_normalData.rawData();
 }
 
-const QString& SourceData::getText() const
+QString SourceData::getText() const
 {
+    // Latin-1 data leaves m_unicodeBuf empty, so it holds the widened text after the first call.
+    if(m_normalData.mLatin1Buf != nullptr && m_normalData.m_unicodeBuf->isEmpty())
+        *m_normalData.m_unicodeBuf = QString::fromLatin1(*m_normalData.mLatin1Buf);
+
     return *m_normalData.m_unicodeBuf;
 }
 
@@ -210,9 +223,14 @@ bool SourceData::isFromBuffer() const
 
 bool SourceData::isBinaryEqualWith(const std::shared_ptr<SourceData>& other) const
 {
-    return m_fileAccess.exists() && other->m_fileAccess.exists() &&
-           getSizeBytes() == other->getSizeBytes() &&
-           (getSizeBytes() == 0 || memcmp(getBuf(), other->getBuf(), getSizeBytes()) == 0);
+    if(!m_fileAccess.exists() || !other->m_fileAccess.exists() || getSizeBytes() != other->getSizeBytes())
+        return false;
+
+    if(getSizeBytes() == 0)
+        return true;
+
+    // The raw data is gone by now, see FileData::finishLoading().
+    return !m_normalData.mDigest.isEmpty() && m_normalData.mDigest == other->m_normalData.mDigest;
 }
 
 /*
@@ -223,7 +241,12 @@ bool SourceData::isBinaryEqualWith(const std::shared_ptr<SourceData>& other) con
 void SourceData::FileData::reset()
 {
     m_pBuf.reset();
+    mMapping.reset();
+    mRawFileName.clear();
+    mDigest.clear();
+    mbHasData = false;
     m_v->clear();
+    mLatin1Buf.reset();
     mDataSize = 0;
     mLineCount = 0;
     m_bIsText = false;
@@ -247,7 +270,7 @@ bool SourceData::FileData::readFile(FileAccess& file)
         If the extra bytes are removed an unknown heap currption issue is triggered in the
         diff code. I don't have time to track this down to its true root cause.
     */
-    m_pBuf = std::make_unique<char[]>(mDataSize + 100); // Alloc 100 byte extra: Safety hack, not nice but does no harm.
+    m_pBuf = std::shared_ptr<char[]>(new char[mDataSize + 100]); // Alloc 100 byte extra: Safety hack, not nice but does no harm.
                                                         // Some extra bytes at the end of the buffer are needed by
                                                         // the diff algorithm. See also GnuDiff::diff_2_files().
     bool bSuccess = file.readFile(m_pBuf.get(), mDataSize);
@@ -258,6 +281,7 @@ bool SourceData::FileData::readFile(FileAccess& file)
     }
     else
     {
+        mbHasData = true;
         //null terminate buffer
         m_pBuf[mDataSize + 1] = 0;
         m_pBuf[mDataSize + 2] = 0;
@@ -279,9 +303,72 @@ bool SourceData::FileData::readFile(const QString& filename)
     return readFile(fa);
 }
 
+/*
+    Map local files instead of copying them to the heap. The mapping is only used while decoding, writing to the
+    file meanwhile would change the data under our feet and truncating it crash any further access.
+*/
+bool SourceData::FileData::mapFile(FileAccess& file)
+{
+    reset();
+    if(file.fileName().isEmpty() || !file.isNormal())
+        return true;
+
+    mMapping = file.mapForReading();
+    if(mMapping == nullptr)
+    {
+        if(!readFile(file))
+            return false;
+    }
+    else
+    {
+        mDataSize = mMapping->size();
+        mbHasData = true;
+    }
+
+    mRawFileName = file.absoluteFilePath();
+    return true;
+}
+
+/*
+    Only the decoded text is needed once preprocess() is done. Data read from the input file is dropped and read
+    again if it is saved, see loadRawData(). Preprocessor output can not be read again and is kept.
+*/
+void SourceData::FileData::finishLoading()
+{
+    if(hasData())
+        mDigest = QCryptographicHash::hash(QByteArrayView(rawData(), mDataSize), digestAlgorithm);
+
+    if(!mRawFileName.isEmpty())
+        releaseRawData();
+}
+
+/*
+    Reads the raw data from the input file again. Fails if the file changed since it was loaded, the data saved
+    must be what was compared.
+*/
+bool SourceData::FileData::loadRawData()
+{
+    if(rawData() != nullptr || !hasData())
+        return hasData();
+
+    if(mRawFileName.isEmpty())
+        return false;
+
+    FileAccess file(mRawFileName);
+    if(file.sizeForReading() != (qint64)mDataSize)
+        return false;
+
+    std::shared_ptr<char[]> buf(new char[mDataSize + 100]()); // Same safety margin as readFile().
+    if(!file.readFile(buf.get(), mDataSize) || QCryptographicHash::hash(QByteArrayView(buf.get(), mDataSize), digestAlgorithm) != mDigest)
+        return false;
+
+    m_pBuf = buf;
+    return true;
+}
+
 bool SourceData::saveNormalDataAs(const QString& fileName)
 {
-    return m_normalData.writeFile(fileName);
+    return m_normalData.loadRawData() && m_normalData.writeFile(fileName);
 }
 
 bool SourceData::FileData::writeFile(const QString& filename)
@@ -291,19 +378,24 @@ bool SourceData::FileData::writeFile(const QString& filename)
         return true;
     }
 
+    const char* data = rawData();
+    if(data == nullptr && mDataSize > 0)
+        return false;
+
     FileAccess fa(filename);
-    bool bSuccess = fa.writeFile(m_pBuf.get(), mDataSize);
+    bool bSuccess = fa.writeFile(data, mDataSize);
     return bSuccess;
 }
 
-//Deprecated
-void SourceData::FileData::copyBufFrom(const FileData& src) //TODO: Remove me.
+// Use the same raw data as src without copying it. preprocess() only reads from the buffer.
+void SourceData::FileData::shareBufFrom(const FileData& src)
 {
     reset();
+    assert(src.hasData());
     mDataSize = src.mDataSize;
-    m_pBuf = std::make_unique<char[]>(mDataSize + 100);
-    assert(src.m_pBuf != nullptr);
-    memcpy(m_pBuf.get(), src.m_pBuf.get(), mDataSize);
+    m_pBuf = src.m_pBuf;
+    mMapping = src.mMapping;
+    mbHasData = true;
 }
 
 std::optional<const QByteArray> SourceData::detectEncoding(const QString& fileName)
@@ -321,6 +413,14 @@ std::optional<const QByteArray> SourceData::detectEncoding(const QString& fileNa
 }
 
 void SourceData::readAndPreprocess(const QByteArray& encoding, bool bAutoDetect)
+{
+    readAndDecode(encoding, bAutoDetect);
+    m_normalData.finishLoading();
+    // Nothing reads the line matching data again.
+    m_lmppData.releaseRawData();
+}
+
+void SourceData::readAndDecode(const QByteArray& encoding, bool bAutoDetect)
 {
     QTemporaryFile fileIn1, fileOut1;
     QString fileNameIn1;
@@ -394,7 +494,7 @@ void SourceData::readAndPreprocess(const QByteArray& encoding, bool bAutoDetect)
             if(gOptions->m_PreProcessorCmd.isEmpty())
             {
                 // No preprocessing: Read the file directly:
-                if(!m_normalData.readFile(faIn))
+                if(!m_normalData.mapFile(faIn))
                 {
                     mErrors.append(faIn.getStatusText());
                     return;
@@ -521,8 +621,8 @@ void SourceData::readAndPreprocess(const QByteArray& encoding, bool bAutoDetect)
         }
         else if(gOptions->ignoreComments() || gOptions->m_bIgnoreCase)
         {
-            // We need a copy of the normal data.
-            m_lmppData.copyBufFrom(m_normalData);
+            // We need a second decoded copy of the normal data, the raw bytes can be shared.
+            m_lmppData.shareBufFrom(m_normalData);
         }
     }
     else
@@ -531,7 +631,8 @@ void SourceData::readAndPreprocess(const QByteArray& encoding, bool bAutoDetect)
         return;
     }
 
-    if(!m_lmppData.preprocess(pEncoding2, true))
+    const bool bSuccess = m_lmppData.preprocess(pEncoding2, true);
+    if(!bSuccess)
     {
         mErrors.append(overSizedFile);
         return;
@@ -544,7 +645,7 @@ void SourceData::readAndPreprocess(const QByteArray& encoding, bool bAutoDetect)
         // Preprocessing command may result in smaller data buffer so adjust size
         for(qint64 i = m_lmppData.lineCount(); i < m_normalData.lineCount(); ++i)
         { // Set all empty lines to point to the end of the buffer.
-            m_lmppData.m_v->push_back(LineData(m_lmppData.m_unicodeBuf, m_lmppData.m_unicodeBuf->length()));
+            m_lmppData.m_v->push_back(m_lmppData.makeLineData(m_lmppData.bufferLength()));
         }
 
         m_lmppData.mLineCount = m_normalData.lineCount();
@@ -564,22 +665,55 @@ void SourceData::readAndPreprocess(const QByteArray& encoding, bool bAutoDetect)
     }
 }
 
+/*
+    Text that fits into Latin-1 can be split into lines and diffed without decoding it.
+    That is any data in a Latin-1 encoding and pure ASCII in the common ASCII compatible encodings.
+    start is set past a byte order mark the decoder would have dropped.
+    See preprocess() for how the requested and the detected encoding are both checked.
+*/
+bool SourceData::FileData::isLatin1Compatible(const QByteArray& encoding, const char* data, qsizetype size, qsizetype& start)
+{
+    start = 0;
+
+    const QByteArray name = encoding.toUpper();
+    if(name == "ISO-8859-1" || name == "LATIN1")
+        return true;
+
+    if(name == "UTF-8-BOM" && size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0)
+        start = 3;
+    else if(name != "UTF-8" && name != "US-ASCII" && !name.startsWith("ISO-8859-") && !name.startsWith("WINDOWS-125"))
+        return false;
+
+    return LineScanner::isAscii(data + start, data + size);
+}
+
+LineData SourceData::FileData::makeLineData(qsizetype offset, qsizetype size, qsizetype firstNonWhite, bool bSkipable, bool bPureComment) const
+{
+    if(mLatin1Buf != nullptr)
+        return LineData(mLatin1Buf, offset, size, firstNonWhite, bSkipable, bPureComment);
+
+    return LineData(m_unicodeBuf, offset, size, firstNonWhite, bSkipable, bPureComment);
+}
+
 /** Prepare the linedata vector for every input line.*/
 bool SourceData::FileData::preprocess(const QByteArray& encoding, bool removeComments)
 {
-    if(m_pBuf == nullptr)
+    if(!hasData())
         return true;
 
+    const char* pRawData = rawData();
+
     QString line;
     QString curChar, prevChar = "";
     LineType lines = 0;
+    bool bEOL = false;
     qsizetype lastOffset = 0;
     std::unique_ptr<CommentParser> parser(new DefaultCommentParser());
 
     // detect line end style
     m_eLineEndStyle = eLineEndStyleUndefined;
 
-    QByteArray pCodec = detectEncoding(m_pBuf.get(), mDataSize).value_or(encoding);
+    QByteArray pCodec = detectEncoding(pRawData, mDataSize).value_or(encoding);
 
     if(mDataSize > limits<qint32>::max())
     {
@@ -589,123 +723,326 @@ bool SourceData::FileData::preprocess(const QByteArray& encoding, bool removeCom
 
     try
     {
-        EncodedData ba = QByteArray::fromRawData(m_pBuf.get(), (qsizetype)(mDataSize));
+        EncodedData ba = QByteArray::fromRawData(pRawData, (qsizetype)(mDataSize));
 
         ba.setEncoding(encoding);
         mHasBOM = ba.hasBOM();
         m_bIncompleteConversion = false;
         m_unicodeBuf->clear();
+        mLatin1Buf.reset();
 
         assert(m_unicodeBuf->length() == 0);
 
         mHasEOLTermination = false;
-        while(!ba.atEnd())
+
+        QString decoded;
+        /*
+            A byte order mark or an encoding tag can say something else than the requested encoding. The data is only
+            kept as is if both agree, so it looks the same as decoding it with the requested encoding.
+        */
+        qsizetype latin1Start = 0, detectedStart = 0;
+        if(gOptions->mCompactTextStorage && isLatin1Compatible(pCodec, pRawData, (qsizetype)mDataSize, detectedStart) &&
+           isLatin1Compatible(encoding, pRawData, (qsizetype)mDataSize, latin1Start) && latin1Start == detectedStart)
         {
-            line.clear();
-            if(lines >= limits<LineType>::max() - 5)
+            // Same as below but on the raw bytes. Nothing needs to be decoded and the text takes half the memory.
+            const char* data = pRawData + latin1Start;
+            const qsizetype size = (qsizetype)mDataSize - latin1Start;
+            qsizetype pos = 0;
+
+            mLatin1Buf = std::make_shared<QByteArray>();
+            mLatin1Buf->reserve(size);
+            while(pos < size)
             {
-                reset();
-                return false;
-            }
+                if(lines >= limits<LineType>::max() - 5)
+                {
+                    reset();
+                    return false;
+                }
 
-            prevChar = curChar;
-            ba.readNext(curChar);
+                const qsizetype lineStart = pos;
+                qsizetype firstNonwhite = 0;
 
-            qsizetype firstNonwhite = 0;
-            bool foundNonWhite = false;
+                const char* stop = LineScanner::findLineEndOrSpecial(data + pos, data + size);
+                const char* nonWhite = LineScanner::skipAsciiWhiteSpace(data + pos, stop);
+                while(nonWhite < stop && QChar::fromLatin1(*nonWhite).isSpace())
+                    nonWhite = LineScanner::skipAsciiWhiteSpace(nonWhite + 1, stop);
 
-            while(curChar != u'\n' && curChar != u'\r')
-            {
-                if(curChar[0].isNull() || curChar[0].isNonCharacter())
+                if(nonWhite < stop)
+                    firstNonwhite = nonWhite - data - lineStart + 1;
+
+                pos = stop - data;
+                if(pos < size && data[pos] == '\0')
                 {
                     m_v->clear();
                     return true;
                 }
 
-                if(curChar == QChar::ReplacementCharacter)
-                    m_bIncompleteConversion = true;
+                //Qt6 intrudes 64bit sizes
+                if(pos - lineStart >= limits<LineType>::max())
+                {
+                    reset();
+                    return false;
+                }
 
-                line.append(curChar);
-                if(!curChar[0].isSpace() && !foundNonWhite)
+                // The comment parser works on QString so each line is widened for it.
+                line.assign(QLatin1StringView(data + lineStart, pos - lineStart));
+                bEOL = pos < size;
+                if(bEOL)
                 {
-                    firstNonwhite = line.length();
-                    foundNonWhite = true;
+                    e_LineEndStyle style = eLineEndStyleUnix;
+                    if(data[pos] == '\r')
+                    {
+                        style = eLineEndStyleOldMac;
+                        if(pos + 1 < size && data[pos + 1] == '\n')
+                        {
+                            style = eLineEndStyleDos;
+                            ++pos;
+                        }
+                    }
+                    ++pos;
+
+                    if(m_eLineEndStyle == eLineEndStyleUndefined)
+                        m_eLineEndStyle = style;
                 }
 
-                if(ba.atEnd())
-                    break;
+                parser->processLine(line);
+                if(removeComments)
+                    parser->removeComment(line);
 
-                prevChar = curChar;
-                ba.readNext(curChar);
-            }
+                ++lines;
+                m_v->push_back(LineData(mLatin1Buf, lastOffset, line.length(), firstNonwhite, parser->isSkipable(), parser->isPureComment()));
+                if(removeComments)
+                    mLatin1Buf->append(line.toLatin1());
+                else
+                    mLatin1Buf->append(data + lineStart, line.length());
+                //kdiff3 internally uses only unix style endings for simplicity.
+                if(bEOL)
+                    mLatin1Buf->append('\n');
 
-            if(m_eLineEndStyle == eLineEndStyleUndefined)
+                lastOffset = mLatin1Buf->length();
+            }
+        }
+        else if(ba.readAll(decoded))
+        {
+            /*
+                Fast path: the whole buffer was decoded in one go so lines can be split without calling the decoder again.
+                Lines never get longer and line ends never grow, so the text is compacted into the decoded buffer
+                itself instead of being copied. What is written stays behind what is still to be read.
+            */
+            QChar* data = decoded.data();
+            const qsizetype size = decoded.size();
+            qsizetype pos = 0;
+
+            while(pos < size)
             {
-                switch(curChar[0].unicode())
+                if(lines >= limits<LineType>::max() - 5)
+                {
+                    reset();
+                    return false;
+                }
+
+                const qsizetype lineStart = pos;
+                qsizetype firstNonwhite = 0;
+
+                for(;;)
                 {
-                    case u'\n':
-                        m_eLineEndStyle = eLineEndStyleUnix;
+                    const QChar* stop = LineScanner::findLineEndOrSpecial(data + pos, data + size);
+                    if(firstNonwhite == 0)
+                    {
+                        const QChar* nonWhite = LineScanner::skipAsciiWhiteSpace(data + pos, stop);
+                        while(nonWhite < stop && nonWhite->isSpace())
+                            nonWhite = LineScanner::skipAsciiWhiteSpace(nonWhite + 1, stop);
+
+                        if(nonWhite < stop)
+                            firstNonwhite = nonWhite - data - lineStart + 1;
+                    }
+
+                    pos = stop - data;
+                    if(pos == size || data[pos] == u'\n' || data[pos] == u'\r')
                         break;
-                    case u'\r':
-                        if((FileOffset)lastOffset < mDataSize)
-                        {
-                            QString nextChar;
-                            quint64 i = ba.peekChar(nextChar);
-                            if(i == 0)
-                                break;
 
-                            if(nextChar[0] == u'\n')
-                            {
-                                prevChar = curChar;
-                                ba.readNext(curChar);
-                                m_eLineEndStyle = eLineEndStyleDos;
-                                break;
-                            }
+                    // Rare characters the scanner leaves for us to classify.
+                    const QChar c = data[pos];
+                    if(c.isNull() || c.isNonCharacter())
+                    {
+                        m_v->clear();
+                        return true;
+                    }
+
+                    if(c == QChar::ReplacementCharacter)
+                        m_bIncompleteConversion = true;
+
+                    ++pos;
+                    if(firstNonwhite == 0 && !c.isSpace())
+                        firstNonwhite = pos - lineStart;
+                }
+
+                //Qt6 intrudes 64bit sizes
+                if(pos - lineStart >= limits<LineType>::max())
+                {
+                    reset();
+                    return false;
+                }
+
+                line = QString::fromRawData(data + lineStart, pos - lineStart);
+                bEOL = pos < size;
+                if(bEOL)
+                {
+                    e_LineEndStyle style = eLineEndStyleUnix;
+                    if(data[pos] == u'\r')
+                    {
+                        style = eLineEndStyleOldMac;
+                        if(pos + 1 < size && data[pos + 1] == u'\n')
+                        {
+                            style = eLineEndStyleDos;
+                            ++pos;
                         }
+                    }
+                    ++pos;
 
-                        //old mac style ending.
-                        m_eLineEndStyle = eLineEndStyleOldMac;
-                        break;
+                    if(m_eLineEndStyle == eLineEndStyleUndefined)
+                        m_eLineEndStyle = style;
                 }
-            }
-            parser->processLine(line);
-            if(removeComments)
-                parser->removeComment(line);
-            //Qt6 intrudes 64bit sizes
-            if(line.size() >= limits<LineType>::max())
-            {
-                reset();
-                return false;
+
+                parser->processLine(line);
+                if(removeComments)
+                    parser->removeComment(line);
+
+                ++lines;
+                m_v->push_back(LineData(m_unicodeBuf, lastOffset, line.length(), firstNonwhite, parser->isSkipable(), parser->isPureComment()));
+                // Source and destination can overlap, line still points into data unless comments were removed.
+                std::memmove(data + lastOffset, line.constData(), line.length() * sizeof(QChar));
+                lastOffset += line.length();
+                //kdiff3 internally uses only unix style endings for simplicity.
+                if(bEOL)
+                    data[lastOffset++] = u'\n';
             }
 
-            ++lines;
-            m_v->push_back(LineData(m_unicodeBuf, lastOffset, line.length(), firstNonwhite, parser->isSkipable(), parser->isPureComment()));
-            //The last line may not have an EOL mark. In that case don't add one to our buffer.
-            m_unicodeBuf->append(line);
-            if(curChar == u'\n' || curChar == u'\r' || prevChar == u'\r')
+            line.clear();
+            decoded.truncate(lastOffset);
+            *m_unicodeBuf = std::move(decoded);
+        }
+        else
+        {
+            while(!ba.atEnd())
             {
-                //kdiff3 internally uses only unix style endings for simplicity.
-                m_unicodeBuf->append(u'\n');
+                line.clear();
+                if(lines >= limits<LineType>::max() - 5)
+                {
+                    reset();
+                    return false;
+                }
+
+                prevChar = curChar;
+                ba.readNext(curChar);
+                // Second half of a "\r\n" pair whose line was already ended by the '\r'.
+                if(prevChar == u'\r' && curChar == u'\n')
+                {
+                    if(ba.atEnd())
+                        break;
+
+                    prevChar = curChar;
+                    ba.readNext(curChar);
+                }
+
+                qsizetype firstNonwhite = 0;
+                bool foundNonWhite = false;
+
+                while(curChar != u'\n' && curChar != u'\r')
+                {
+                    if(curChar[0].isNull() || curChar[0].isNonCharacter())
+                    {
+                        m_v->clear();
+                        return true;
+                    }
+
+                    if(curChar == QChar::ReplacementCharacter)
+                        m_bIncompleteConversion = true;
+
+                    line.append(curChar);
+                    if(!curChar[0].isSpace() && !foundNonWhite)
+                    {
+                        firstNonwhite = line.length();
+                        foundNonWhite = true;
+                    }
+
+                    if(ba.atEnd())
+                        break;
+
+                    prevChar = curChar;
+                    ba.readNext(curChar);
+                }
+
+                if(m_eLineEndStyle == eLineEndStyleUndefined)
+                {
+                    switch(curChar[0].unicode())
+                    {
+                        case u'\n':
+                            m_eLineEndStyle = eLineEndStyleUnix;
+                            break;
+                        case u'\r':
+                            if((FileOffset)lastOffset < mDataSize)
+                            {
+                                QString nextChar;
+                                quint64 i = ba.peekChar(nextChar);
+                                if(i == 0)
+                                    break;
+
+                                if(nextChar[0] == u'\n')
+                                {
+                                    prevChar = curChar;
+                                    ba.readNext(curChar);
+                                    m_eLineEndStyle = eLineEndStyleDos;
+                                    break;
+                                }
+                            }
+
+                            //old mac style ending.
+                            m_eLineEndStyle = eLineEndStyleOldMac;
+                            break;
+                    }
+                }
+                parser->processLine(line);
+                if(removeComments)
+                    parser->removeComment(line);
+                //Qt6 intrudes 64bit sizes
+                if(line.size() >= limits<LineType>::max())
+                {
+                    reset();
+                    return false;
+                }
+
+                ++lines;
+                m_v->push_back(LineData(m_unicodeBuf, lastOffset, line.length(), firstNonwhite, parser->isSkipable(), parser->isPureComment()));
+                //The last line may not have an EOL mark. In that case don't add one to our buffer.
+                m_unicodeBuf->append(line);
+                if(curChar == u'\n' || curChar == u'\r' || prevChar == u'\r')
+                {
+                    //kdiff3 internally uses only unix style endings for simplicity.
+                    m_unicodeBuf->append(u'\n');
+                }
+
+                assert(m_unicodeBuf->length() != lastOffset);
+                lastOffset = m_unicodeBuf->length();
             }
 
-            assert(m_unicodeBuf->length() != lastOffset);
-            lastOffset = m_unicodeBuf->length();
+            bEOL = curChar == u'\n' || curChar == u'\r';
         }
 
         /*
             Process trailing new line as if there were a blank non-terminated line after it.
             But do nothing to the data buffer since this is a phantom line needed for internal purposes.
         */
-        if(curChar == u'\n' || curChar == u'\r')
+        if(bEOL)
         {
             mHasEOLTermination = true;
             ++lines;
 
             parser->processLine("");
-            m_v->push_back(LineData(m_unicodeBuf, lastOffset, 0, 0, parser->isSkipable(), parser->isPureComment()));
+            m_v->push_back(makeLineData(lastOffset, 0, 0, parser->isSkipable(), parser->isPureComment()));
         }
 
-        m_v->push_back(LineData(m_unicodeBuf, lastOffset));
+        m_v->push_back(makeLineData(lastOffset));
         m_bIsText = true;
 
         mLineCount = lines;
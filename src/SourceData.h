@@ -28,8 +28,8 @@ class SourceData
   public:
     [[nodiscard]] LineType lineCount() const;
     [[nodiscard]] qint64 getSizeBytes() const;
-    [[nodiscard]] const char* getBuf() const;
-    [[nodiscard]] const QString& getText() const;
+    [[nodiscard]] const char* getBuf() const; // Raw data, only kept where it can not be read again, see FileData::finishLoading().
+    [[nodiscard]] QString getText() const;
     [[nodiscard]] const std::shared_ptr<LineDataVector>& getLineDataForDisplay() const;
     [[nodiscard]] const std::shared_ptr<LineDataVector>& getLineDataForDiff() const;
 
@@ -43,12 +43,16 @@ class SourceData
     [[nodiscard]] bool isText() const;                 // is it pure text (vs. binary data)
     [[nodiscard]] bool isIncompleteConversion() const; // true if some replacement characters were found
     [[nodiscard]] bool isFromBuffer() const;           // was it set via setData() (vs. setFileAccess() or setFilename())
+    [[nodiscard]] bool isLocal() const { return mFromClipBoard || !m_fileAccess.isValid() || m_fileAccess.isLocal(); } // Reading needs no KIO job
     void setData(const QString& data);
     [[nodiscard]] bool isValid() const; // Either no file is specified or reading was successful
 
     // Returns a list of error messages if anything went wrong
     void readAndPreprocess(const QByteArray& encoding, bool bAutoDetectUnicode);
+    // Fails if the input changed since it was loaded.
     bool saveNormalDataAs(const QString& fileName);
+    // Reads the raw data of the input again for saving, call before the input file is renamed or overwritten.
+    bool loadRawData() { return m_normalData.loadRawData(); }
 
     [[nodiscard]] bool isBinaryEqualWith(const std::shared_ptr<SourceData>& other) const;
 
@@ -65,6 +69,7 @@ class SourceData
     void setEncoding(const QByteArray& encoding);
 
   protected:
+    void readAndDecode(const QByteArray& encoding, bool bAutoDetectUnicode);
     bool convertFileEncoding(const QString& fileNameIn, const QByteArray& pCodecIn,
                              const QString& fileNameOut, const QByteArray& pCodecOut);
 
@@ -88,10 +93,15 @@ class SourceData
         friend SourceData;
         bool mHasBOM = false;
 
-        std::unique_ptr<char[]> m_pBuf; //TODO: Phase out needlessly wastes memory and time by keeping second copy of file data.
+        std::shared_ptr<char[]> m_pBuf; // Only used for data that can not be mapped, see mapFile().
+        std::shared_ptr<const FileMapping> mMapping; // Only while loading, see finishLoading().
+        QString mRawFileName; // Where the raw data can be read again, empty for preprocessor output.
+        QByteArray mDigest; // Of the raw data, for binary comparison.
+        bool mbHasData = false;
         quint64 mDataSize = 0;
         qint64 mLineCount = 0; // Number of lines in m_pBuf1 and size of m_v1, m_dv12 and m_dv13
         std::shared_ptr<QString> m_unicodeBuf = std::make_shared<QString>();
+        std::shared_ptr<QByteArray> mLatin1Buf; // Used instead of m_unicodeBuf if the text fits into Latin-1, see preprocess().
         std::shared_ptr<LineDataVector> m_v=std::make_shared<LineDataVector>();
         bool m_bIsText = false;
         bool m_bIncompleteConversion = false;
@@ -101,12 +111,25 @@ class SourceData
       public:
         bool readFile(FileAccess& file);
         bool readFile(const QString& filename);
+        bool mapFile(FileAccess& file);
         bool writeFile(const QString& filename);
 
         bool preprocess(const QByteArray& encoding, bool removeComments);
+        [[nodiscard]] static bool isLatin1Compatible(const QByteArray& encoding, const char* data, qsizetype size, qsizetype& start);
+        [[nodiscard]] LineData makeLineData(qsizetype offset, qsizetype size = 0, qsizetype firstNonWhite = 0, bool bSkipable = false, bool bPureComment = false) const;
+        [[nodiscard]] qsizetype bufferLength() const { return mLatin1Buf != nullptr ? mLatin1Buf->length() : m_unicodeBuf->length(); }
         void reset();
-        void copyBufFrom(const FileData& src);
-
+        void shareBufFrom(const FileData& src);
+        void finishLoading();
+        bool loadRawData();
+        void releaseRawData()
+        {
+            m_pBuf.reset();
+            mMapping.reset();
+        }
+        [[nodiscard]] const char* rawData() const { return mMapping != nullptr ? mMapping->data() : m_pBuf.get(); }
+
+        [[nodiscard]] bool hasData() const { return mbHasData; }
         [[nodiscard]] bool isEmpty() const { return mDataSize == 0; }
 
         [[nodiscard]] bool isText() const { return m_bIsText || isEmpty(); }
@@ -0,0 +1,299 @@
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+
+#include "StreamingDiff.h"
+
+#include "LineScanner.h"
+#include "options.h"
+
+#include <algorithm>
+#include <string.h>
+#include <unordered_map>
+
+#include <QIODevice>
+
+StreamingDiff::StreamingDiff(const QString& fileName1, const QString& fileName2, const qint64 windowSize):
+    mWindow1(fileName1),
+    mWindow2(fileName2),
+    mWindowSize(windowSize)
+{
+    assert(windowSize > 0);
+}
+
+bool StreamingDiff::Window::fill(const qint64 windowSize)
+{
+    constexpr qint64 chunkSize = 1024 * 1024;
+
+    while(!mbAtEnd && (mData.size() < windowSize || lineCount() == 0))
+    {
+        const qsizetype oldSize = mData.size();
+        const qint64 toRead = oldSize < windowSize ? std::min(chunkSize, windowSize - oldSize) : chunkSize;
+
+        mData.resize(oldSize + toRead);
+        const qint64 bytesRead = mFile.read(mData.data() + oldSize, toRead);
+        mData.resize(oldSize + std::max<qint64>(bytesRead, 0));
+        if(bytesRead < 0)
+            return false;
+
+        if(bytesRead == 0)
+        {
+            mbAtEnd = true;
+            // The last line has no line end.
+            if(mData.size() > mLineStarts.back())
+                mLineStarts.push_back(mData.size());
+        }
+        else
+            findLines(oldSize);
+    }
+    return true;
+}
+
+void StreamingDiff::Window::findLines(qsizetype from)
+{
+    for(qsizetype pos = mData.indexOf('\n', from); pos >= 0; pos = mData.indexOf('\n', pos + 1))
+        mLineStarts.push_back(pos + 1);
+}
+
+void StreamingDiff::Window::drop(const LineType count)
+{
+    assert(count >= 0 && count <= lineCount());
+
+    const qsizetype bytes = mLineStarts[count];
+    mData.remove(0, bytes);
+    mLineStarts.erase(mLineStarts.begin(), mLineStarts.begin() + count);
+    for(qsizetype& start: mLineStarts)
+        start -= bytes;
+    mFirstLine += count;
+}
+
+QByteArray StreamingDiff::Window::line(const LineType line) const
+{
+    return mData.mid(mLineStarts[line], lineEnd(line) - mLineStarts[line]);
+}
+
+bool StreamingDiff::Window::identicalLines(const LineType line, const Window& other, const LineType otherLine) const
+{
+    const qsizetype start = mLineStarts[line];
+    const qsizetype size = mLineStarts[line + 1] - start;
+    const qsizetype otherStart = other.mLineStarts[otherLine];
+
+    // Comparing the line ends too tells a last line without one from the others.
+    return size == other.mLineStarts[otherLine + 1] - otherStart &&
+           memcmp(mData.constData() + start, other.mData.constData() + otherStart, size) == 0;
+}
+
+std::shared_ptr<LineDataVector> StreamingDiff::Window::lineData() const
+{
+    const std::shared_ptr<LineDataVector> lines = std::make_shared<LineDataVector>();
+    lines->reserve(mLineStarts.size());
+
+    const qsizetype end = mLineStarts.back();
+    if(LineScanner::isAscii(mData.constData(), mData.constData() + end))
+    {
+        // Nothing to decode, the lines are used in place.
+        const std::shared_ptr<QByteArray> buffer = std::make_shared<QByteArray>(mData);
+        for(LineType i = 0; i < lineCount(); ++i)
+        {
+            qsizetype size = lineEnd(i) - mLineStarts[i];
+            if(size > 0 && buffer->at(mLineStarts[i] + size - 1) == '\r')
+                --size;
+            lines->push_back(LineData(buffer, mLineStarts[i], size));
+        }
+        lines->push_back(LineData(buffer, end));
+        return lines;
+    }
+
+    // A '\n' is never part of another character in UTF-8, so the decoded text has the same lines.
+    const std::shared_ptr<QString> buffer = std::make_shared<QString>(QString::fromUtf8(mData.constData(), end));
+    qsizetype offset = 0;
+    for(LineType i = 0; i < lineCount(); ++i)
+    {
+        qsizetype lineEnd = buffer->indexOf(u'\n', offset);
+        if(lineEnd < 0)
+            lineEnd = buffer->size();
+
+        qsizetype size = lineEnd - offset;
+        if(size > 0 && buffer->at(lineEnd - 1) == u'\r')
+            --size;
+        lines->push_back(LineData(buffer, offset, size));
+        offset = lineEnd + 1;
+    }
+    lines->push_back(LineData(buffer, buffer->size()));
+    return lines;
+}
+
+/*
+    cut1 and cut2 come in as the limits of the search. The cut goes behind the last line in the limits that is
+    unique in both windows and matched. If there is none the last matched line will do, identical in both cases.
+*/
+bool StreamingDiff::findCut(const DiffList& diffList, const std::shared_ptr<LineDataVector>& lines1, const std::shared_ptr<LineDataVector>& lines2,
+                            LineType& cut1, LineType& cut2) const
+{
+    const LineHashOptions hashOptions{true, gOptions->m_bIgnoreNumbers, false};
+    const std::shared_ptr<const std::vector<size_t>> hashes1 = lines1->lineHashes(hashOptions);
+    const std::shared_ptr<const std::vector<size_t>> hashes2 = lines2->lineHashes(hashOptions);
+
+    std::unordered_map<size_t, qint32> counts1, counts2;
+    for(LineType i = 0; i < mWindow1.lineCount(); ++i)
+        ++counts1[(*hashes1)[i]];
+    for(LineType i = 0; i < mWindow2.lineCount(); ++i)
+        ++counts2[(*hashes2)[i]];
+
+    const LineType limit1 = cut1;
+    const LineType limit2 = cut2;
+    bool bFound = false;
+    bool bAnchor = false;
+    LineType i1 = 0;
+    LineType i2 = 0;
+    for(const Diff& d: diffList)
+    {
+        for(LineType k = 0; k < d.numberOfEquals(); ++k, ++i1, ++i2)
+        {
+            if(i1 >= limit1 || i2 >= limit2)
+                return bFound;
+            if(!mWindow1.identicalLines(i1, mWindow2, i2))
+                continue;
+
+            const bool bUnique = counts1[(*hashes1)[i1]] == 1 && counts2[(*hashes2)[i2]] == 1;
+            if(bUnique || !bAnchor)
+            {
+                cut1 = i1 + 1;
+                cut2 = i2 + 1;
+                bFound = true;
+                bAnchor = bAnchor || bUnique;
+            }
+        }
+        i1 += (LineType)d.diff1();
+        i2 += (LineType)d.diff2();
+    }
+    return bFound;
+}
+
+/*
+    Writes diffList up to the cut. Matched lines that are not identical byte for byte are written as changes.
+*/
+void StreamingDiff::writeDiffs(QIODevice& out, const DiffList& diffList, const LineType cut1, const LineType cut2)
+{
+    LineType i1 = 0;
+    LineType i2 = 0;
+    // Start of the change not written yet.
+    LineType begin1 = 0;
+    LineType begin2 = 0;
+    for(const Diff& d: diffList)
+    {
+        for(LineType k = 0; k < d.numberOfEquals() && i1 < cut1 && i2 < cut2; ++k, ++i1, ++i2)
+        {
+            if(mWindow1.identicalLines(i1, mWindow2, i2))
+            {
+                writeChange(out, begin1, i1 - begin1, begin2, i2 - begin2);
+                begin1 = i1 + 1;
+                begin2 = i2 + 1;
+            }
+        }
+        if(i1 >= cut1 && i2 >= cut2)
+            break;
+
+        i1 += (LineType)d.diff1();
+        i2 += (LineType)d.diff2();
+    }
+    writeChange(out, begin1, cut1 - begin1, begin2, cut2 - begin2);
+}
+
+void StreamingDiff::writeChange(QIODevice& out, const LineType begin1, const LineType count1, const LineType begin2, const LineType count2)
+{
+    if(count1 == 0 && count2 == 0)
+        return;
+
+    mbHasDifferences = true;
+
+    // Without lines diff names the line before.
+    const auto range = [](const quint64 first, const LineType count) -> QByteArray {
+        if(count <= 1)
+            return QByteArray::number(count == 0 ? first : first + 1);
+        return QByteArray::number(first + 1) + ',' + QByteArray::number(first + count);
+    };
+    const char command = count1 == 0 ? 'a' : count2 == 0 ? 'd' : 'c';
+    out.write(QByteArray(range(mWindow1.firstLine() + begin1, count1) + command + range(mWindow2.firstLine() + begin2, count2) + '\n'));
+
+    const auto writeLines = [&out](const Window& window, const char* prefix, const LineType begin, const LineType count) {
+        for(LineType i = begin; i < begin + count; ++i)
+        {
+            out.write(QByteArray(prefix + window.line(i) + '\n'));
+            if(window.lacksNewLine(i))
+                out.write("\\ No newline at end of file\n");
+        }
+    };
+    writeLines(mWindow1, "< ", begin1, count1);
+    if(count1 > 0 && count2 > 0)
+        out.write("---\n");
+    writeLines(mWindow2, "> ", begin2, count2);
+}
+
+bool StreamingDiff::run(QIODevice& out)
+{
+    mbHasDifferences = false;
+    if(!mWindow1.open())
+    {
+        mErrorString = mWindow1.errorString();
+        return false;
+    }
+    if(!mWindow2.open())
+    {
+        mErrorString = mWindow2.errorString();
+        return false;
+    }
+
+    for(;;)
+    {
+        if(!mWindow1.fill(mWindowSize))
+        {
+            mErrorString = mWindow1.errorString();
+            return false;
+        }
+        if(!mWindow2.fill(mWindowSize))
+        {
+            mErrorString = mWindow2.errorString();
+            return false;
+        }
+
+        const LineType size1 = mWindow1.lineCount();
+        const LineType size2 = mWindow2.lineCount();
+        if(size1 == 0 && size2 == 0)
+            return true;
+
+        // The lines matching the end of a window may not be read yet, so only the first half is final.
+        LineType cut1 = mWindow1.atEnd() ? size1 : std::max(size1 / 2, 1);
+        LineType cut2 = mWindow2.atEnd() ? size2 : std::max(size2 / 2, 1);
+        if(size1 == 0 || size2 == 0)
+            writeChange(out, 0, cut1, 0, cut2);
+        else
+        {
+            const std::shared_ptr<LineDataVector> lines1 = mWindow1.lineData();
+            const std::shared_ptr<LineDataVector> lines2 = mWindow2.lineData();
+            DiffList diffList;
+            diffList.runDiff(lines1, 0, size1, lines2, 0, size2);
+
+            if(mWindow1.atEnd() && mWindow2.atEnd())
+                writeDiffs(out, diffList, cut1, cut2);
+            else if(findCut(diffList, lines1, lines2, cut1, cut2))
+                writeDiffs(out, diffList, cut1, cut2);
+            else
+            {
+                // Nothing to hold on to. A file that is read completely may still match later lines of the other.
+                if(mWindow1.atEnd())
+                    cut1 = 0;
+                if(mWindow2.atEnd())
+                    cut2 = 0;
+                writeChange(out, 0, cut1, 0, cut2);
+            }
+        }
+
+        mWindow1.drop(cut1);
+        mWindow2.drop(cut2);
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ * KDiff3 - Text Diff And Merge Tool
+ *
+ * SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ */
+
+#ifndef STREAMINGDIFF_H
+#define STREAMINGDIFF_H
+
+#include "diff.h"
+
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+class QIODevice;
+
+/*
+    Compares two files of any size without loading them, for use from the command line.
+
+    Both files are read a window at a time and the windows are compared with the usual line matching. The
+    result is written up to the last line that occurs once in each window and matches, such a line anchors
+    the next window pair. Everything before the anchor is dropped and the windows are filled up again.
+    Memory stays at a small multiple of the window size, whatever the size of the files.
+
+    The output is that of diff without options ("normal" format) so it can be fed to patch. Line matching
+    ignores white space like the GUI does, but lines are only reported equal if their bytes are.
+    Text must be UTF-8 or a compatible encoding.
+*/
+class StreamingDiff
+{
+  public:
+    static constexpr qint64 defaultWindowSize = 64 * 1024 * 1024;
+
+    StreamingDiff(const QString& fileName1, const QString& fileName2, const qint64 windowSize = defaultWindowSize);
+
+    // Writes the differences to out as they are found. Returns false if a file could not be read.
+    bool run(QIODevice& out);
+
+    [[nodiscard]] bool hasDifferences() const { return mbHasDifferences; }
+    [[nodiscard]] const QString& errorString() const { return mErrorString; }
+
+  private:
+    class Window
+    {
+      public:
+        explicit Window(const QString& fileName): mFile(fileName) {}
+
+        bool open() { return mFile.open(QIODevice::ReadOnly); }
+        [[nodiscard]] QString errorString() const { return mFile.fileName() + u": " + mFile.errorString(); }
+
+        // Reads until the window holds windowSize bytes or the file ends. Always reads at least one line.
+        bool fill(const qint64 windowSize);
+        // Forgets the first count lines.
+        void drop(const LineType count);
+
+        // Number of complete lines in the window.
+        [[nodiscard]] LineType lineCount() const { return (LineType)mLineStarts.size() - 1; }
+        [[nodiscard]] quint64 firstLine() const { return mFirstLine; }
+        [[nodiscard]] bool atEnd() const { return mbAtEnd; }
+        // True if the line is the last one of the file and has no line end.
+        [[nodiscard]] bool lacksNewLine(const LineType line) const { return mbAtEnd && line == lineCount() - 1 && !mData.endsWith('\n'); }
+
+        // Bytes of the line without the '\n'.
+        [[nodiscard]] QByteArray line(const LineType line) const;
+        [[nodiscard]] qsizetype lineEnd(const LineType line) const { return lacksNewLine(line) ? mLineStarts[line + 1] : mLineStarts[line + 1] - 1; }
+        [[nodiscard]] bool identicalLines(const LineType line, const Window& other, const LineType otherLine) const;
+        [[nodiscard]] std::shared_ptr<LineDataVector> lineData() const;
+
+      private:
+        void findLines(qsizetype from);
+
+        QFile mFile;
+        QByteArray mData;
+        // Start of each complete line in mData, followed by the end of the last one.
+        std::vector<qsizetype> mLineStarts{0};
+        quint64 mFirstLine = 0;
+        bool mbAtEnd = false;
+    };
+
+    // Finds where to stop writing in this round. Returns false if nothing before the limits matches.
+    [[nodiscard]] bool findCut(const DiffList& diffList, const std::shared_ptr<LineDataVector>& lines1, const std::shared_ptr<LineDataVector>& lines2,
+                               LineType& cut1, LineType& cut2) const;
+    void writeDiffs(QIODevice& out, const DiffList& diffList, const LineType cut1, const LineType cut2);
+    void writeChange(QIODevice& out, const LineType begin1, const LineType count1, const LineType begin2, const LineType count2);
+
+    Window mWindow1;
+    Window mWindow2;
+    qint64 mWindowSize;
+    bool mbHasDifferences = false;
+    QString mErrorString;
+};
+
+#endif /* STREAMINGDIFF_H */
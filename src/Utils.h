@@ -31,6 +31,7 @@ class Utils
     static bool wildcardMultiMatch(const QString& wildcard, const QString& testString, bool bCaseSensitive);
     static QString getArguments(QString cmd, QString& program, QStringList& args);
     static bool isEndOfLine(QChar c) { return c == u'\n'; } //internally all line endings are converted to '\n'
+    static bool isEndOfLine(char c) { return c == '\n'; }
 
     static void calcTokenPos(const QString& s, qint32 posOnScreen, qsizetype& pos1, qsizetype& pos2);
     static QString calcHistoryLead(const QString& s);
@@ -0,0 +1,135 @@
+// clang-format off
+/*
+ KDiff3 - Text Diff And Merge Tool
+
+ SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ SPDX-License-Identifier: GPL-2.0-or-later
+*/
+// clang-format on
+
+#include "../ContentHashCache.h"
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTemporaryFile>
+#include <QTest>
+#include <QThread>
+
+class ContentHashCacheTest: public QObject
+{
+    Q_OBJECT;
+
+  private Q_SLOTS:
+    void testSaveAndLoad()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath("cache/filehashes");
+        const ContentHashCache::Key key{1, 2, 3, 1000000000, 1000000000};
+        const ContentHashCache::Key otherKey{1, 2, 3, 1000000000, 2000000000};
+        const QByteArray hash = QCryptographicHash::hash("abc", ContentHashCache::algorithm);
+
+        {
+            ContentHashCache cache(fileName);
+            QVERIFY(!cache.find(key).has_value());
+            cache.insert(key, hash);
+            QCOMPARE(cache.find(key).value(), hash);
+            QVERIFY(!cache.find(otherKey).has_value());
+
+            // Just written, the file might change again within the same time stamp.
+            const ContentHashCache::Key recentKey{1, 2, 3, 1000000000, QDateTime::currentMSecsSinceEpoch() * 1000000};
+            cache.insert(recentKey, hash);
+            QVERIFY(!cache.find(recentKey).has_value());
+
+            QVERIFY(cache.save());
+        }
+
+        ContentHashCache cache(fileName);
+        QCOMPARE(cache.find(key).value(), hash);
+        QVERIFY(!cache.find(otherKey).has_value());
+    }
+
+    void testEviction()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath("filehashes");
+        const ContentHashCache::Key first{1, 2, 3, 1000000000, 1000000000};
+        const ContentHashCache::Key second{1, 3, 3, 1000000000, 1000000000};
+        const ContentHashCache::Key third{1, 4, 3, 1000000000, 1000000000};
+        const QByteArray hash = QCryptographicHash::hash("abc", ContentHashCache::algorithm);
+
+        {
+            ContentHashCache cache(fileName, 2);
+            cache.insert(first, hash);
+            QThread::msleep(10);
+            cache.insert(second, hash);
+            QThread::msleep(10);
+            // Used again, now the second one is the oldest.
+            QVERIFY(cache.find(first).has_value());
+            QThread::msleep(10);
+            cache.insert(third, hash);
+            QVERIFY(cache.save());
+        }
+
+        ContentHashCache cache(fileName, 2);
+        QVERIFY(cache.find(first).has_value());
+        QVERIFY(!cache.find(second).has_value());
+        QVERIFY(cache.find(third).has_value());
+    }
+
+    void testDamagedFile()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath("filehashes");
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("not a cache");
+        file.close();
+
+        ContentHashCache cache(fileName);
+        QVERIFY(!cache.find(ContentHashCache::Key{1, 2, 3, 4, 5}).has_value());
+    }
+
+#ifndef Q_OS_WIN
+    void testKey()
+    {
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        file.write("first");
+        file.flush();
+
+        const std::optional<ContentHashCache::Key> key = ContentHashCache::keyOf(file.fileName());
+        QVERIFY(key.has_value());
+        QCOMPARE(key->size, qint64(5));
+        QVERIFY(ContentHashCache::keyOf(file.fileName()) == key);
+
+        file.write(" and second");
+        file.flush();
+        QVERIFY(ContentHashCache::keyOf(file.fileName()) != key);
+
+        // Same size and modification time as before, but a new status change time.
+        const QDateTime modified = QDateTime::fromSecsSinceEpoch(1000000000);
+        QVERIFY(file.setFileTime(modified, QFileDevice::FileModificationTime));
+        const std::optional<ContentHashCache::Key> writtenKey = ContentHashCache::keyOf(file.fileName());
+        QThread::msleep(50);
+        QVERIFY(file.seek(0));
+        file.write("third");
+        file.flush();
+        QVERIFY(file.setFileTime(modified, QFileDevice::FileModificationTime));
+        const std::optional<ContentHashCache::Key> rewrittenKey = ContentHashCache::keyOf(file.fileName());
+        QVERIFY(rewrittenKey.has_value());
+        QCOMPARE(rewrittenKey->size, writtenKey->size);
+        QCOMPARE(rewrittenKey->modified, writtenKey->modified);
+        QVERIFY(rewrittenKey != writtenKey);
+
+        QVERIFY(!ContentHashCache::keyOf(QDir::tempPath()).has_value());
+        QVERIFY(!ContentHashCache::keyOf(file.fileName() + ".missing").has_value());
+    }
+#endif // !Q_OS_WIN
+};
+
+QTEST_MAIN(ContentHashCacheTest);
+
+#include "ContentHashCacheTest.moc"
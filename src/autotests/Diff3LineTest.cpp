@@ -11,6 +11,7 @@
 #include "../diff.h"
 #include "../options.h"
 
+#include <iterator>
 #include <memory>
 
 #include <QObject>
@@ -81,6 +82,57 @@ class Diff3LineTest: public QObject
         QVERIFY(!entry->isEqualBC());
         ++entry;
     }
+
+    /*
+        calcDiff3LineListUsingAC inserts lines from C in the middle of the list while walking it.
+        The list must keep its order and iterators taken before the insert.
+    */
+    void insertTest()
+    {
+        Diff3LineList diff3List;
+        DiffList diffListAB = {{0, 1, 1}, {3, 0, 0}};
+        DiffList diffListAC = {{1, 1, 2}, {2, 0, 0}};
+
+        diff3List.calcDiff3LineListUsingAB(&diffListAB);
+        const Diff3LineList::const_iterator lineA1 = std::next(diff3List.cbegin());
+        QCOMPARE(lineA1->getLineA(), 1);
+
+        diff3List.calcDiff3LineListUsingAC(&diffListAC);
+        QCOMPARE(diff3List.size(), 6);
+        QCOMPARE(lineA1->getLineA(), 1);
+        QVERIFY(std::prev(lineA1, 2) == std::next(diff3List.cbegin()));
+
+        const LineType expectedA[] = {0, LineRef::invalid, LineRef::invalid, 1, 2, 3};
+        const LineType expectedC[] = {0, 1, 2, LineRef::invalid, 3, 4};
+        qint32 i = 0;
+        for(const Diff3Line& d3l: diff3List)
+        {
+            QCOMPARE(d3l.getLineA(), expectedA[i]);
+            QCOMPARE(d3l.getLineC(), expectedC[i]);
+            ++i;
+        }
+        for(auto it = diff3List.crbegin(); it != diff3List.crend(); ++it)
+        {
+            --i;
+            QCOMPARE(it->getLineC(), expectedC[i]);
+        }
+        QVERIFY(diff3List.crbegin()->isEqualBC());
+
+        // The vector of pointers follows the list order.
+        Diff3LineVector d3lv;
+        diff3List.calcDiff3LineVector(d3lv);
+        QCOMPARE(d3lv.size(), 6);
+        for(i = 0; i < 6; ++i)
+            QCOMPARE(d3lv[i]->getLineC(), expectedC[i]);
+        QVERIFY(&*diff3List.cbegin() == d3lv[0]);
+
+        const Diff3LineList copy = diff3List;
+        diff3List.remove(Diff3Line());
+        QVERIFY(diff3List == copy);
+        diff3List.remove(*d3lv[1]);
+        QCOMPARE(diff3List.size(), 5);
+        QCOMPARE(std::next(diff3List.cbegin())->getLineC(), 2);
+    }
 };
 
 QTEST_MAIN(Diff3LineTest);
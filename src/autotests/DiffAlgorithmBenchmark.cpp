@@ -0,0 +1,138 @@
+// clang-format off
+/*
+ KDiff3 - Text Diff And Merge Tool
+
+ SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ SPDX-License-Identifier: GPL-2.0-or-later
+*/
+// clang-format on
+
+#include "../diff.h"
+#include "../options.h"
+
+#include "SourceDataMoc.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QDir>
+#include <QRandomGenerator>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryFile>
+#include <QTest>
+
+/*
+    Compares the line matching algorithms on the alignment test data in test/testdata and on generated code
+    with reordered blocks. Run with -iterations for stable numbers.
+*/
+class DiffAlgorithmBenchmark: public QObject
+{
+    Q_OBJECT;
+  private:
+    QTemporaryFile generatedFile;
+    QTemporaryFile reorderedFile;
+
+    static void addRows(const QString& name, const QString& file1, const QString& file2)
+    {
+        QTest::addRow("%s gnu", qPrintable(name)) << file1 << file2 << (qint32)eDiffAlgorithmGnuDiff;
+        QTest::addRow("%s histogram", qPrintable(name)) << file1 << file2 << (qint32)eDiffAlgorithmHistogram;
+    }
+
+  private Q_SLOTS:
+    void initTestCase()
+    {
+        // Similar functions in blocks, the second file has the blocks shuffled and a few lines changed.
+        std::vector<QByteArray> blocks;
+        for(qint32 i = 0; i < 400; ++i)
+        {
+            QByteArray block;
+            block += "int function" + QByteArray::number(i) + "(int value)\n{\n";
+            for(qint32 j = 0; j < 8; ++j)
+                block += "    value = value * " + QByteArray::number(j + 2) + " + " + QByteArray::number(i % 7) + ";\n";
+            block += "    return value;\n}\n\n";
+            blocks.push_back(block);
+        }
+
+        QVERIFY(generatedFile.open());
+        for(const QByteArray& block: blocks)
+            generatedFile.write(block);
+        generatedFile.close();
+
+        QRandomGenerator random(7);
+        std::shuffle(blocks.begin(), blocks.end(), random);
+        for(qsizetype i = 0; i < (qsizetype)blocks.size(); i += 10)
+            blocks[i].replace("return value;", "return -value;");
+
+        QVERIFY(reorderedFile.open());
+        for(const QByteArray& block: blocks)
+            reorderedFile.write(block);
+        reorderedFile.close();
+    }
+
+    void cleanupTestCase()
+    {
+        gOptions->mDiffAlgorithm = eDiffAlgorithmGnuDiff;
+    }
+
+    void benchmarkRunDiff_data()
+    {
+        QTest::addColumn<QString>("file1");
+        QTest::addColumn<QString>("file2");
+        QTest::addColumn<qint32>("algorithm");
+
+        const QDir testData(QStringLiteral(KDIFF3_TESTDATA_DIR));
+        const QStringList baseFiles = testData.entryList({QStringLiteral("*_base.*")}, QDir::Files, QDir::Name);
+        QVERIFY(!baseFiles.isEmpty());
+
+        for(const QString& baseFile: baseFiles)
+        {
+            for(const QString& contrib: {QStringLiteral("_contrib1."), QStringLiteral("_contrib2.")})
+            {
+                const QString contribFile = QString(baseFile).replace(QStringLiteral("_base."), contrib);
+                addRows(contribFile, testData.filePath(baseFile), testData.filePath(contribFile));
+            }
+        }
+
+        addRows(QStringLiteral("reordered"), generatedFile.fileName(), reorderedFile.fileName());
+    }
+
+    void benchmarkRunDiff()
+    {
+        QFETCH(QString, file1);
+        QFETCH(QString, file2);
+        QFETCH(qint32, algorithm);
+
+        SourceDataMoc data1, data2;
+        data1.setFilename(file1);
+        data1.readAndPreprocess("UTF-8", true);
+        QVERIFY(data1.getErrors().isEmpty());
+        data2.setFilename(file2);
+        data2.readAndPreprocess("UTF-8", true);
+        QVERIFY(data2.getErrors().isEmpty());
+
+        gOptions->mDiffAlgorithm = (e_DiffAlgorithm)algorithm;
+
+        DiffList diffList;
+        QBENCHMARK
+        {
+            diffList.runDiff(data1.getLineDataForDiff(), 0, data1.lineCount(), data2.getLineDataForDiff(), 0, data2.lineCount());
+        }
+
+        // Every line must be accounted for exactly once.
+        quint64 lines1 = 0, lines2 = 0, equalLines = 0;
+        for(const Diff& d: diffList)
+        {
+            lines1 += d.numberOfEquals() + d.diff1();
+            lines2 += d.numberOfEquals() + d.diff2();
+            equalLines += d.numberOfEquals();
+        }
+        QCOMPARE(lines1, (quint64)data1.lineCount());
+        QCOMPARE(lines2, (quint64)data2.lineCount());
+        qInfo() << "equal lines:" << equalLines;
+    }
+};
+
+QTEST_MAIN(DiffAlgorithmBenchmark);
+
+#include "DiffAlgorithmBenchmark.moc"
@@ -10,12 +10,16 @@
 
 #include "../diff.h"
 #include "../fileaccess.h"
+#include "../gnudiff_diff.h"
 #include "../options.h"
+#include "../Parallel.h"
 
 #include "SourceDataMoc.h"
 
 #include <memory>
+#include <vector>
 
+#include <QRandomGenerator>
 #include <QString>
 #include <QTest>
 
@@ -96,22 +100,22 @@ class DiffTest: public QObject
         QVERIFY(lineData != nullptr);
         QCOMPARE(lineData->size() - 1, 5);
 
-        QVERIFY((*lineData)[0].getBuffer() != nullptr);
+        QVERIFY((*lineData)[0].hasBuffer());
         QCOMPARE((*lineData)[0].size(), 2);
         QCOMPARE((*lineData)[0].getFirstNonWhiteChar(), 1);
         QCOMPARE((*lineData)[0].getLine(), "//");
 
-        QVERIFY((*lineData)[1].getBuffer() != nullptr);
+        QVERIFY((*lineData)[1].hasBuffer());
         QCOMPARE((*lineData)[1].size(), 3);
         QCOMPARE((*lineData)[1].getFirstNonWhiteChar(), 2);
         QCOMPARE((*lineData)[1].getLine(), " //");
 
-        QVERIFY((*lineData)[2].getBuffer() != nullptr);
+        QVERIFY((*lineData)[2].hasBuffer());
         QCOMPARE((*lineData)[2].size(), 6);
         QCOMPARE((*lineData)[2].getFirstNonWhiteChar(), 0);
         QCOMPARE((*lineData)[2].getLine(), "     \t");
 
-        QVERIFY((*lineData)[3].getBuffer() != nullptr);
+        QVERIFY((*lineData)[3].hasBuffer());
         QCOMPARE((*lineData)[3].size(), 9);
         QCOMPARE((*lineData)[3].getFirstNonWhiteChar(), 3);
         QCOMPARE((*lineData)[3].getLine(), "  D//   \t");
@@ -218,6 +222,602 @@ class DiffTest: public QObject
         QVERIFY(!(*lineData)[4].isSkipable());
    }
 
+    /*
+        GnuDiff keeps all of its state per object. Diffs running at the same time must give the same result as a
+        single one.
+    */
+    void testConcurrentRunDiff()
+    {
+        SourceDataMoc simData, simData2;
+        QTemporaryFile testFile2, testFile3;
+
+        QByteArray text, text2;
+        for(qint32 i = 0; i < 2000; ++i)
+        {
+            text += QByteArray::number(i) + '\n';
+            if(i % 7 != 0)
+                text2 += QByteArray::number(i % 13 == 0 ? -i : i) + '\n';
+        }
+
+        testFile2.open();
+        testFile2.write(text);
+        testFile2.close();
+        testFile3.open();
+        testFile3.write(text2);
+        testFile3.close();
+
+        simData.setFilename(testFile2.fileName());
+        simData.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData.getErrors().isEmpty());
+        simData2.setFilename(testFile3.fileName());
+        simData2.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData2.getErrors().isEmpty());
+
+        DiffList expectedDiffList;
+        expectedDiffList.runDiff(simData.getLineDataForDiff(), 0, simData.lineCount(), simData2.getLineDataForDiff(), 0, simData2.lineCount());
+
+        std::vector<DiffList> diffLists(8);
+        Parallel::forEach((qsizetype)diffLists.size(), [&](const qsizetype i) {
+            diffLists[i].runDiff(simData.getLineDataForDiff(), 0, simData.lineCount(), simData2.getLineDataForDiff(), 0, simData2.lineCount());
+        });
+
+        for(const DiffList& diffList: diffLists)
+            QVERIFY(diffList == expectedDiffList);
+    }
+
+    /*
+        The histogram algorithm keeps the longest run of rare lines in place, here "c d".
+        White space is ignored the same way GnuDiff does.
+    */
+    void testHistogramDiff()
+    {
+        SourceDataMoc simData, simData2;
+        QTemporaryFile testFile2, testFile3;
+
+        testFile2.open();
+        testFile2.write(u8"a\nb\nc\nd\n");
+        testFile2.close();
+        testFile3.open();
+        testFile3.write(u8"c\n d\na\nb\n");
+        testFile3.close();
+
+        simData.setFilename(testFile2.fileName());
+        simData.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData.getErrors().isEmpty());
+        simData2.setFilename(testFile3.fileName());
+        simData2.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData2.getErrors().isEmpty());
+
+        gOptions->mDiffAlgorithm = eDiffAlgorithmHistogram;
+        DiffList diffList;
+        diffList.runDiff(simData.getLineDataForDiff(), 0, simData.lineCount(), simData2.getLineDataForDiff(), 0, simData2.lineCount());
+        gOptions->mDiffAlgorithm = eDiffAlgorithmGnuDiff;
+
+        const DiffList expectedDiffList = {{0, 2, 0}, {2, 0, 2}, {1, 0, 0}};
+        QVERIFY(diffList == expectedDiffList);
+    }
+
+    /*
+        A line occurring more than maxChainLength (64) times is never an anchor. Anchoring at the run "x x" would
+        lose the single "x" before it, GnuDiff keeps all three.
+    */
+    void testHistogramChainLimit()
+    {
+        for(const qint32 nofX: {65, 64})
+        {
+            SourceDataMoc simData, simData2;
+            QTemporaryFile testFile2, testFile3;
+
+            testFile2.open();
+            testFile2.write("a\n" + QByteArray("x\n").repeated(nofX) + "z\n");
+            testFile2.close();
+            testFile3.open();
+            testFile3.write("b\nx\nc\nx\nx\nd\n");
+            testFile3.close();
+
+            simData.setFilename(testFile2.fileName());
+            simData.readAndPreprocess("UTF-8", true);
+            QVERIFY(simData.getErrors().isEmpty());
+            simData2.setFilename(testFile3.fileName());
+            simData2.readAndPreprocess("UTF-8", true);
+            QVERIFY(simData2.getErrors().isEmpty());
+
+            gOptions->mDiffAlgorithm = eDiffAlgorithmHistogram;
+            DiffList diffList;
+            diffList.runDiff(simData.getLineDataForDiff(), 0, simData.lineCount(), simData2.getLineDataForDiff(), 0, simData2.lineCount());
+            gOptions->mDiffAlgorithm = eDiffAlgorithmGnuDiff;
+
+            qint32 equalLines = 0;
+            for(const Diff& d: diffList)
+                equalLines += d.numberOfEquals();
+            // One more than the limit goes to GnuDiff, at the limit the run is still used.
+            QCOMPARE(equalLines, nofX == 65 ? 3 : 2);
+        }
+    }
+
+    void testFastLargeFiles()
+    {
+        SourceDataMoc simData, simData2;
+        QTemporaryFile testFile2, testFile3;
+
+        // Enough lines without a match in the other file to make GnuDiff give up on a minimal result.
+        testFile2.open();
+        testFile3.open();
+        for(qint32 i = 0; i < 11000; ++i)
+        {
+            testFile2.write("a" + QByteArray::number(i) + "\ncommon\n");
+            testFile3.write("b" + QByteArray::number(i) + "\ncommon\n");
+        }
+        testFile2.close();
+        testFile3.close();
+
+        simData.setFilename(testFile2.fileName());
+        simData.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData.getErrors().isEmpty());
+        simData2.setFilename(testFile3.fileName());
+        simData2.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData2.getErrors().isEmpty());
+
+        DiffList diffList;
+        diffList.runDiff(simData.getLineDataForDiff(), 0, simData.lineCount(), simData2.getLineDataForDiff(), 0, simData2.lineCount());
+        QVERIFY(diffList.usedFastMode());
+
+        quint64 lines1 = 0, lines2 = 0;
+        for(const Diff& d: diffList)
+        {
+            lines1 += d.numberOfEquals() + d.diff1();
+            lines2 += d.numberOfEquals() + d.diff2();
+        }
+        QCOMPARE(lines1, (quint64)simData.lineCount());
+        QCOMPARE(lines2, (quint64)simData2.lineCount());
+
+        // Without "Try hard" GnuDiff discards the unmatched lines itself, so this stays quick.
+        gOptions->mFastLargeFiles = false;
+        gOptions->m_bTryHard = false;
+        diffList.runDiff(simData.getLineDataForDiff(), 0, simData.lineCount(), simData2.getLineDataForDiff(), 0, simData2.lineCount());
+        gOptions->mFastLargeFiles = true;
+        gOptions->m_bTryHard = true;
+        QVERIFY(!diffList.usedFastMode());
+    }
+
+    void testDiffSegmentCache()
+    {
+        SourceDataMoc simData, simData2;
+        QTemporaryFile testFile2, testFile3;
+
+        testFile2.open();
+        testFile3.open();
+        for(qint32 i = 0; i < 100; ++i)
+        {
+            testFile2.write("line " + QByteArray::number(i) + "\n");
+            testFile3.write("line " + QByteArray::number(i % 7 == 0 ? -i : i) + "\n");
+        }
+        testFile2.close();
+        testFile3.close();
+
+        simData.setFilename(testFile2.fileName());
+        simData.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData.getErrors().isEmpty());
+        simData2.setFilename(testFile3.fileName());
+        simData2.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData2.getErrors().isEmpty());
+
+        ManualDiffHelpList manualDiffList;
+        DiffSegmentCache cache;
+        DiffList diffList, expectedDiffList;
+
+        const auto runDiffs = [&]() {
+            manualDiffList.runDiff(simData.getLineDataForDiff(), simData.lineCount(), simData2.getLineDataForDiff(), simData2.lineCount(), diffList, e_SrcSelector::A, e_SrcSelector::B, &cache);
+            manualDiffList.runDiff(simData.getLineDataForDiff(), simData.lineCount(), simData2.getLineDataForDiff(), simData2.lineCount(), expectedDiffList, e_SrcSelector::A, e_SrcSelector::B);
+        };
+
+        // One alignment splits the files into three ranges.
+        manualDiffList.insertEntry(e_SrcSelector::A, 10, 19);
+        manualDiffList.insertEntry(e_SrcSelector::B, 30, 39);
+        runDiffs();
+        QVERIFY(diffList == expectedDiffList);
+        QCOMPARE(cache.size(), 3);
+
+        // A second one splits the last range, the two in front are kept.
+        manualDiffList.insertEntry(e_SrcSelector::A, 60, 69);
+        manualDiffList.insertEntry(e_SrcSelector::B, 70, 79);
+        runDiffs();
+        QVERIFY(diffList == expectedDiffList);
+        QCOMPARE(cache.size(), 5);
+
+        // Ranges no longer used are dropped.
+        manualDiffList.clear();
+        runDiffs();
+        QVERIFY(diffList == expectedDiffList);
+        QCOMPARE(cache.size(), 1);
+
+        cache.clear();
+        QVERIFY(cache.empty());
+    }
+
+    void testLineHashes()
+    {
+        SourceDataMoc simData;
+        QTemporaryFile testFile;
+
+        testFile.open();
+        testFile.write(u8"int a = 1;\nint  a = 2;\nint a=1;\nint b = 1;\n");
+        testFile.close();
+
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData.getErrors().isEmpty());
+
+        const std::shared_ptr<LineDataVector>& lineData = simData.getLineDataForDiff();
+        const LineHashOptions ignoreSpace{true, false, false};
+        const LineHashOptions ignoreNumbers{true, true, false};
+
+        const std::shared_ptr<const std::vector<size_t>> hashes = lineData->lineHashes(ignoreSpace);
+        QCOMPARE(hashes->size(), lineData->size());
+        QCOMPARE((*hashes)[0], (*hashes)[2]);
+        QVERIFY((*hashes)[0] != (*hashes)[1]);
+        QVERIFY((*hashes)[0] != (*hashes)[3]);
+
+        const std::shared_ptr<const std::vector<size_t>> numberHashes = lineData->lineHashes(ignoreNumbers);
+        QCOMPARE((*numberHashes)[0], (*numberHashes)[1]);
+        QVERIFY((*numberHashes)[0] != (*numberHashes)[3]);
+
+        // Hashed once per load and option set.
+        QVERIFY(lineData->lineHashes(ignoreSpace) == hashes);
+        QVERIFY(lineData->lineHashes(ignoreNumbers) == numberHashes);
+
+        // Moving the lines moves the hashes along, copying does not.
+        LineDataVector moved(std::move(*lineData));
+        QVERIFY(moved.lineHashes(ignoreSpace) == hashes);
+        QVERIFY(lineData->empty());
+        *lineData = std::move(moved);
+        QVERIFY(lineData->lineHashes(ignoreNumbers) == numberHashes);
+        QVERIFY(moved.empty());
+        const LineDataVector copied(*lineData);
+        QVERIFY(copied.lineHashes(ignoreSpace) != hashes);
+        QVERIFY(*copied.lineHashes(ignoreSpace) == *hashes);
+
+        simData.readAndPreprocess("UTF-8", true);
+        QVERIFY(lineData->lineHashes(ignoreSpace) != hashes);
+        QVERIFY(*lineData->lineHashes(ignoreSpace) == *hashes);
+    }
+
+    void testIdenticalEnds()
+    {
+        SourceDataMoc simData, simData2;
+        QTemporaryFile testFile2, testFile3;
+
+        // The second file is not Latin-1, so the common lines are compared across both kinds of storage.
+        testFile2.open();
+        testFile2.write(u8"a\nb\nc\nd\ne\n");
+        testFile2.close();
+        testFile3.open();
+        testFile3.write(u8"a\nb\n\u20AC\nd\ne\n");
+        testFile3.close();
+
+        simData.setFilename(testFile2.fileName());
+        simData.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData.getErrors().isEmpty());
+        simData2.setFilename(testFile3.fileName());
+        simData2.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData2.getErrors().isEmpty());
+
+        DiffList diffList;
+        diffList.runDiff(simData.getLineDataForDiff(), 0, simData.lineCount(), simData2.getLineDataForDiff(), 0, simData2.lineCount());
+
+        const DiffList expectedDiffList = {{2, 1, 1}, {3, 0, 0}};
+        QVERIFY(diffList == expectedDiffList);
+
+        // The example from Myers' paper, five edits keep the four characters in common.
+        diffList.calcDiff(QStringLiteral("abcabba"), QStringLiteral("cbabac"), 500);
+        const DiffList expectedMyersList = {{0, 1, 1}, {1, 1, 0}, {2, 1, 0}, {1, 0, 1}};
+        QVERIFY(diffList == expectedMyersList);
+
+        gOptions->mDiffAlgorithm = eDiffAlgorithmHistogram;
+        diffList.runDiff(simData.getLineDataForDiff(), 0, simData.lineCount(), simData2.getLineDataForDiff(), 0, simData2.lineCount());
+        gOptions->mDiffAlgorithm = eDiffAlgorithmGnuDiff;
+        QVERIFY(diffList == expectedDiffList);
+
+        // Nothing left in between.
+        diffList.runDiff(simData.getLineDataForDiff(), 0, simData.lineCount(), simData.getLineDataForDiff(), 0, simData.lineCount());
+        const DiffList equalDiffList = {{simData.lineCount(), 0, 0}};
+        QVERIFY(diffList == equalDiffList);
+    }
+
+    /*
+        With unique lines all over the result of the split comparison is the same as in one go.
+    */
+    void testAnchoredDiff()
+    {
+        SourceDataMoc simData, simData2;
+        QTemporaryFile testFile2, testFile3;
+
+        QByteArray text, text2;
+        for(qint32 i = 0; i < 60000; ++i)
+        {
+            const QByteArray line = "line " + QByteArray::number(i) + '\n';
+            text += line;
+            if(i % 101 == 0)
+                continue;
+            text2 += i % 37 == 0 ? QByteArray("changed " + line) : line;
+            if(i % 71 == 0)
+                text2 += "inserted " + QByteArray::number(i) + '\n';
+        }
+
+        testFile2.open();
+        testFile2.write(text);
+        testFile2.close();
+        testFile3.open();
+        testFile3.write(text2);
+        testFile3.close();
+
+        simData.setFilename(testFile2.fileName());
+        simData.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData.getErrors().isEmpty());
+        simData2.setFilename(testFile3.fileName());
+        simData2.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData2.getErrors().isEmpty());
+
+        for(const e_DiffAlgorithm algorithm: {eDiffAlgorithmGnuDiff, eDiffAlgorithmHistogram})
+        {
+            gOptions->mDiffAlgorithm = algorithm;
+
+            gOptions->mAnchoredDiff = false;
+            DiffList expectedDiffList;
+            expectedDiffList.runDiff(simData.getLineDataForDiff(), 0, simData.lineCount(), simData2.getLineDataForDiff(), 0, simData2.lineCount());
+
+            gOptions->mAnchoredDiff = true;
+            DiffList diffList;
+            diffList.runDiff(simData.getLineDataForDiff(), 0, simData.lineCount(), simData2.getLineDataForDiff(), 0, simData2.lineCount());
+
+            QVERIFY(diffList == expectedDiffList);
+        }
+        gOptions->mDiffAlgorithm = eDiffAlgorithmGnuDiff;
+    }
+
+    void testCharacterDiff()
+    {
+        DiffList diffList;
+        diffList.calcDiff(QStringLiteral("abcdef"), QStringLiteral("abXdef"), 500);
+        const DiffList expectedDiffList = {{2, 1, 1}, {3, 0, 0}};
+        QVERIFY(diffList == expectedDiffList);
+
+        // The example from Myers' paper, five edits keep the four characters in common.
+        diffList.calcDiff(QStringLiteral("abcabba"), QStringLiteral("cbabac"), 500);
+        const DiffList expectedMyersList = {{0, 1, 1}, {1, 1, 0}, {2, 1, 0}, {1, 0, 1}};
+        QVERIFY(diffList == expectedMyersList);
+
+        // A long line with a few changes far apart, like minified code.
+        QString line1, line2;
+        for(qint32 i = 0; i < 2000; ++i)
+            line1 += QStringLiteral("{\"k%1\":%2},").arg(i).arg(i % 7);
+        line2 = line1;
+        line2[100] = u'x';
+        line2.remove(20000, 3);
+        line2.insert(line2.size() - 10, QStringLiteral("new"));
+
+        diffList.calcDiff(line1, line2, 500);
+        qsizetype size1 = 0, size2 = 0, equals = 0;
+        for(const Diff& d: diffList)
+        {
+            size1 += d.numberOfEquals() + d.diff1();
+            size2 += d.numberOfEquals() + d.diff2();
+            equals += d.numberOfEquals();
+        }
+        QCOMPARE(size1, line1.size());
+        QCOMPARE(size2, line2.size());
+        QCOMPARE(equals, line1.size() - 4);
+
+        // Nothing in common but single characters. Must neither hang nor lose characters.
+        QString random1, random2;
+        QRandomGenerator random(3);
+        for(qint32 i = 0; i < 100000; ++i)
+        {
+            random1 += QChar(u'a' + random.bounded(26));
+            random2 += QChar(u'a' + random.bounded(26));
+        }
+        diffList.calcDiff(random1, random2, 500);
+        size1 = size2 = 0;
+        for(const Diff& d: diffList)
+        {
+            size1 += d.numberOfEquals() + d.diff1();
+            size2 += d.numberOfEquals() + d.diff2();
+        }
+        QCOMPARE(size1, random1.size());
+        QCOMPARE(size2, random2.size());
+    }
+
+    void testGnuDiffArena()
+    {
+        GnuDiffArena arena;
+
+        // Small allocations grow in place while they are the last one.
+        char* p = (char*)arena.allocate(10);
+        memcpy(p, "abcdefghi", 10);
+        p = (char*)arena.reallocate(p, 100);
+        QCOMPARE(p, "abcdefghi");
+
+        char* q = (char*)arena.allocate(8);
+        p = (char*)arena.reallocate(p, 1000);
+        QVERIFY(p != q);
+        QCOMPARE(p, "abcdefghi");
+
+        // Big ones get their own block, which can be given back early.
+        for(size_t n = 1000; n < 1000000; n *= 2)
+        {
+            p = (char*)arena.reallocate(p, n);
+            QCOMPARE(p, "abcdefghi");
+        }
+        arena.release(p);
+        arena.release(q);
+    }
+
+    void testFineDiffArena()
+    {
+        FineDiffArena arena;
+        const DiffList diffList = {{2, 1, 0}, {0, 3, 4}};
+        const FineDiffRange range(arena.add(diffList));
+        QVERIFY(!range.isNull());
+        QCOMPARE(range.size(), 2);
+        QVERIFY(range.begin()[0] == (FineDiffRun{2, 1, 0}));
+        QVERIFY(range.begin()[1] == (FineDiffRun{0, 3, 4}));
+
+        // A list bigger than a block gets its own, earlier ranges stay where they are.
+        const DiffList bigList(40000, Diff(1, 1, 1));
+        const FineDiffRange bigRange(arena.add(bigList));
+        QCOMPARE(bigRange.size(), 40000);
+        QVERIFY(range.begin()[1] == (FineDiffRun{0, 3, 4}));
+        QCOMPARE(arena.runCount(), 3 + 40001);
+
+        QVERIFY(FineDiffRange().isNull());
+        QVERIFY(FineDiffRange(arena.add(DiffList())) == FineDiffRange(arena.add(DiffList())));
+        QVERIFY(!(FineDiffRange() == FineDiffRange(arena.add(DiffList()))));
+    }
+
+    /*
+        Diff3LineList::fineDiff splits the lines into chunks that run on the thread pool. Results must match
+        diffing one line at a time.
+    */
+    void testParallelFineDiff()
+    {
+        SourceDataMoc simData, simData2;
+        QTemporaryFile testFile2, testFile3;
+
+        QByteArray text, text2;
+        for(qint32 i = 0; i < 2000; ++i)
+        {
+            text += "value " + QByteArray::number(i) + '\n';
+            text2 += (i % 3 == 0 ? "value x" : "value ") + QByteArray::number(i) + '\n';
+        }
+
+        testFile2.open();
+        testFile2.write(text);
+        testFile2.close();
+        testFile3.open();
+        testFile3.write(text2);
+        testFile3.close();
+
+        simData.setFilename(testFile2.fileName());
+        simData.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData.getErrors().isEmpty());
+        simData2.setFilename(testFile3.fileName());
+        simData2.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData2.getErrors().isEmpty());
+
+        ManualDiffHelpList manualDiffList;
+        DiffList diffList;
+        manualDiffList.runDiff(simData.getLineDataForDiff(), simData.lineCount(), simData2.getLineDataForDiff(), simData2.lineCount(), diffList, e_SrcSelector::A, e_SrcSelector::B);
+
+        Diff3LineList diff3List;
+        diff3List.calcDiff3LineListUsingAB(&diffList);
+        Diff3LineList expectedDiff3 = diff3List;
+
+        FineDiffArena expectedArena;
+        bool bExpectedEqual = true;
+        for(Diff3Line& d3l: expectedDiff3)
+            bExpectedEqual = d3l.fineDiff(bExpectedEqual, e_SrcSelector::A, simData.getLineDataForDisplay(), simData2.getLineDataForDisplay(), IgnoreFlag::none, expectedArena);
+
+        QVERIFY(!bExpectedEqual);
+        QCOMPARE(diff3List.fineDiff(e_SrcSelector::A, simData.getLineDataForDisplay(), simData2.getLineDataForDisplay(), IgnoreFlag::none), bExpectedEqual);
+        QVERIFY(diff3List == expectedDiff3);
+        // Lazy fine diffs are only scheduled here, nothing has been diffed yet.
+        QCOMPARE(diff3List.scheduledFineDiffCount(), quint64(667));
+        QCOMPARE(diff3List.fineDiffCount(), quint64(0));
+
+        qint32 fineDiffs = 0;
+        for(auto it = diff3List.cbegin(), expectedIt = expectedDiff3.cbegin(); it != diff3List.cend(); ++it, ++expectedIt)
+        {
+            LineRef lineIdx;
+            FineDiffRange fineDiff, expectedFineDiff, unused;
+            ChangeFlags changed, changed2;
+            it->getLineInfo(e_SrcSelector::A, false, lineIdx, fineDiff, unused, changed, changed2);
+            expectedIt->getLineInfo(e_SrcSelector::A, false, lineIdx, expectedFineDiff, unused, changed, changed2);
+
+            QVERIFY(fineDiff == expectedFineDiff);
+            if(!fineDiff.isNull())
+            {
+                QVERIFY(fineDiff.size() > 0);
+                ++fineDiffs;
+            }
+        }
+        QCOMPARE(fineDiffs, 667);
+        QCOMPARE(diff3List.fineDiffCount(), quint64(667));
+        QCOMPARE(diff3List.numberOfFineDiffs(), 667);
+
+        // A second pass over the same pair schedules every line again, mainInit must not do this.
+        QVERIFY(!diff3List.fineDiff(e_SrcSelector::A, simData.getLineDataForDisplay(), simData2.getLineDataForDisplay(), IgnoreFlag::none));
+        QCOMPARE(diff3List.scheduledFineDiffCount(), quint64(2 * 667));
+        QCOMPARE(diff3List.fineDiffCount(), quint64(667));
+        QCOMPARE(diff3List.numberOfFineDiffs(), 667);
+
+        // Without lazy fine diffs every scheduled pair is diffed right away.
+        gOptions->mLazyFineDiff = false;
+        Diff3LineList eagerDiff3;
+        eagerDiff3.calcDiff3LineListUsingAB(&diffList);
+        QVERIFY(!eagerDiff3.fineDiff(e_SrcSelector::A, simData.getLineDataForDisplay(), simData2.getLineDataForDisplay(), IgnoreFlag::none));
+        gOptions->mLazyFineDiff = true;
+        QCOMPARE(eagerDiff3.scheduledFineDiffCount(), quint64(667));
+        QCOMPARE(eagerDiff3.fineDiffCount(), quint64(667));
+
+        // Pending fine diffs get filled in the background while painting asks for them at the same time.
+        Diff3LineList lazyDiff3;
+        lazyDiff3.calcDiff3LineListUsingAB(&diffList);
+        QVERIFY(gOptions->mLazyFineDiff);
+        QVERIFY(!lazyDiff3.fineDiff(e_SrcSelector::A, simData.getLineDataForDisplay(), simData2.getLineDataForDisplay(), IgnoreFlag::none));
+        QCOMPARE(lazyDiff3.numberOfFineDiffs(), 667);
+
+        Diff3LineVector lazyVector;
+        lazyDiff3.calcDiff3LineVector(lazyVector);
+        lazyDiff3.startFineDiffFill(lazyVector);
+        for(auto it = lazyDiff3.crbegin(), expectedIt = expectedDiff3.crbegin(); it != lazyDiff3.crend(); ++it, ++expectedIt)
+        {
+            LineRef lineIdx;
+            FineDiffRange fineDiff, expectedFineDiff, unused;
+            ChangeFlags changed, changed2;
+            it->getLineInfo(e_SrcSelector::A, false, lineIdx, fineDiff, unused, changed, changed2);
+            expectedIt->getLineInfo(e_SrcSelector::A, false, lineIdx, expectedFineDiff, unused, changed, changed2);
+
+            QVERIFY(fineDiff == expectedFineDiff);
+        }
+        lazyDiff3.stopFineDiffFill();
+
+        // Copying stops a running fill first, the copy calculates what is still pending on demand.
+        Diff3LineList fillingDiff3;
+        fillingDiff3.calcDiff3LineListUsingAB(&diffList);
+        QVERIFY(!fillingDiff3.fineDiff(e_SrcSelector::A, simData.getLineDataForDisplay(), simData2.getLineDataForDisplay(), IgnoreFlag::none));
+        Diff3LineVector fillingVector;
+        fillingDiff3.calcDiff3LineVector(fillingVector);
+        fillingDiff3.startFineDiffFill(fillingVector);
+        const Diff3LineList copiedDiff3 = fillingDiff3;
+        for(auto it = copiedDiff3.cbegin(), expectedIt = expectedDiff3.cbegin(); it != copiedDiff3.cend(); ++it, ++expectedIt)
+        {
+            LineRef lineIdx;
+            FineDiffRange fineDiff, expectedFineDiff, unused;
+            ChangeFlags changed, changed2;
+            it->getLineInfo(e_SrcSelector::A, false, lineIdx, fineDiff, unused, changed, changed2);
+            expectedIt->getLineInfo(e_SrcSelector::A, false, lineIdx, expectedFineDiff, unused, changed, changed2);
+
+            QVERIFY(fineDiff == expectedFineDiff);
+        }
+
+        // Identical input reduces to equal.
+        Diff3LineList equalDiff3;
+        DiffList equalDiffList;
+        manualDiffList.runDiff(simData.getLineDataForDiff(), simData.lineCount(), simData.getLineDataForDiff(), simData.lineCount(), equalDiffList, e_SrcSelector::A, e_SrcSelector::B);
+        equalDiff3.calcDiff3LineListUsingAB(&equalDiffList);
+        QVERIFY(equalDiff3.fineDiff(e_SrcSelector::A, simData.getLineDataForDisplay(), simData.getLineDataForDisplay(), IgnoreFlag::none));
+
+        // Clearing lets go of the text of every pair, a following two way diff must not keep the B/C text alive.
+        QVERIFY(equalDiff3.fineDiff(e_SrcSelector::B, simData.getLineDataForDisplay(), simData.getLineDataForDisplay(), IgnoreFlag::none));
+        QVERIFY(Diff3Line::m_pDiffBufferInfo->getFineDiffData(e_SrcSelector::B, 0) != nullptr);
+        equalDiff3.clear();
+        for(const e_SrcSelector selector: {e_SrcSelector::A, e_SrcSelector::B, e_SrcSelector::C})
+        {
+            QVERIFY(Diff3Line::m_pDiffBufferInfo->getFineDiffData(selector, 0) == nullptr);
+            QVERIFY(Diff3Line::m_pDiffBufferInfo->getFineDiffData(selector, 1) == nullptr);
+        }
+    }
+
 };
 
 QTEST_MAIN(DiffTest);
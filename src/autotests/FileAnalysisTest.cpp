@@ -0,0 +1,125 @@
+// clang-format off
+/*
+ KDiff3 - Text Diff And Merge Tool
+
+ SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ SPDX-License-Identifier: GPL-2.0-or-later
+*/
+// clang-format on
+
+#include "../FileAnalysis.h"
+#include "../diff.h"
+#include "../options.h"
+#include "../Parallel.h"
+
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QStringList>
+#include <QTemporaryFile>
+#include <QTest>
+
+class FileAnalysisTest: public QObject
+{
+    Q_OBJECT;
+  private:
+    std::vector<std::unique_ptr<QTemporaryFile>> mFiles;
+
+    QString writeFile(const QByteArray& content)
+    {
+        mFiles.push_back(std::make_unique<QTemporaryFile>());
+        QTemporaryFile& file = *mFiles.back();
+        file.open();
+        file.write(content);
+        file.close();
+        return file.fileName();
+    }
+
+  private Q_SLOTS:
+    void testTwoFiles()
+    {
+        QVERIFY(FileAnalysis::isPossible());
+
+        const QString a = writeFile("a\nb\nc\n");
+        TotalDiffStatus status;
+        QStringList errors;
+
+        FileAnalysis::analyse(a, writeFile("a\nb\nc\n"), QString(), status, errors);
+        QVERIFY(errors.isEmpty());
+        QVERIFY(status.isBinaryEqualAB());
+        QVERIFY(status.isTextEqualAB());
+        QCOMPARE(status.getUnsolvedConflicts(), 0);
+
+        FileAnalysis::analyse(a, writeFile("a\nX\nc\n"), QString(), status, errors);
+        QVERIFY(errors.isEmpty());
+        QVERIFY(!status.isBinaryEqualAB());
+        QVERIFY(!status.isTextEqualAB());
+        QCOMPARE(status.getUnsolvedConflicts(), 1);
+        QCOMPARE(status.getSolvedConflicts(), 0);
+        QCOMPARE(status.getWhitespaceConflicts(), 0);
+
+        FileAnalysis::analyse(a, writeFile("a\nb\n"), QString(), status, errors);
+        QCOMPARE(status.getUnsolvedConflicts(), 1);
+        QVERIFY(errors.isEmpty());
+    }
+
+    void testThreeFiles()
+    {
+        const QString base = writeFile("1\n2\n3\n4\n5\n");
+        TotalDiffStatus status;
+        QStringList errors;
+
+        // Changes in different places solve themselves.
+        FileAnalysis::analyse(base, writeFile("1\nB\n3\n4\n5\n"), writeFile("1\n2\n3\nC\n5\n"), status, errors);
+        QVERIFY(errors.isEmpty());
+        QCOMPARE(status.getUnsolvedConflicts(), 0);
+        QCOMPARE(status.getSolvedConflicts(), 2);
+
+        FileAnalysis::analyse(base, writeFile("1\nB\n3\n4\n5\n"), writeFile("1\nC\n3\n4\n5\n"), status, errors);
+        QVERIFY(errors.isEmpty());
+        QCOMPARE(status.getUnsolvedConflicts(), 1);
+        QCOMPARE(status.getSolvedConflicts(), 0);
+        QVERIFY(!status.isBinaryEqualBC());
+    }
+
+    // Nothing is shared between analyses, so any number may run at once.
+    void testParallel()
+    {
+        QByteArray base, b, c;
+        for(qint32 i = 0; i < 2000; ++i)
+        {
+            const QByteArray line = "line " + QByteArray::number(i) + '\n';
+            base += line;
+            b += i % 97 == 0 ? QByteArray("b " + line) : line;
+            c += i % 89 == 0 ? QByteArray("c " + line) : line;
+        }
+        const QString fileBase = writeFile(base);
+        const QString fileB = writeFile(b);
+        const QString fileC = writeFile(c);
+
+        TotalDiffStatus expected;
+        QStringList errors;
+        FileAnalysis::analyse(fileBase, fileB, fileC, expected, errors);
+        QVERIFY(errors.isEmpty());
+        QVERIFY(expected.getSolvedConflicts() > 0);
+
+        std::vector<TotalDiffStatus> results(16);
+        std::vector<QStringList> resultErrors(results.size());
+        Parallel::forEach(results.size(), [&](const qsizetype i) {
+            FileAnalysis::analyse(fileBase, fileB, fileC, results[i], resultErrors[i]);
+        });
+
+        for(size_t i = 0; i < results.size(); ++i)
+        {
+            QVERIFY(resultErrors[i].isEmpty());
+            QCOMPARE(results[i].getUnsolvedConflicts(), expected.getUnsolvedConflicts());
+            QCOMPARE(results[i].getSolvedConflicts(), expected.getSolvedConflicts());
+            QCOMPARE(results[i].getWhitespaceConflicts(), expected.getWhitespaceConflicts());
+        }
+    }
+};
+
+QTEST_MAIN(FileAnalysisTest);
+
+#include "FileAnalysisTest.moc"
@@ -0,0 +1,102 @@
+// clang-format off
+/*
+ KDiff3 - Text Diff And Merge Tool
+
+ SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ SPDX-License-Identifier: GPL-2.0-or-later
+*/
+// clang-format on
+
+#include "../FileComparison.h"
+#include "../fileaccess.h"
+#include "../options.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+class FileComparisonTest: public QObject
+{
+    Q_OBJECT;
+
+    QTemporaryDir mDir;
+
+    // Writes both files and compares them.
+    bool compare(const QByteArray& content1, const QByteArray& content2, bool& bError, QString& status)
+    {
+        for(const auto& [name, content]: {std::pair{QStringLiteral("a"), content1}, std::pair{QStringLiteral("b"), content2}})
+        {
+            QFile file(mDir.filePath(name));
+            if(!file.open(QIODevice::WriteOnly) || file.write(content) != content.size())
+                return false;
+        }
+
+        FileAccess fi1(mDir.filePath(QStringLiteral("a")));
+        FileAccess fi2(mDir.filePath(QStringLiteral("b")));
+        return FileComparison::compare(fi1, fi2, bError, status);
+    }
+
+  private Q_SLOTS:
+    void initTestCase()
+    {
+        QVERIFY(mDir.isValid());
+        gOptions->m_bDmTrustSize = false;
+        gOptions->m_bDmTrustDate = false;
+        gOptions->m_bDmTrustDateFallbackToBinary = false;
+        // Keeps the user's cache out of it, otherwise the second run of a test would not read the files.
+        gOptions->m_bDmHashCache = false;
+    }
+
+    void testSmallFiles()
+    {
+        const QByteArray content = QByteArray("line\n").repeated(1000);
+        QByteArray changed = content;
+        changed[content.size() / 2] = 'x';
+        bool bError = true;
+        QString status;
+
+        QVERIFY(compare(content, content, bError, status));
+        QVERIFY(!bError);
+        QVERIFY(status.startsWith(QStringLiteral("All content, ")));
+
+        QVERIFY(!compare(content, changed, bError, status));
+        QVERIFY(!bError);
+        QVERIFY(status.startsWith(QStringLiteral("All content, ")));
+
+        QVERIFY(!compare(content, content + "line\n", bError, status));
+        QVERIFY(!bError);
+        QCOMPARE(status, QStringLiteral("Size. "));
+    }
+
+    void testLargeFiles()
+    {
+        // The smallest size compared by samples first.
+        const QByteArray content = QByteArray("0123456789abcdef").repeated(64 * 1024);
+        QCOMPARE(content.size(), 1024 * 1024);
+        bool bError = true;
+        QString status;
+
+        QVERIFY(compare(content, content, bError, status));
+        QVERIFY(!bError);
+        QVERIFY(status.startsWith(QStringLiteral("All content after matching samples, ")));
+
+        // In the middle sample, found without reading everything.
+        QByteArray changed = content;
+        changed[content.size() / 2] = 'x';
+        QVERIFY(!compare(content, changed, bError, status));
+        QVERIFY(!bError);
+        QVERIFY(status.startsWith(QStringLiteral("Samples of start, middle and end, ")));
+
+        // Between the samples.
+        changed = content;
+        changed[content.size() / 4] = 'x';
+        QVERIFY(!compare(content, changed, bError, status));
+        QVERIFY(!bError);
+        QVERIFY(status.startsWith(QStringLiteral("All content after matching samples, ")));
+    }
+};
+
+QTEST_MAIN(FileComparisonTest);
+
+#include "FileComparisonTest.moc"
@@ -0,0 +1,140 @@
+// clang-format off
+/*
+ KDiff3 - Text Diff And Merge Tool
+
+ SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ SPDX-License-Identifier: GPL-2.0-or-later
+*/
+// clang-format on
+
+#include "../LineScanner.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <QByteArray>
+#include <QRandomGenerator>
+#include <QString>
+#include <QTest>
+
+class LineScannerTest: public QObject
+{
+    Q_OBJECT;
+
+  private:
+    /*
+        Builds strings long enough to cross several vector widths with the interesting characters
+        placed at every position, including the scalar tail.
+    */
+    static QString randomText(QRandomGenerator& random, qsizetype length)
+    {
+        static const char16_t pool[] = {u'a', u'a', u'a', u' ', u' ', u'\t', u'\n', u'\r', u'\v', u'\x08', u'\x0e', u'\x1f', 0x0120, 0x00A0, 0xFDCF, 0xFDD0, 0xFFFD, 0xFFFF, 0};
+        QString s(length, Qt::Uninitialized);
+        for(QChar& c: s)
+            c = QChar(pool[random.bounded((quint32)std::size(pool))]);
+        return s;
+    }
+
+  private Q_SLOTS:
+    void testFindLineEndOrSpecial()
+    {
+        QRandomGenerator random(17);
+        for(qsizetype length = 0; length < 80; ++length)
+        {
+            for(qint32 i = 0; i < 200; ++i)
+            {
+                const QString s = randomText(random, length);
+                const QChar* begin = s.constData();
+                const QChar* end = begin + s.size();
+
+                const QChar* expected = begin;
+                while(expected < end && expected->unicode() != u'\n' && expected->unicode() != u'\r' && !expected->isNull() && expected->unicode() < 0xFDD0)
+                    ++expected;
+
+                QCOMPARE(LineScanner::findLineEndOrSpecial(begin, end), expected);
+            }
+        }
+    }
+
+    void testFindNewLine()
+    {
+        QRandomGenerator random(23);
+        for(qsizetype length = 0; length < 80; ++length)
+        {
+            for(qint32 i = 0; i < 200; ++i)
+            {
+                const QString s = randomText(random, length);
+                const QChar* begin = s.constData();
+                const QChar* end = begin + s.size();
+
+                const QChar* expected = begin;
+                while(expected < end && expected->unicode() != u'\n')
+                    ++expected;
+
+                QCOMPARE(LineScanner::findNewLine(begin, end), expected);
+            }
+        }
+    }
+
+    void testSkipAsciiWhiteSpace()
+    {
+        QRandomGenerator random(31);
+        for(qsizetype length = 0; length < 80; ++length)
+        {
+            for(qint32 i = 0; i < 200; ++i)
+            {
+                const QString s = randomText(random, length);
+                const QChar* begin = s.constData();
+                const QChar* end = begin + s.size();
+
+                const QChar* expected = begin;
+                while(expected < end && expected->unicode() < 0x80 && expected->isSpace())
+                    ++expected;
+
+                QCOMPARE(LineScanner::skipAsciiWhiteSpace(begin, end), expected);
+            }
+        }
+
+        const QString allWhite(40, u' ');
+        QCOMPARE(LineScanner::skipAsciiWhiteSpace(allWhite.constData(), allWhite.constData() + allWhite.size()), allWhite.constData() + allWhite.size());
+    }
+
+    void testLatin1()
+    {
+        static const char pool[] = {'a', 'a', ' ', '\t', '\n', '\r', '\v', '\x08', '\x0e', '\x1f', '\0', '\xa0', '\x85', '\x89'};
+        QRandomGenerator random(41);
+        for(qsizetype length = 0; length < 100; ++length)
+        {
+            for(qint32 i = 0; i < 200; ++i)
+            {
+                QByteArray s(length, Qt::Uninitialized);
+                for(char& c: s)
+                    c = pool[random.bounded((quint32)std::size(pool))];
+                const char* begin = s.constData();
+                const char* end = begin + s.size();
+
+                const char* expected = begin;
+                while(expected < end && *expected != '\n' && *expected != '\r' && *expected != '\0')
+                    ++expected;
+                // Compare as pointers, QCOMPARE treats char pointers as strings.
+                QCOMPARE((const void*)LineScanner::findLineEndOrSpecial(begin, end), (const void*)expected);
+
+                expected = begin;
+                while(expected < end && *expected != '\n')
+                    ++expected;
+                QCOMPARE((const void*)LineScanner::findNewLine(begin, end), (const void*)expected);
+
+                expected = begin;
+                while(expected < end && (*expected == ' ' || (*expected >= '\t' && *expected <= '\r')))
+                    ++expected;
+                QCOMPARE((const void*)LineScanner::skipAsciiWhiteSpace(begin, end), (const void*)expected);
+
+                QCOMPARE(LineScanner::isAscii(begin, end), std::none_of(begin, end, [](char c) { return (uchar)c >= 0x80; }));
+            }
+        }
+    }
+};
+
+QTEST_MAIN(LineScannerTest);
+
+#include "LineScannerTest.moc"
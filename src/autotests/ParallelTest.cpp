@@ -0,0 +1,88 @@
+// clang-format off
+/*
+ KDiff3 - Text Diff And Merge Tool
+
+ SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ SPDX-License-Identifier: GPL-2.0-or-later
+*/
+// clang-format on
+
+#include "../Parallel.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include <QAtomicInteger>
+#include <QTest>
+#include <QThread>
+#include <QThreadPool>
+
+class ParallelTest: public QObject
+{
+    Q_OBJECT;
+
+  private:
+    static void checkEveryIndexOnce(const qsizetype count)
+    {
+        std::vector<QAtomicInteger<qint32>> calls(count);
+        Parallel::forEach(count, [&calls](const qsizetype i) { calls[i].fetchAndAddRelaxed(1); });
+
+        for(const QAtomicInteger<qint32>& c: calls)
+            QCOMPARE(c.loadRelaxed(), 1);
+    }
+
+  private Q_SLOTS:
+    void testGuiThread()
+    {
+        checkEveryIndexOnce(0);
+        checkEveryIndexOnce(1);
+        checkEveryIndexOnce(3);
+        checkEveryIndexOnce(1000);
+    }
+
+    // Off the GUI thread the caller works too, nested calls must not wait on a pool that is full.
+    void testNested()
+    {
+        QAtomicInteger<qint32> total = 0;
+        Parallel::forEach(QThreadPool::globalInstance()->maxThreadCount() * 2, [&total](qsizetype) {
+            Parallel::forEach(50, [&total](qsizetype) { total.fetchAndAddRelaxed(1); });
+        });
+
+        QCOMPARE(total.loadRelaxed(), QThreadPool::globalInstance()->maxThreadCount() * 2 * 50);
+    }
+
+    // A pool of its own may have more threads than cores and is used instead of the global one.
+    void testOwnPool()
+    {
+        QThreadPool pool;
+        pool.setMaxThreadCount(3 * QThread::idealThreadCount());
+
+        std::vector<QAtomicInteger<qint32>> calls(500);
+        Parallel::forEach(
+            calls.size(), [&calls](const qsizetype i) {
+                QThread::usleep(100);
+                calls[i].fetchAndAddRelaxed(1);
+            },
+            &pool);
+
+        for(const QAtomicInteger<qint32>& c: calls)
+            QCOMPARE(c.loadRelaxed(), 1);
+        QVERIFY(pool.waitForDone(1000));
+    }
+
+    void testException()
+    {
+        QAtomicInteger<qint32> calls = 0;
+        QVERIFY_THROWS_EXCEPTION(std::runtime_error, Parallel::forEach(100, [&calls](const qsizetype i) {
+            calls.fetchAndAddRelaxed(1);
+            if(i == 42)
+                throw std::runtime_error("failed");
+        }));
+        // The remaining tasks still run.
+        QCOMPARE(calls.loadRelaxed(), 100);
+    }
+};
+
+QTEST_MAIN(ParallelTest);
+
+#include "ParallelTest.moc"
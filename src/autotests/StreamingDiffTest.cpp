@@ -0,0 +1,145 @@
+// clang-format off
+/*
+ KDiff3 - Text Diff And Merge Tool
+
+ SPDX-FileCopyrightText: 2024 The KDiff3 Authors
+ SPDX-License-Identifier: GPL-2.0-or-later
+*/
+// clang-format on
+
+#include "../StreamingDiff.h"
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QList>
+#include <QRegularExpression>
+#include <QTemporaryFile>
+#include <QTest>
+
+class StreamingDiffTest: public QObject
+{
+    Q_OBJECT;
+  private:
+    // Applies diff output in normal format like patch would.
+    static QByteArray applyDiff(const QByteArray& original, const QByteArray& diff)
+    {
+        QList<QByteArray> lines = original.split('\n');
+        const bool bEndsWithNewLine = lines.last().isEmpty();
+        if(bEndsWithNewLine)
+            lines.removeLast();
+
+        static const QRegularExpression header(QStringLiteral("^(\\d+)(?:,(\\d+))?([acd])(\\d+)(?:,(\\d+))?$"));
+        QByteArray result;
+        qsizetype next = 0;
+        bool bAdded = false;
+        for(const QByteArray& line: diff.split('\n'))
+        {
+            const QRegularExpressionMatch match = header.match(QString::fromUtf8(line));
+            if(match.hasMatch())
+            {
+                const qsizetype first = match.captured(1).toLongLong();
+                const qsizetype last = match.captured(2).isEmpty() ? first : match.captured(2).toLongLong();
+                const bool bAppend = match.captured(3) == u"a";
+
+                for(; next < (bAppend ? first : first - 1); ++next)
+                    result += lines[next] + '\n';
+                if(!bAppend)
+                    next = last;
+                bAdded = false;
+            }
+            else if(line.startsWith("> "))
+            {
+                result += line.mid(2) + '\n';
+                bAdded = true;
+            }
+            else if(line.startsWith("\\ ") && bAdded)
+                result.chop(1);
+        }
+
+        const bool bKeepsLastLine = next < lines.size();
+        for(; next < lines.size(); ++next)
+            result += lines[next] + '\n';
+        if(!bEndsWithNewLine && bKeepsLastLine)
+            result.chop(1);
+        return result;
+    }
+
+    static QByteArray runDiff(const QByteArray& text1, const QByteArray& text2, const qint64 windowSize, bool& bDifferent)
+    {
+        QTemporaryFile file1, file2;
+        file1.open();
+        file1.write(text1);
+        file1.close();
+        file2.open();
+        file2.write(text2);
+        file2.close();
+
+        QBuffer out;
+        out.open(QIODevice::WriteOnly);
+        StreamingDiff streamingDiff(file1.fileName(), file2.fileName(), windowSize);
+        const bool bOk = streamingDiff.run(out);
+        bDifferent = streamingDiff.hasDifferences();
+        return bOk ? out.data() : QByteArray("error");
+    }
+
+  private Q_SLOTS:
+    void testSmall()
+    {
+        bool bDifferent = false;
+        QCOMPARE(runDiff("a\nb\nc\n", "a\nb\nc\n", 1024, bDifferent), QByteArray());
+        QVERIFY(!bDifferent);
+
+        // White space is ignored for matching only.
+        QCOMPARE(runDiff("a\nb\nc\n", "a\n x\nc \nd", 1024, bDifferent),
+                 QByteArray("2,3c2,4\n< b\n< c\n---\n>  x\n> c \n> d\n\\ No newline at end of file\n"));
+        QVERIFY(bDifferent);
+
+        QCOMPARE(runDiff("", "a\n", 1024, bDifferent), QByteArray("0a1\n> a\n"));
+        QCOMPARE(runDiff("a\nb\n", "b\n", 1024, bDifferent), QByteArray("1d0\n< a\n"));
+    }
+
+    void testWindows_data()
+    {
+        QTest::addColumn<qint64>("windowSize");
+
+        QTest::addRow("tiny") << (qint64)64;
+        QTest::addRow("small") << (qint64)1000;
+        QTest::addRow("whole file") << StreamingDiff::defaultWindowSize;
+    }
+
+    /*
+        Whatever the window size the output must turn the first file into the second.
+    */
+    void testWindows()
+    {
+        QFETCH(qint64, windowSize);
+
+        QByteArray text1, text2;
+        for(qint32 i = 0; i < 3000; ++i)
+        {
+            const QByteArray line = "line " + QByteArray::number(i) + (i % 10 == 0 ? " \xC3\xA4\n" : "\n");
+            text1 += line;
+            if(i % 53 == 0)
+                continue;
+            text2 += i % 37 == 0 ? QByteArray("changed " + line) : line;
+            if(i % 71 == 0)
+                text2 += "inserted\n";
+            if(i == 1500)
+                text2 += QByteArray(300, 'x') + '\n';
+        }
+        text2 += "last";
+
+        bool bDifferent = false;
+        const QByteArray diff = runDiff(text1, text2, windowSize, bDifferent);
+        QVERIFY(bDifferent);
+        QCOMPARE(applyDiff(text1, diff), text2);
+        QCOMPARE(applyDiff(text2, runDiff(text2, text1, windowSize, bDifferent)), text1);
+
+        QCOMPARE(runDiff(text1, text1, windowSize, bDifferent), QByteArray());
+        QVERIFY(!bDifferent);
+    }
+};
+
+QTEST_MAIN(StreamingDiffTest);
+
+#include "StreamingDiffTest.moc"
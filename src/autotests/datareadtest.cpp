@@ -13,6 +13,8 @@
 
 #include <memory>
 
+#include <QFile>
+#include <QTemporaryDir>
 #include <QTemporaryFile>
 #include <QTest>
 
@@ -328,6 +330,233 @@ class DataReadTest: public QObject
         QCOMPARE(simData.lineCount(), 2);
         QCOMPARE(simData.getSizeBytes(), FileAccess(eolTest.fileName()).size());
     }
+
+    /*
+        Local files are memory mapped while decoding. Binary comparison and saving still work without the raw bytes.
+    */
+    void mappedDataTest()
+    {
+        QTemporaryFile testFile1, testFile2, outFile;
+        std::shared_ptr<SourceDataMoc> simData1 = std::make_shared<SourceDataMoc>();
+        std::shared_ptr<SourceDataMoc> simData2 = std::make_shared<SourceDataMoc>();
+
+        testFile1.open();
+        testFile1.write("a\n b\nc\n");
+        testFile1.close();
+        testFile2.open();
+        testFile2.write("a\n b\nc\n");
+        testFile2.close();
+
+        simData1->setFilename(testFile1.fileName());
+        simData1->readAndPreprocess("UTF-8", false);
+        simData2->setFilename(testFile2.fileName());
+        simData2->readAndPreprocess("UTF-8", false);
+        QVERIFY(simData1->getErrors().isEmpty());
+        QVERIFY(simData1->hasData());
+        QVERIFY(simData1->getBuf() == nullptr);
+        QCOMPARE(simData1->lineCount(), 4);
+        QVERIFY(simData1->isBinaryEqualWith(simData2));
+
+        outFile.open();
+        outFile.close();
+        QVERIFY(simData1->saveNormalDataAs(outFile.fileName()));
+        outFile.open();
+        QCOMPARE(outFile.readAll(), QByteArray("a\n b\nc\n"));
+        outFile.close();
+
+        testFile2.open();
+        testFile2.write("a\n b\nd\n");
+        testFile2.close();
+        simData2->setFilename(testFile2.fileName());
+        simData2->readAndPreprocess("UTF-8", false);
+        QVERIFY(!simData1->isBinaryEqualWith(simData2));
+    }
+
+    /*
+        Saving a loaded input over its own file, after a backup renamed it away. And an input changed by another
+        program after loading, which must neither crash nor be saved.
+    */
+    void saveOverInputTest()
+    {
+        QTemporaryDir dir;
+        const QString inputName = dir.filePath("input.txt");
+        const QString copyName = dir.filePath("copy.txt");
+        const QByteArray content("a\n b\nc\n");
+
+        const auto writeFile = [](const QString& fileName, const QByteArray& data) {
+            QFile file(fileName);
+            QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+            file.write(data);
+        };
+        const auto readFile = [](const QString& fileName) {
+            QFile file(fileName);
+            return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+        };
+
+        for(const bool bBackup: {true, false})
+        {
+            writeFile(inputName, content);
+            writeFile(copyName, content);
+            std::shared_ptr<SourceDataMoc> input = std::make_shared<SourceDataMoc>();
+            std::shared_ptr<SourceDataMoc> copy = std::make_shared<SourceDataMoc>();
+            input->setFilename(inputName);
+            input->readAndPreprocess("UTF-8", false);
+            copy->setFilename(copyName);
+            copy->readAndPreprocess("UTF-8", false);
+            QVERIFY(input->getErrors().isEmpty());
+            QVERIFY(input->isBinaryEqualWith(copy));
+
+            if(bBackup)
+            {
+                // What the automatic merge does before the backup.
+                QVERIFY(input->loadRawData());
+                // Same as FileAccess::createBackup, which needs a job handler.
+                QVERIFY(QFile::rename(inputName, inputName + ".orig"));
+            }
+
+            // Shorter than before, truncating a file that is still mapped would crash below.
+            QVERIFY(FileAccess(inputName, true).writeFile("x\n", 2));
+            QCOMPARE(readFile(inputName), QByteArray("x\n"));
+            QVERIFY(input->isBinaryEqualWith(copy));
+            QCOMPARE(input->getText(), QString::fromLatin1(content));
+
+            if(bBackup)
+            {
+                QVERIFY(input->saveNormalDataAs(inputName));
+                QCOMPARE(readFile(inputName), content);
+            }
+            else
+            {
+                // The data read again would not be what was compared.
+                QVERIFY(!input->saveNormalDataAs(inputName));
+                QVERIFY(!input->loadRawData());
+                QCOMPARE(readFile(inputName), QByteArray("x\n"));
+            }
+
+            QVERIFY(copy->saveNormalDataAs(inputName));
+            QCOMPARE(readFile(inputName), content);
+            QVERIFY(input->isBinaryEqualWith(copy));
+
+            QFile::remove(inputName + ".orig");
+        }
+    }
+
+    /*
+        Valid input is decoded in one go, anything else is decoded char by char. Both must split lines the same way.
+    */
+    void decodeFallbackTest()
+    {
+        QTemporaryFile testFile;
+        SourceDataMoc simData;
+        // Plain ASCII would otherwise not be decoded at all, see compactStorageTest.
+        gOptions->mCompactTextStorage = false;
+
+        testFile.open();
+        testFile.write("a\r\n b\r\nc\r\n");
+        testFile.close();
+
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess("UTF-8", false);
+        QVERIFY(simData.getErrors().isEmpty());
+        QVERIFY(!simData.isIncompleteConversion());
+        QCOMPARE(simData.getLineEndStyle(), eLineEndStyleDos);
+        QCOMPARE(simData.lineCount(), 4);
+        QCOMPARE(simData.getText(), QString(u"a\n b\nc\n"));
+        QCOMPARE((*simData.getLineDataForDisplay())[1].getFirstNonWhiteChar(), 2);
+
+        testFile.resize(0);
+        testFile.open();
+        testFile.write("a\xff\r\n b\r\nc\r\n");
+        testFile.close();
+
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess("UTF-8", false);
+        QVERIFY(simData.getErrors().isEmpty());
+        QVERIFY(simData.isIncompleteConversion());
+        QCOMPARE(simData.getLineEndStyle(), eLineEndStyleDos);
+        QCOMPARE(simData.lineCount(), 4);
+        QCOMPARE(simData.getText(), QString(u"a\uFFFD\n b\nc\n"));
+        QCOMPARE((*simData.getLineDataForDisplay())[1].getFirstNonWhiteChar(), 2);
+
+        // Lines are compacted into the decoded text, comments removed in place must not shift the next line.
+        testFile.resize(0);
+        testFile.open();
+        testFile.write("x\xc3\xa4 // c\r\ny\rz");
+        testFile.close();
+
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess("UTF-8", true);
+        QVERIFY(simData.getErrors().isEmpty());
+        QCOMPARE(simData.lineCount(), 3);
+        QVERIFY(simData.getText().startsWith(QString(u"x\u00e4 ")));
+        QVERIFY(simData.getText().endsWith(QString(u"\ny\nz")));
+        QCOMPARE(simData.getText().size(), 11);
+        QCOMPARE((*simData.getLineDataForDisplay())[1].getLine(), QString(u"y"));
+        QCOMPARE((*simData.getLineDataForDisplay())[2].getLine(), QString(u"z"));
+        gOptions->mCompactTextStorage = true;
+    }
+
+    /*
+        Text that fits into Latin-1 is kept as 8-bit data. From the outside it must look the same as decoded text.
+    */
+    void compactStorageTest()
+    {
+        QTemporaryFile testFile;
+        SourceDataMoc simData;
+
+        testFile.open();
+        testFile.write("a\r\n \xa0" "b\r\n\xe4//x\r\n");
+        testFile.close();
+
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess("ISO-8859-1", false);
+        QVERIFY(simData.getErrors().isEmpty());
+        QVERIFY(!simData.isIncompleteConversion());
+        QCOMPARE(simData.getLineEndStyle(), eLineEndStyleDos);
+        QCOMPARE(simData.lineCount(), 4);
+        QCOMPARE(simData.getText(), QString(u"a\n \u00a0b\n\u00e4//x\n"));
+        // Widened only once.
+        QCOMPARE(simData.getText().constData(), simData.getText().constData());
+
+        std::shared_ptr<LineDataVector> lineData = simData.getLineDataForDisplay();
+        QVERIFY((*lineData)[0].isLatin1());
+        QCOMPARE((*lineData)[1].getFirstNonWhiteChar(), 3);
+        QCOMPARE((*lineData)[2].getLine(), QString(u"\u00e4//x"));
+
+        // Same result when decoded.
+        gOptions->mCompactTextStorage = false;
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess("ISO-8859-1", false);
+        gOptions->mCompactTextStorage = true;
+        lineData = simData.getLineDataForDisplay();
+        QVERIFY(!(*lineData)[0].isLatin1());
+        QCOMPARE(simData.lineCount(), 4);
+        QCOMPARE(simData.getText(), QString(u"a\n \u00a0b\n\u00e4//x\n"));
+        QCOMPARE((*lineData)[1].getFirstNonWhiteChar(), 3);
+
+        // Only ASCII is stored as is for UTF-8.
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess("UTF-8", false);
+        QVERIFY(!(*simData.getLineDataForDisplay())[0].isLatin1());
+        QVERIFY(simData.isIncompleteConversion());
+
+        testFile.resize(0);
+        testFile.open();
+        testFile.write("\xEF\xBB\xBF" "a\nb");
+        testFile.close();
+
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess("UTF-8-BOM", false);
+        QVERIFY((*simData.getLineDataForDisplay())[0].isLatin1());
+        QCOMPARE(simData.lineCount(), 2);
+        QCOMPARE(simData.getText(), QString(u"a\nb"));
+
+        // The byte order mark disagrees with the requested encoding, the data must be decoded as requested.
+        simData.setFilename(testFile.fileName());
+        simData.readAndPreprocess("ISO-8859-1", false);
+        QVERIFY(!(*simData.getLineDataForDisplay())[0].isLatin1());
+        QCOMPARE(simData.getText(), QString::fromLatin1("\xEF\xBB\xBF" "a\nb"));
+    }
 };
 
 QTEST_MAIN(DataReadTest);
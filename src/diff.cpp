@@ -12,17 +12,23 @@
 #include <QtGlobal>
 
 #include "gnudiff_diff.h"
+#include "HistogramDiff.h"
 #include "Logging.h"
 #include "options.h"
+#include "Parallel.h"
 #include "ProgressProxy.h"
 #include "Utils.h"
 
 #include <algorithm>           // for min
+#include <atomic>
+#include <climits>
 #include <cstdlib>
+#include <cstring>
 #include <ctype.h>
 #include <exception>
 #include <memory>
 #include <optional>
+#include <unordered_map>
 #include <utility>             // for swap
 
 #ifndef AUTOTEST
@@ -30,8 +36,12 @@
 #include <KMessageBox>
 #endif
 
+#include <QMutex>
 #include <QRegularExpression>
 #include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
 
 constexpr bool g_bIgnoreWhiteSpace = true;
 
@@ -57,6 +67,29 @@ qint32 LineData::width(qint32 tabSize) const
     return w;
 }
 
+/*
+    Lines may be stored as QChar or as Latin-1 bytes. Compare them by UTF-16 code unit so either kind can
+    be diffed against the other without widening.
+*/
+static inline char16_t codeUnit(const QChar c) { return c.unicode(); }
+static inline char16_t codeUnit(const char c) { return (uchar)c; }
+
+// Exact comparison without widening Latin-1 lines.
+static bool sameText(const LineData& l1, const LineData& l2)
+{
+    if(l1.size() != l2.size())
+        return false;
+
+    if(l1.isLatin1() && l2.isLatin1())
+        return memcmp(l1.latin1Data(), l2.latin1Data(), l1.size()) == 0;
+    if(l1.isLatin1())
+        return QLatin1StringView(l1.latin1Data(), l1.size()) == QStringView(l2.unicodeData(), l2.size());
+    if(l2.isLatin1())
+        return QStringView(l1.unicodeData(), l1.size()) == QLatin1StringView(l2.latin1Data(), l2.size());
+
+    return QStringView(l1.unicodeData(), l1.size()) == QStringView(l2.unicodeData(), l2.size());
+}
+
 class StringIter {
     QString::const_iterator ptr;
     QString::const_iterator end;
@@ -128,6 +161,68 @@ bool LineData::equal(const LineData& l1, const LineData& l2)
     }
 }
 
+static inline QChar toQChar(QChar c) { return c; }
+static inline QChar toQChar(char c) { return QChar::fromLatin1(c); }
+
+template <typename Char>
+static size_t hashLineRange(const Char* p, const Char* const end, const LineHashOptions& options)
+{
+    // Same hash as GnuDiff uses: HASH(h, c) = c + ROL(h, 7)
+    size_t h = 0;
+    for(; p != end; ++p)
+    {
+        QChar c = toQChar(*p);
+        if(options.bIgnoreWhiteSpace && isspace((unsigned char)c.unicode()))
+            continue;
+        if(options.bIgnoreNumbers && (c.isDigit() || c == u'-' || c == u'.'))
+            continue;
+        if(options.bIgnoreCase)
+            c = c.toLower();
+        h = c.unicode() + (h << 7 | h >> (sizeof(h) * CHAR_BIT - 7));
+    }
+    return h;
+}
+
+std::shared_ptr<const std::vector<size_t>> LineDataVector::lineHashes(const LineHashOptions& options, const size_t first, const size_t count) const
+{
+    assert(first + count <= size());
+
+    QMutexLocker locker(&mHashMutex);
+    auto entry = std::find_if(mLineHashes.begin(), mLineHashes.end(), [&options](const LineHashes& e) { return e.options == options; });
+    if(entry == mLineHashes.end() || entry->hashes->size() != size())
+    {
+        if(entry != mLineHashes.end())
+            mLineHashes.erase(entry);
+
+        mLineHashes.push_back({options, std::make_shared<std::vector<size_t>>(size()), std::vector<bool>((size() + hashBlockSize - 1) / hashBlockSize, false)});
+        entry = std::prev(mLineHashes.end());
+    }
+
+    // Only the blocks touching the range, unchanged parts of big files are never hashed.
+    std::vector<size_t>& hashes = *entry->hashes;
+    const size_t lastBlock = count == 0 ? 0 : (first + count - 1) / hashBlockSize + 1;
+    for(size_t block = first / hashBlockSize; block < lastBlock; ++block)
+    {
+        if(entry->blockDone[block])
+            continue;
+
+        const size_t end = std::min(size(), (block + 1) * hashBlockSize);
+        for(size_t i = block * hashBlockSize; i < end; ++i)
+        {
+            const LineData& line = (*this)[i];
+            if(!line.hasBuffer())
+                hashes[i] = 0;
+            else if(line.isLatin1())
+                hashes[i] = hashLineRange(line.latin1Data(), line.latin1Data() + line.size(), options);
+            else
+                hashes[i] = hashLineRange(line.unicodeData(), line.unicodeData() + line.size(), options);
+        }
+        entry->blockDone[block] = true;
+    }
+
+    return entry->hashes;
+}
+
 // First step
 void Diff3LineList::calcDiff3LineListUsingAB(const DiffList* pDiffListAB)
 {
@@ -614,17 +709,40 @@ qint32 ManualDiffHelpEntry::calcManualDiffFirstDiff3LineIdx(const Diff3LineVecto
     return -1;
 }
 
+// Same text in both lines, compared directly on the buffers.
+static bool identicalLines(const LineData& line1, const LineData& line2)
+{
+    if(!line1.hasBuffer() || !line2.hasBuffer() || line1.size() != line2.size())
+        return false;
+
+    if(line1.isLatin1() == line2.isLatin1())
+    {
+        if(line1.isLatin1())
+            return memcmp(line1.latin1Data(), line2.latin1Data(), line1.size()) == 0;
+        return memcmp(line1.unicodeData(), line2.unicodeData(), line1.size() * sizeof(QChar)) == 0;
+    }
+
+    const char* latin1 = line1.isLatin1() ? line1.latin1Data() : line2.latin1Data();
+    const QChar* unicode = line1.isLatin1() ? line2.unicodeData() : line1.unicodeData();
+    for(qsizetype i = 0; i < line1.size(); ++i)
+    {
+        if(QChar::fromLatin1(latin1[i]) != unicode[i])
+            return false;
+    }
+    return true;
+}
+
 void DiffList::runDiff(const std::shared_ptr<const LineDataVector>& p1, const size_t index1, LineRef size1, const std::shared_ptr<const LineDataVector>& p2, const size_t index2, LineRef size2)
 {
     ProgressScope pp;
-    static GnuDiff gnuDiff; // All values are initialized with zeros.
 
     ProgressProxy::setCurrent(0);
 
     clear();
-    if(p1->empty() || (*p1)[index1].getBuffer() == nullptr || p2->empty() || (*p2)[index2].getBuffer() == nullptr || size1 == 0 || size2 == 0)
+    mbFastMode = false;
+    if(p1->empty() || !(*p1)[index1].hasBuffer() || p2->empty() || !(*p2)[index2].hasBuffer() || size1 == 0 || size2 == 0)
     {
-        if(!p1->empty() && !p2->empty() && (*p1)[index1].getBuffer() == nullptr && (*p2)[index2].getBuffer() == nullptr && size1 == size2)
+        if(!p1->empty() && !p2->empty() && !(*p1)[index1].hasBuffer() && !(*p2)[index2].hasBuffer() && size1 == size2)
             push_back(Diff(size1, 0, 0));
         else
         {
@@ -633,74 +751,279 @@ void DiffList::runDiff(const std::shared_ptr<const LineDataVector>& p1, const si
     }
     else
     {
-        assert((size_t)size1 < p1->size() && (size_t)size2 < p2->size());
-
-        GnuDiff::comparison comparisonInput;
-        memset(&comparisonInput, 0, sizeof(comparisonInput));
-        comparisonInput.parent = nullptr;
-
-        //TODO: make this byte based as in the original gnu diff code and kdiff3.
-        //buffer QChar* so offset is in UFT-16 code points (i.e. sizeof(QChar)).
-        comparisonInput.file[0].buffer = (*p1)[index1].getBuffer()->unicode() + (*p1)[index1].getOffset();                                         //ptr to buffer
-        comparisonInput.file[0].buffered = ((*p1)[index1 + size1 - 1].getOffset() + (*p1)[index1 + size1 - 1].size() - (*p1)[index1].getOffset()); // size of buffer
-        comparisonInput.file[1].buffer = (*p2)[index2].getBuffer()->unicode() + (*p2)[index2].getOffset();                                         //ptr to buffer
-        comparisonInput.file[1].buffered = ((*p2)[index2 + size2 - 1].getOffset() + (*p2)[index2 + size2 - 1].size() - (*p2)[index2].getOffset()); // size of buffer
-
-        gnuDiff.ignore_white_space = GnuDiff::IGNORE_ALL_SPACE; // I think nobody needs anything else ...
-        gnuDiff.bIgnoreWhiteSpace = true;
-        gnuDiff.bIgnoreNumbers = gOptions->m_bIgnoreNumbers;
-        gnuDiff.minimal = gOptions->m_bTryHard;
-        gnuDiff.ignore_case = false;
-        GnuDiff::change* script = gnuDiff.diff_2_files(&comparisonInput);
-
-        LineRef equalLinesAtStart = (LineRef)comparisonInput.file[0].prefix_lines;
-        LineRef currentLine1 = 0;
-        LineRef currentLine2 = 0;
-        GnuDiff::change* p = nullptr;
-        for(GnuDiff::change* e = script; e; e = p)
+        /*
+            Lines at the start or end with the same text are equal whatever the options, so only the part in
+            between goes through the line matching. For big files with a few changes that is a small part.
+        */
+        LineType prefix = 0;
+        while(prefix < size1 && prefix < size2 && identicalLines((*p1)[index1 + prefix], (*p2)[index2 + prefix]))
+            ++prefix;
+
+        LineType suffix = 0;
+        while(prefix + suffix < size1 && prefix + suffix < size2 &&
+              identicalLines((*p1)[index1 + size1 - 1 - suffix], (*p2)[index2 + size2 - 1 - suffix]))
+            ++suffix;
+
+        const LineType middle1 = size1 - prefix - suffix;
+        const LineType middle2 = size2 - prefix - suffix;
+        if(middle1 == 0 || middle2 == 0)
+            push_back(Diff(prefix, middle1, middle2));
+        else
         {
-            Diff d((LineType)(e->line0 - currentLine1), e->deleted, e->inserted);
-            assert(d.numberOfEquals() == e->line1 - currentLine2);
+            if(!gOptions->mAnchoredDiff || middle1 + middle2 < anchoredDiffMinLines ||
+               !runAnchoredDiff(p1, index1 + prefix, middle1, p2, index2 + prefix, middle2))
+                runLineMatching(p1, index1 + prefix, middle1, p2, index2 + prefix, middle2);
 
-            currentLine1 += LineRef((quint64)d.numberOfEquals() + d.diff1());
-            currentLine2 += LineRef((quint64)d.numberOfEquals() + d.diff2());
-            assert(currentLine1 <= size1 && currentLine2 <= size2);
-            push_back(d);
+            assert(!empty());
+            front().adjustNumberOfEquals(prefix);
+        }
 
-            p = e->link;
-            free(e);
+        if(suffix > 0)
+            push_back(Diff(suffix, 0, 0));
+    }
+#ifndef NDEBUG
+    verify(size1, size2);
+#endif
+    ProgressProxy::setCurrent(1);
+}
+
+void DiffList::runLineMatching(const std::shared_ptr<const LineDataVector>& p1, const size_t index1, LineRef size1, const std::shared_ptr<const LineDataVector>& p2, const size_t index2, LineRef size2)
+{
+    assert(empty());
+
+    if(size1 == 0 || size2 == 0)
+        push_back(Diff(0, size1, size2));
+    else if(gOptions->mDiffAlgorithm == eDiffAlgorithmHistogram)
+        HistogramDiff(p1, index1, size1, p2, index2, size2).run(*this);
+    else
+        runGnuDiff(p1, index1, size1, p2, index2, size2);
+}
+
+void DiffList::appendEquals(const LineType count)
+{
+    if(count == 0)
+        return;
+
+    if(empty() || back().diff1() > 0 || back().diff2() > 0)
+        push_back(Diff(count, 0, 0));
+    else
+        back().adjustNumberOfEquals(count);
+}
+
+void DiffList::appendChange(const quint64 count1, const quint64 count2)
+{
+    if(count1 == 0 && count2 == 0)
+        return;
+
+    if(empty())
+        push_back(Diff(0, count1, count2));
+    else
+    {
+        back().adjustDiff1(count1);
+        back().adjustDiff2(count2);
+    }
+}
+
+bool DiffList::runAnchoredDiff(const std::shared_ptr<const LineDataVector>& p1, const size_t index1, LineRef size1, const std::shared_ptr<const LineDataVector>& p2, const size_t index2, LineRef size2)
+{
+    const LineHashOptions hashOptions{true, gOptions->m_bIgnoreNumbers, false};
+    const std::shared_ptr<const std::vector<size_t>> hashes1 = p1->lineHashes(hashOptions, index1, size1);
+    const std::shared_ptr<const std::vector<size_t>> hashes2 = p2->lineHashes(hashOptions, index2, size2);
+
+    // Per hash: occurrences on each side and where the last one was.
+    struct Occurrence {
+        qint32 count1 = 0;
+        qint32 count2 = 0;
+        LineType line1 = 0;
+        LineType line2 = 0;
+    };
+    std::unordered_map<size_t, Occurrence> occurrences;
+    occurrences.reserve((size_t)size1);
+    for(LineType i = 0; i < size1; ++i)
+    {
+        Occurrence& o = occurrences[(*hashes1)[index1 + i]];
+        ++o.count1;
+        o.line1 = i;
+    }
+    for(LineType i = 0; i < size2; ++i)
+    {
+        const auto it = occurrences.find((*hashes2)[index2 + i]);
+        if(it != occurrences.end())
+        {
+            ++it->second.count2;
+            it->second.line2 = i;
         }
+    }
+
+    // Unique lines in the order of the first file, with their line in the second.
+    std::vector<std::pair<LineType, LineType>> unique;
+    for(LineType i = 0; i < size1; ++i)
+    {
+        const Occurrence& o = occurrences[(*hashes1)[index1 + i]];
+        if(o.count1 == 1 && o.count2 == 1 && identicalLines((*p1)[index1 + i], (*p2)[index2 + o.line2]))
+            unique.emplace_back(i, o.line2);
+    }
+    occurrences.clear();
+
+    // Longest run of them in the same order in both files, patience sorting style.
+    std::vector<qsizetype> pileTops;
+    std::vector<qsizetype> predecessor(unique.size(), -1);
+    for(qsizetype k = 0; k < (qsizetype)unique.size(); ++k)
+    {
+        const auto pile = std::lower_bound(pileTops.begin(), pileTops.end(), unique[k].second,
+                                           [&unique](const qsizetype top, const LineType line2) { return unique[top].second < line2; });
+        if(pile != pileTops.begin())
+            predecessor[k] = *(pile - 1);
+        if(pile == pileTops.end())
+            pileTops.push_back(k);
+        else
+            *pile = k;
+    }
+    if(pileTops.empty())
+        return false;
+
+    std::vector<std::pair<LineType, LineType>> anchors;
+    for(qsizetype k = pileTops.back(); k >= 0; k = predecessor[k])
+        anchors.push_back(unique[k]);
+    std::reverse(anchors.begin(), anchors.end());
+
+    // Parts end right before an anchor, which is equal itself. Small parts are merged with the next one.
+    struct Part {
+        LineType begin1, end1, begin2, end2;
+        DiffList diffList;
+    };
+    std::vector<Part> parts;
+    LineType begin1 = 0, begin2 = 0;
+    for(const std::pair<LineType, LineType>& anchor: anchors)
+    {
+        if(anchor.first - begin1 < anchoredDiffPartLines || size1 - anchor.first < anchoredDiffPartLines)
+            continue;
+        parts.push_back({begin1, anchor.first, begin2, anchor.second, {}});
+        begin1 = anchor.first + 1;
+        begin2 = anchor.second + 1;
+    }
+    if(parts.empty())
+        return false;
+    parts.push_back({begin1, size1, begin2, size2, {}});
+
+    Parallel::forEach((qsizetype)parts.size(), [&](const qsizetype i) {
+        Part& part = parts[i];
+        part.diffList.runLineMatching(p1, index1 + part.begin1, part.end1 - part.begin1, p2, index2 + part.begin2, part.end2 - part.begin2);
+    });
 
-        if(empty())
+    for(const Part& part: parts)
+    {
+        // The anchor before the part.
+        if(part.begin1 > 0)
+            appendEquals(1);
+        for(const Diff& d: part.diffList)
         {
-            LineType numofEquals = std::min(size1, size2);
-            Diff d(numofEquals, size1 - numofEquals, size2 - numofEquals);
+            appendEquals(d.numberOfEquals());
+            appendChange(d.diff1(), d.diff2());
+        }
+        if(part.diffList.usedFastMode())
+            mbFastMode = true;
+    }
+    return true;
+}
 
-            push_back(d);
+void DiffList::runGnuDiff(const std::shared_ptr<const LineDataVector>& p1, const size_t index1, LineRef size1, const std::shared_ptr<const LineDataVector>& p2, const size_t index2, LineRef size2)
+{
+    GnuDiff gnuDiff; // Local so several diffs can run at the same time.
+
+    assert(empty());
+    assert((size_t)size1 < p1->size() && (size_t)size2 < p2->size());
+
+    GnuDiff::comparison comparisonInput;
+    memset(&comparisonInput, 0, sizeof(comparisonInput));
+    comparisonInput.parent = nullptr;
+
+    const LineData& first1 = (*p1)[index1];
+    const LineData& first2 = (*p2)[index2];
+    //Offsets are in QChars or bytes depending on how the lines are stored.
+    comparisonInput.file[0].buffered = ((*p1)[index1 + size1 - 1].getOffset() + (*p1)[index1 + size1 - 1].size() - first1.getOffset()); // size of buffer
+    comparisonInput.file[1].buffered = ((*p2)[index2 + size2 - 1].getOffset() + (*p2)[index2 + size2 - 1].size() - first2.getOffset()); // size of buffer
+
+    // GnuDiff needs both sides stored the same way. Only widen if Latin-1 text is compared with other text.
+    QString widened1, widened2;
+    if(first1.isLatin1() && first2.isLatin1())
+    {
+        comparisonInput.file[0].latin1Buffer = first1.latin1Data();
+        comparisonInput.file[1].latin1Buffer = first2.latin1Data();
+    }
+    else
+    {
+        if(first1.isLatin1())
+            widened1 = QString::fromLatin1(first1.latin1Data(), (qsizetype)comparisonInput.file[0].buffered);
+        if(first2.isLatin1())
+            widened2 = QString::fromLatin1(first2.latin1Data(), (qsizetype)comparisonInput.file[1].buffered);
+
+        comparisonInput.file[0].buffer = first1.isLatin1() ? widened1.constData() : first1.unicodeData();
+        comparisonInput.file[1].buffer = first2.isLatin1() ? widened2.constData() : first2.unicodeData();
+    }
+
+    gnuDiff.ignore_white_space = GnuDiff::IGNORE_ALL_SPACE; // I think nobody needs anything else ...
+    gnuDiff.bIgnoreWhiteSpace = true;
+    gnuDiff.bIgnoreNumbers = gOptions->m_bIgnoreNumbers;
+    gnuDiff.minimal = gOptions->m_bTryHard;
+    gnuDiff.ignore_case = false;
+
+    // Both files are hashed once per load instead of once per comparison.
+    const LineHashOptions hashOptions{true, gnuDiff.bIgnoreNumbers, gnuDiff.ignore_case};
+    const std::shared_ptr<const std::vector<size_t>> hashes1 = p1->lineHashes(hashOptions, index1, size1);
+    const std::shared_ptr<const std::vector<size_t>> hashes2 = p2->lineHashes(hashOptions, index2, size2);
+    comparisonInput.file[0].line_hashes = hashes1->data() + index1;
+    comparisonInput.file[1].line_hashes = hashes2->data() + index2;
+    if(gOptions->mFastLargeFiles)
+    {
+        gnuDiff.large_file_lines = 200000;
+        gnuDiff.large_file_changes = 20000;
+        gnuDiff.large_file_cost = 1024;
+    }
+    GnuDiff::change* script = gnuDiff.diff_2_files(&comparisonInput);
+    if(gnuDiff.large_file_mode)
+        mbFastMode = true;
+
+    LineRef equalLinesAtStart = (LineRef)comparisonInput.file[0].prefix_lines;
+    LineRef currentLine1 = 0;
+    LineRef currentLine2 = 0;
+    // The change nodes belong to gnuDiff and go away with it.
+    for(GnuDiff::change* e = script; e; e = e->link)
+    {
+        Diff d((LineType)(e->line0 - currentLine1), e->deleted, e->inserted);
+        assert(d.numberOfEquals() == e->line1 - currentLine2);
+
+        currentLine1 += LineRef((quint64)d.numberOfEquals() + d.diff1());
+        currentLine2 += LineRef((quint64)d.numberOfEquals() + d.diff2());
+        assert(currentLine1 <= size1 && currentLine2 <= size2);
+        push_back(d);
+    }
+
+    if(empty())
+    {
+        LineType numofEquals = std::min(size1, size2);
+        Diff d(numofEquals, size1 - numofEquals, size2 - numofEquals);
+
+        push_back(d);
+    }
+    else
+    {
+        front().adjustNumberOfEquals(equalLinesAtStart);
+        currentLine1 += equalLinesAtStart;
+        currentLine2 += equalLinesAtStart;
+
+        LineType nofEquals = std::min(size1 - currentLine1, size2 - currentLine2);
+        if(nofEquals == 0)
+        {
+            back().adjustDiff1(size1 - currentLine1);
+            back().adjustDiff2(size2 - currentLine2);
         }
         else
         {
-            front().adjustNumberOfEquals(equalLinesAtStart);
-            currentLine1 += equalLinesAtStart;
-            currentLine2 += equalLinesAtStart;
-
-            LineType nofEquals = std::min(size1 - currentLine1, size2 - currentLine2);
-            if(nofEquals == 0)
-            {
-                back().adjustDiff1(size1 - currentLine1);
-                back().adjustDiff2(size2 - currentLine2);
-            }
-            else
-            {
-                Diff d(nofEquals, size1 - currentLine1 - nofEquals, size2 - currentLine2 - nofEquals);
-                push_back(d);
-            }
+            Diff d(nofEquals, size1 - currentLine1 - nofEquals, size2 - currentLine2 - nofEquals);
+            push_back(d);
         }
     }
-#ifndef NDEBUG
-    verify(size1, size2);
-#endif
-    ProgressProxy::setCurrent(1);
 }
 
 #ifndef NDEBUG
@@ -722,11 +1045,69 @@ void DiffList::verify(const LineRef size1, const LineRef size2)
 }
 #endif
 
+void DiffSegmentCache::startRun()
+{
+    LineMatchingOptions options;
+    options.diffAlgorithm = (qint32)gOptions->mDiffAlgorithm;
+    options.bTryHard = gOptions->m_bTryHard;
+    options.bIgnoreNumbers = gOptions->m_bIgnoreNumbers;
+    options.bFastLargeFiles = gOptions->mFastLargeFiles;
+    options.bAnchoredDiff = gOptions->mAnchoredDiff;
+
+    if(options != mOptions)
+    {
+        mSegments.clear();
+        mOptions = options;
+    }
+
+    for(auto& entry: mSegments)
+        entry.second.bUsed = false;
+}
+
+void DiffSegmentCache::finishRun()
+{
+    for(auto it = mSegments.begin(); it != mSegments.end();)
+    {
+        if(it->second.bUsed)
+            ++it;
+        else
+            it = mSegments.erase(it);
+    }
+}
+
+void DiffSegmentCache::runDiff(const std::shared_ptr<const LineDataVector>& p1, const size_t index1, LineRef size1, const std::shared_ptr<const LineDataVector>& p2, const size_t index2, LineRef size2, DiffList& diffList)
+{
+    const Key key{index1, size1, index2, size2};
+    auto it = mSegments.find(key);
+    if(it == mSegments.end())
+    {
+        diffList.runDiff(p1, index1, size1, p2, index2, size2);
+        it = mSegments.emplace(key, Segment{diffList}).first;
+    }
+    else
+        diffList = it->second.diffList;
+
+    it->second.bUsed = true;
+}
+
 void ManualDiffHelpList::runDiff(const std::shared_ptr<LineDataVector>& p1, LineRef size1, const std::shared_ptr<LineDataVector>& p2, LineRef size2, DiffList& diffList,
-                                 e_SrcSelector winIdx1, e_SrcSelector winIdx2)
+                                 e_SrcSelector winIdx1, e_SrcSelector winIdx2, DiffSegmentCache* pCache)
 {
     diffList.clear();
     DiffList diffList2;
+    bool bFastMode = false;
+
+    if(pCache != nullptr)
+        pCache->startRun();
+
+    const auto runRange = [&](const LineType begin1, const LineType end1, const LineType begin2, const LineType end2) {
+        if(pCache != nullptr)
+            pCache->runDiff(p1, begin1, end1 - begin1, p2, begin2, end2 - begin2, diffList2);
+        else
+            diffList2.runDiff(p1, begin1, end1 - begin1, p2, begin2, end2 - begin2);
+        bFastMode = bFastMode || diffList2.usedFastMode();
+        diffList.splice(diffList.end(), diffList2);
+    };
 
     qint32 l1begin = 0;
     qint32 l2begin = 0;
@@ -738,8 +1119,7 @@ void ManualDiffHelpList::runDiff(const std::shared_ptr<LineDataVector>& p1, Line
 
         if(l1end.isValid() && l2end.isValid())
         {
-            diffList2.runDiff(p1, l1begin, l1end - l1begin, p2, l2begin, l2end - l2begin);
-            diffList.splice(diffList.end(), diffList2);
+            runRange(l1begin, l1end, l2begin, l2end);
             l1begin = l1end;
             l2begin = l2end;
 
@@ -750,15 +1130,17 @@ void ManualDiffHelpList::runDiff(const std::shared_ptr<LineDataVector>& p1, Line
             {
                 ++l1end; // point to line after last selected line
                 ++l2end;
-                diffList2.runDiff(p1, l1begin, l1end - l1begin, p2, l2begin, l2end - l2begin);
-                diffList.splice(diffList.end(), diffList2);
+                runRange(l1begin, l1end, l2begin, l2end);
                 l1begin = l1end;
                 l2begin = l2end;
             }
         }
     }
-    diffList2.runDiff(p1, l1begin, size1 - l1begin, p2, l2begin, size2 - l2begin);
-    diffList.splice(diffList.end(), diffList2);
+    runRange(l1begin, size1, l2begin, size2);
+    diffList.setUsedFastMode(bFastMode);
+
+    if(pCache != nullptr)
+        pCache->finishRun();
 }
 
 void Diff3LineList::correctManualDiffAlignment(ManualDiffHelpList* pManualDiffHelpList)
@@ -1213,6 +1595,22 @@ void DiffBufferInfo::init(Diff3LineList* pD3ll,
     mLineDataC = pldC;
 }
 
+void DiffBufferInfo::setFineDiffData(const e_SrcSelector selector, const std::shared_ptr<const LineDataVector>& v1, const std::shared_ptr<const LineDataVector>& v2)
+{
+    assert(selector == e_SrcSelector::A || selector == e_SrcSelector::B || selector == e_SrcSelector::C);
+    mFineDiffData[(qint32)selector - (qint32)e_SrcSelector::A][0] = v1;
+    mFineDiffData[(qint32)selector - (qint32)e_SrcSelector::A][1] = v2;
+}
+
+void DiffBufferInfo::clearFineDiffData()
+{
+    for(auto& fineDiffData: mFineDiffData)
+    {
+        fineDiffData[0].reset();
+        fineDiffData[1].reset();
+    }
+}
+
 void Diff3LineList::calcWhiteDiff3Lines(
     const std::shared_ptr<const LineDataVector>& pldA, const std::shared_ptr<const LineDataVector>& pldB, const std::shared_ptr<const LineDataVector>& pldC, const bool bIgnoreComments)
 {
@@ -1226,18 +1624,251 @@ void Diff3LineList::calcWhiteDiff3Lines(
     }
 }
 
-// My own diff-invention:
 /*
     Builds DiffList from scratch. Automatically clears all previous data in list.
 */
 void DiffList::calcDiff(const QString& line1, const QString& line2, const qint32 maxSearchRange)
+{
+    calcDiffRange(line1.constData(), line1.constData() + line1.size(), line2.constData(), line2.constData() + line2.size(), maxSearchRange);
+}
+
+void DiffList::calcDiff(const LineData& line1, const LineData& line2, const qint32 maxSearchRange)
+{
+    if(line1.isLatin1())
+    {
+        if(line2.isLatin1())
+            calcDiffRange(line1.latin1Data(), line1.latin1Data() + line1.size(), line2.latin1Data(), line2.latin1Data() + line2.size(), maxSearchRange);
+        else
+            calcDiffRange(line1.latin1Data(), line1.latin1Data() + line1.size(), line2.unicodeData(), line2.unicodeData() + line2.size(), maxSearchRange);
+    }
+    else
+    {
+        if(line2.isLatin1())
+            calcDiffRange(line1.unicodeData(), line1.unicodeData() + line1.size(), line2.latin1Data(), line2.latin1Data() + line2.size(), maxSearchRange);
+        else
+            calcDiffRange(line1.unicodeData(), line1.unicodeData() + line1.size(), line2.unicodeData(), line2.unicodeData() + line2.size(), maxSearchRange);
+    }
+}
+
+namespace {
+/*
+    Myers' O(ND) algorithm in linear space. Rather than keeping the furthest paths of every step to trace the
+    result back, a range is split where the searches from both of its ends meet (the middle snake) and each
+    half is diffed the same way. Memory stays at two vectors of maxD / 2 entries.
+*/
+template <typename Char1, typename Char2>
+class MyersDiff
+{
+  public:
+    // Equal characters followed by removed and inserted ones.
+    struct Edit {
+        qsizetype equals;
+        qsizetype removed;
+        qsizetype inserted;
+    };
+
+    MyersDiff(const Char1* const begin1, const Char2* const begin2, const qint32 maxD, const QDeadlineTimer& deadline):
+        mBegin1(begin1), mBegin2(begin2), mMaxHalf((maxD + 1) / 2), mForward(2 * (size_t)mMaxHalf + 3), mBackward(2 * (size_t)mMaxHalf + 3), mDeadline(deadline)
+    {
+    }
+
+    // False if the search needs more than about maxD differences or the deadline expires.
+    bool run(const qsizetype size1, const qsizetype size2) { return compare(0, size1, 0, size2); }
+    [[nodiscard]] const std::vector<Edit>& edits() const { return mEdits; }
+
+  private:
+    [[nodiscard]] bool equal(const qsizetype x, const qsizetype y) const { return codeUnit(mBegin1[x]) == codeUnit(mBegin2[y]); }
+
+    void add(const qsizetype equals, const qsizetype removed, const qsizetype inserted)
+    {
+        if(equals > 0 || removed > 0 || inserted > 0)
+            mEdits.push_back({equals, removed, inserted});
+    }
+
+    bool compare(qsizetype x0, qsizetype x1, qsizetype y0, qsizetype y1)
+    {
+        // A common start and end need no search, this also keeps the halves of a split getting smaller.
+        qsizetype prefix = 0;
+        while(x0 + prefix < x1 && y0 + prefix < y1 && equal(x0 + prefix, y0 + prefix))
+            ++prefix;
+        x0 += prefix;
+        y0 += prefix;
+
+        qsizetype suffix = 0;
+        while(x1 - suffix > x0 && y1 - suffix > y0 && equal(x1 - suffix - 1, y1 - suffix - 1))
+            ++suffix;
+        x1 -= suffix;
+        y1 -= suffix;
+
+        add(prefix, 0, 0);
+        if(x0 == x1 || y0 == y1)
+            add(0, x1 - x0, y1 - y0);
+        else
+        {
+            qsizetype x = 0, y = 0;
+            if(!middleSnake(x0, x1, y0, y1, x, y) || !compare(x0, x, y0, y) || !compare(x, x1, y, y1))
+                return false;
+        }
+        add(suffix, 0, 0);
+        return true;
+    }
+
+    /*
+        Searches forward from the start and backward from the end until the paths overlap and returns the point
+        the forward path got to. A diagonal k = x - y is dropped once its path leaves the range.
+    */
+    bool middleSnake(const qsizetype x0, const qsizetype x1, const qsizetype y0, const qsizetype y1, qsizetype& splitX, qsizetype& splitY)
+    {
+        const qsizetype size1 = x1 - x0;
+        const qsizetype size2 = y1 - y0;
+        const qsizetype delta = size1 - size2;
+        // Paths of odd and even length meet on the forward and backward step respectively.
+        const bool bFront = delta % 2 != 0;
+        const qint32 maxHalf = (qint32)std::min<qsizetype>(mMaxHalf, (size1 + size2 + 1) / 2);
+        const qint32 offset = mMaxHalf + 1;
+
+        // Furthest x on each diagonal from either end, -1 where none got there yet. Only the diagonals this
+        // range can reach are reset and looked at, the rest is left over from bigger ranges.
+        std::fill(mForward.begin() + offset - maxHalf - 1, mForward.begin() + offset + maxHalf + 2, -1);
+        std::fill(mBackward.begin() + offset - maxHalf - 1, mBackward.begin() + offset + maxHalf + 2, -1);
+        mForward[offset + 1] = 0;
+        mBackward[offset + 1] = 0;
+
+        qint32 forwardStart = 0, forwardEnd = 0, backwardStart = 0, backwardEnd = 0;
+        for(qint32 d = 0; d <= maxHalf; ++d)
+        {
+            if(d % 16 == 0 && mDeadline.hasExpired())
+                return false;
+
+            for(qint32 k = -d + forwardStart; k <= d - forwardEnd; k += 2)
+            {
+                const qsizetype* v = &mForward[offset + k];
+                qsizetype x = (k == -d || (k != d && v[-1] < v[1])) ? v[1] : v[-1] + 1;
+                qsizetype y = x - k;
+                while(x < size1 && y < size2 && equal(x0 + x, y0 + y))
+                {
+                    ++x;
+                    ++y;
+                }
+                mForward[offset + k] = x;
+
+                if(x > size1)
+                    forwardEnd += 2;
+                else if(y > size2)
+                    forwardStart += 2;
+                else if(bFront)
+                {
+                    const qsizetype backwardK = offset + delta - k;
+                    if(std::abs(delta - k) <= maxHalf && mBackward[backwardK] != -1 && x >= size1 - mBackward[backwardK])
+                    {
+                        splitX = x0 + x;
+                        splitY = y0 + y;
+                        return true;
+                    }
+                }
+            }
+
+            for(qint32 k = -d + backwardStart; k <= d - backwardEnd; k += 2)
+            {
+                const qsizetype* v = &mBackward[offset + k];
+                qsizetype x = (k == -d || (k != d && v[-1] < v[1])) ? v[1] : v[-1] + 1;
+                qsizetype y = x - k;
+                while(x < size1 && y < size2 && equal(x1 - x - 1, y1 - y - 1))
+                {
+                    ++x;
+                    ++y;
+                }
+                mBackward[offset + k] = x;
+
+                if(x > size1)
+                    backwardEnd += 2;
+                else if(y > size2)
+                    backwardStart += 2;
+                else if(!bFront)
+                {
+                    const qsizetype forwardK = offset + delta - k;
+                    if(std::abs(delta - k) <= maxHalf && mForward[forwardK] != -1 && mForward[forwardK] >= size1 - x)
+                    {
+                        splitX = x0 + mForward[forwardK];
+                        splitY = y0 + mForward[forwardK] - (forwardK - offset);
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    const Char1* const mBegin1;
+    const Char2* const mBegin2;
+    const qint32 mMaxHalf;
+    std::vector<qsizetype> mForward;
+    std::vector<qsizetype> mBackward;
+    const QDeadlineTimer& mDeadline;
+    std::vector<Edit> mEdits;
+};
+} // namespace
+
+/*
+    Myers' O(ND) algorithm on the code units of a line pair, which finds the fewest inserted and removed
+    characters. Costs grow with the line length times the number of differences, so it stops at
+    maxMyersDifferences or the deadline and the caller falls back to the heuristic below.
+*/
+template <typename Char1, typename Char2>
+bool DiffList::calcMyersDiff(const Char1* const begin1, const Char1* const p1end, const Char2* const begin2, const Char2* const p2end, const QDeadlineTimer& deadline)
+{
+    assert(empty());
+
+    const qsizetype size1 = p1end - begin1;
+    const qsizetype size2 = p2end - begin2;
+    const qint32 maxD = (qint32)std::min<qsizetype>(size1 + size2, maxMyersDifferences);
+
+    MyersDiff<Char1, Char2> myers(begin1, begin2, maxD, deadline);
+    if(!myers.run(size1, size2))
+        return false;
+
+    // Two empty lines.
+    if(myers.edits().empty())
+        push_back(Diff(0, 0, 0));
+    for(const auto& edit: myers.edits())
+    {
+        appendEquals((LineType)edit.equals);
+        appendChange(edit.removed, edit.inserted);
+    }
+
+    /*
+        Single matching characters amid changes are mostly chance. Like the heuristic, only keep them close to
+        where they would be without the change before.
+    */
+    for(DiffList::iterator it = begin(); it != end();)
+    {
+        const DiffList::iterator next = std::next(it);
+        if(next != end() && next->numberOfEquals() == 1 && (next->diff1() > 0 || next->diff2() > 0) &&
+           std::abs((qint64)it->diff1() - (qint64)it->diff2()) >= 3)
+        {
+            it->adjustDiff1(1 + next->diff1());
+            it->adjustDiff2(1 + next->diff2());
+            erase(next);
+        }
+        else
+            it = next;
+    }
+    return true;
+}
+
+template <typename Char1, typename Char2>
+void DiffList::calcDiffRange(const Char1* const begin1, const Char1* const p1end, const Char2* const begin2, const Char2* const p2end, const qint32 maxSearchRange)
 {
     clear();
 
-    const QChar* p1end = line1.constData() + line1.size();
-    const QChar* p2end = line2.constData() + line2.size();
+    if(calcMyersDiff(begin1, p1end, begin2, p2end, QDeadlineTimer(fineDiffTimeBudget)))
+        return;
 
-    QString::const_iterator p1 = line1.cbegin(), p2 = line2.cbegin();
+    // My own diff-invention, it looks ahead at most maxSearchRange characters in the second line.
+    // It gets a budget of its own, otherwise a timed out exact diff would leave it none.
+    const QDeadlineTimer deadline(fineDiffTimeBudget);
+    const Char1* p1 = begin1;
+    const Char2* p2 = begin2;
 
     /*
         This loop should never reach the exit condition specified here. However it must have a hard wired
@@ -1246,8 +1877,16 @@ void DiffList::calcDiff(const QString& line1, const QString& line2, const qint32
      */
     for(; size() * sizeof(Diff) + sizeof(DiffList) < (50 << 20);)
     {
+        if(Q_UNLIKELY(deadline.hasExpired()))
+        {
+            // Out of time, the rest is one change.
+            if(p1 != p1end || p2 != p2end)
+                push_back(Diff(0, p1end - p1, p2end - p2));
+            break;
+        }
+
         qint32 nofEquals = 0;
-        while(p1 != line1.cend() && p2 != line2.cend() && *p1 == *p2)
+        while(p1 != p1end && p2 != p2end && codeUnit(*p1) == codeUnit(*p2))
         {
             ++p1;
             ++p2;
@@ -1272,9 +1911,9 @@ void DiffList::calcDiff(const QString& line1, const QString& line2, const qint32
                 {
                     break;
                 }
-                else if(p2[i2] == p1[i1] &&
+                else if(codeUnit(p2[i2]) == codeUnit(p1[i1]) &&
                         (abs(i1 - i2) < 3 || (&p2[i2 + 1] == p2end && &p1[i1 + 1] == p1end) ||
-                         (&p2[i2 + 1] != p2end && &p1[i1 + 1] != p1end && p2[i2 + 1] == p1[i1 + 1])))
+                         (&p2[i2 + 1] != p2end && &p1[i1 + 1] != p1end && codeUnit(p2[i2 + 1]) == codeUnit(p1[i1 + 1]))))
                 {
                     if(i1 + i2 < bestI1 + bestI2 || !bBestValid)
                     {
@@ -1301,7 +1940,7 @@ void DiffList::calcDiff(const QString& line1, const QString& line2, const qint32
         {
             // The match was found using the strict search. Go back if there are non-strict
             // matches.
-            while(bestI1 >= 1 && bestI2 >= 1 && p1[bestI1 - 1] == p2[bestI2 - 1])
+            while(bestI1 >= 1 && bestI2 >= 1 && codeUnit(p1[bestI1 - 1]) == codeUnit(p2[bestI2 - 1]))
             {
                 --bestI1;
                 --bestI2;
@@ -1329,10 +1968,10 @@ void DiffList::calcDiff(const QString& line1, const QString& line2, const qint32
         // A different match could be achieved, if we start at the end.
         // Do it, if it would be a better match.
         qint32 nofUnmatched = 0;
-        QString::const_iterator pu1 = p1 - 1;
-        QString::const_iterator pu2 = p2 - 1;
+        const Char1* pu1 = p1 - 1;
+        const Char2* pu2 = p2 - 1;
 
-        while(pu1 >= line1.begin() && pu2 >= line2.begin() && *pu1 == *pu2)
+        while(pu1 >= begin1 && pu2 >= begin2 && codeUnit(*pu1) == codeUnit(*pu2))
         {
             ++nofUnmatched;
             --pu1;
@@ -1402,7 +2041,7 @@ void DiffList::calcDiff(const QString& line1, const QString& line2, const qint32
             l2 += (theDiff.numberOfEquals() + theDiff.diff2());
         }
 
-        assert(l1 == line1.size() && l2 == line2.size());
+        assert(l1 == p1end - begin1 && l2 == p2end - begin2);
     }
 #endif // !NDEBUG
 }
@@ -1431,15 +2070,8 @@ void DiffList::optimize()
     }
 }
 
-bool Diff3Line::fineDiff(bool inBTextsTotalEqual, const e_SrcSelector selector, const std::shared_ptr<LineDataVector> &v1, const std::shared_ptr<LineDataVector> &v2, const IgnoreFlags eIgnoreFlags)
+void Diff3Line::getFineDiffLines(const e_SrcSelector selector, LineRef& k1, LineRef& k2) const
 {
-    LineRef k1 = 0;
-    LineRef k2 = 0;
-    qint32 maxSearchLength = 500;
-    bool bTextsTotalEqual = inBTextsTotalEqual;
-    bool bIgnoreComments = eIgnoreFlags & IgnoreFlag::ignoreComments;
-    bool bIgnoreWhiteSpace = eIgnoreFlags & IgnoreFlag::ignoreWhiteSpace;
-
     assert(selector == e_SrcSelector::A || selector == e_SrcSelector::B || selector == e_SrcSelector::C);
 
     if(selector == e_SrcSelector::A)
@@ -1457,23 +2089,96 @@ bool Diff3Line::fineDiff(bool inBTextsTotalEqual, const e_SrcSelector selector,
         k1 = getLineC();
         k2 = getLineA();
     }
+}
+
+const FineDiffRun* FineDiffArena::add(const DiffList& diffList)
+{
+    const qsizetype size = SafeInt<qsizetype>(diffList.size()) + 1;
+
+    FineDiffRun* pHeader = nullptr;
+    {
+        QMutexLocker locker(&mMutex);
+        if(size > blockSize)
+        {
+            // Too big to share a block, the current one stays open for the next line.
+            mBlocks.push_back(std::make_unique<FineDiffRun[]>(size));
+            pHeader = mBlocks.back().get();
+        }
+        else
+        {
+            if(mCurrentBlock == nullptr || mBlockUsed + size > blockSize)
+            {
+                mBlocks.push_back(std::make_unique<FineDiffRun[]>(blockSize));
+                mCurrentBlock = mBlocks.back().get();
+                mBlockUsed = 0;
+            }
+            pHeader = mCurrentBlock + mBlockUsed;
+            mBlockUsed += size;
+        }
+        mRunCount += size;
+        ++mLineCount;
+    }
+
+    // Nobody else sees this range before it is returned, so filling it needs no lock.
+    pHeader->nofEquals = SafeInt<qint32>(diffList.size());
+    FineDiffRun* pRun = pHeader + 1;
+    for(const Diff& diff: diffList)
+    {
+        pRun->nofEquals = diff.numberOfEquals();
+        pRun->diff1 = SafeInt<qint32>(diff.diff1());
+        pRun->diff2 = SafeInt<qint32>(diff.diff2());
+        ++pRun;
+    }
+
+    return pHeader;
+}
+
+qsizetype FineDiffArena::runCount() const
+{
+    QMutexLocker locker(&mMutex);
+    return mRunCount;
+}
+
+quint64 FineDiffArena::lineCount() const
+{
+    QMutexLocker locker(&mMutex);
+    return mLineCount;
+}
+
+static const FineDiffRun* makeFineDiff(const LineData& line1, const LineData& line2, FineDiffArena& arena)
+{
+    constexpr qint32 maxSearchLength = 500;
+
+    DiffList diffList;
+    diffList.calcDiff(line1, line2, maxSearchLength);
+
+    // Optimize the diff list.
+    diffList.optimize();
+    return arena.add(diffList);
+}
+
+bool Diff3Line::fineDiff(bool inBTextsTotalEqual, const e_SrcSelector selector, const std::shared_ptr<LineDataVector> &v1, const std::shared_ptr<LineDataVector> &v2, const IgnoreFlags eIgnoreFlags,
+                         FineDiffArena& arena, const bool bLazy)
+{
+    LineRef k1 = 0;
+    LineRef k2 = 0;
+    bool bTextsTotalEqual = inBTextsTotalEqual;
+    bool bIgnoreComments = eIgnoreFlags & IgnoreFlag::ignoreComments;
+    bool bIgnoreWhiteSpace = eIgnoreFlags & IgnoreFlag::ignoreWhiteSpace;
+
+    getFineDiffLines(selector, k1, k2);
 
     qCDebug(kdiffCore) << "k1 = " << k1 << ", k2 = " << k2;
     if((!k1.isValid() && k2.isValid()) || (k1.isValid() && !k2.isValid())) bTextsTotalEqual = false;
     if(k1.isValid() && k2.isValid())
     {
-        assert(((unsigned long)k1) <= (*v1).size() && (*v1)[k1].getBuffer() != nullptr);
-        assert(((unsigned long)k2) <= (*v2).size() && (*v2)[k2].getBuffer() != nullptr);
+        assert(((unsigned long)k1) <= (*v1).size() && (*v1)[k1].hasBuffer());
+        assert(((unsigned long)k2) <= (*v2).size() && (*v2)[k2].hasBuffer());
 
-        if((*v1)[k1].size() != (*v2)[k2].size() || QString::compare((*v1)[k1].getLine(), (*v2)[k2].getLine()) != 0)
+        if(!sameText((*v1)[k1], (*v2)[k2]))
         {
             bTextsTotalEqual = false;
-            auto pDiffList = std::make_shared<DiffList>();
-            pDiffList->calcDiff((*v1)[k1].getLine(), (*v2)[k2].getLine(), maxSearchLength);
-
-            // Optimize the diff list.
-            pDiffList->optimize();
-            setFineDiff(selector, pDiffList);
+            setFineDiff(selector, bLazy ? &m_pendingFineDiff : makeFineDiff((*v1)[k1], (*v2)[k2], arena));
         }
         /*
             Override default euality for white lines and comments.
@@ -1498,8 +2203,26 @@ bool Diff3Line::fineDiff(bool inBTextsTotalEqual, const e_SrcSelector selector,
     return bTextsTotalEqual;
 }
 
+FineDiffRange Diff3Line::calcPendingFineDiff(const e_SrcSelector selector, const std::shared_ptr<const LineDataVector>& v1, const std::shared_ptr<const LineDataVector>& v2, FineDiffArena& arena) const
+{
+    const FineDiffRun* pFineDiff = getFineDiff(selector);
+    if(pFineDiff != &m_pendingFineDiff)
+        return FineDiffRange(pFineDiff);
+
+    LineRef k1, k2;
+    getFineDiffLines(selector, k1, k2);
+    assert(v1 != nullptr && v2 != nullptr && k1.isValid() && k2.isValid());
+
+    const FineDiffRun* pNewFineDiff = makeFineDiff((*v1)[k1], (*v2)[k2], arena);
+    // Another thread may have been faster, its result is just as good. The runs added here are simply unused.
+    if(!fineDiffRef(selector).testAndSetOrdered(&m_pendingFineDiff, pNewFineDiff, pFineDiff))
+        return FineDiffRange(pFineDiff);
+
+    return FineDiffRange(pNewFineDiff);
+}
+
 void Diff3Line::getLineInfo(const e_SrcSelector winIdx, const bool isTriple, LineRef& lineIdx,
-                            std::shared_ptr<const DiffList>& pFineDiff1, std::shared_ptr<const DiffList>& pFineDiff2, // return values
+                            FineDiffRange& fineDiff1, FineDiffRange& fineDiff2, // return values
                             ChangeFlags& changed, ChangeFlags& changed2) const
 {
     changed = NoChange;
@@ -1509,11 +2232,19 @@ void Diff3Line::getLineInfo(const e_SrcSelector winIdx, const bool isTriple, Lin
     bool bBEqualC = this->isEqualBC() || (bWhiteLineB && bWhiteLineC);
 
     assert(winIdx >= e_SrcSelector::A && winIdx <= e_SrcSelector::C);
+    const auto fineDiffOf = [this](const e_SrcSelector selector) {
+        if(getFineDiff(selector) != &m_pendingFineDiff)
+            return FineDiffRange(getFineDiff(selector));
+
+        assert(m_pDiffBufferInfo->getFineDiffArena() != nullptr);
+        return calcPendingFineDiff(selector, m_pDiffBufferInfo->getFineDiffData(selector, 0), m_pDiffBufferInfo->getFineDiffData(selector, 1), *m_pDiffBufferInfo->getFineDiffArena());
+    };
+
     if(winIdx == e_SrcSelector::A)
     {
         lineIdx = getLineA();
-        pFineDiff1 = pFineAB;
-        pFineDiff2 = pFineCA;
+        fineDiff1 = fineDiffOf(e_SrcSelector::A);
+        fineDiff2 = fineDiffOf(e_SrcSelector::C);
 
         changed = ((!getLineB().isValid()) != (!lineIdx.isValid()) ? AChanged : NoChange) |
                    ((!getLineC().isValid()) != (!lineIdx.isValid()) && isTriple ? BChanged : NoChange);
@@ -1522,8 +2253,8 @@ void Diff3Line::getLineInfo(const e_SrcSelector winIdx, const bool isTriple, Lin
     else if(winIdx == e_SrcSelector::B)
     {
         lineIdx = getLineB();
-        pFineDiff1 = pFineBC;
-        pFineDiff2 = pFineAB;
+        fineDiff1 = fineDiffOf(e_SrcSelector::B);
+        fineDiff2 = fineDiffOf(e_SrcSelector::A);
         changed = ((!getLineC().isValid()) != (!lineIdx.isValid()) && isTriple ? AChanged : NoChange) |
                    ((!getLineA().isValid()) != (!lineIdx.isValid()) ? BChanged : NoChange);
         changed2 = (bBEqualC || !isTriple ? NoChange : AChanged) | (bAEqualB ? NoChange : BChanged);
@@ -1531,8 +2262,8 @@ void Diff3Line::getLineInfo(const e_SrcSelector winIdx, const bool isTriple, Lin
     else if(winIdx == e_SrcSelector::C)
     {
         lineIdx = getLineC();
-        pFineDiff1 = pFineCA;
-        pFineDiff2 = pFineBC;
+        fineDiff1 = fineDiffOf(e_SrcSelector::C);
+        fineDiff2 = fineDiffOf(e_SrcSelector::B);
         changed = ((!getLineA().isValid()) != (!lineIdx.isValid()) ? AChanged : NoChange) |
                    ((!getLineB().isValid()) != (!lineIdx.isValid()) ? BChanged : NoChange);
         changed2 = (bAEqualC ? NoChange : AChanged) | (bBEqualC ? NoChange : BChanged);
@@ -1542,30 +2273,284 @@ void Diff3Line::getLineInfo(const e_SrcSelector winIdx, const bool isTriple, Lin
 bool Diff3LineList::fineDiff(const e_SrcSelector selector, const std::shared_ptr<LineDataVector> &v1, const std::shared_ptr<LineDataVector> &v2, const IgnoreFlags eIgnoreFlags)
 {
     // Finetuning: Diff each line with deltas
+    Diff3LineVector d3lv;
+    calcDiff3LineVector(d3lv);
+    return fineDiff(d3lv, selector, v1, v2, eIgnoreFlags);
+}
+
+bool Diff3LineList::fineDiff(const Diff3LineVector& d3lv, const e_SrcSelector selector, const std::shared_ptr<LineDataVector>& v1, const std::shared_ptr<LineDataVector>& v2, const IgnoreFlags eIgnoreFlags)
+{
+    if(mFineDiffArena == nullptr)
+        mFineDiffArena = std::make_shared<FineDiffArena>();
+
+    // Pending fine diffs are calculated from this data later on.
+    Diff3Line::m_pDiffBufferInfo->setFineDiffData(selector, v1, v2);
+    Diff3Line::m_pDiffBufferInfo->setFineDiffArena(mFineDiffArena);
+
+    return calcFineDiffs(d3lv, selector, v1, v2, eIgnoreFlags, gOptions->mLazyFineDiff);
+}
+
+bool Diff3LineList::fineDiffForStatus(const Diff3LineVector& d3lv, const e_SrcSelector selector, const std::shared_ptr<LineDataVector>& v1, const std::shared_ptr<LineDataVector>& v2, const IgnoreFlags eIgnoreFlags)
+{
+    // Lazy mode makes no runs at all, the arena is only there to satisfy Diff3Line::fineDiff.
+    if(mFineDiffArena == nullptr)
+        mFineDiffArena = std::make_shared<FineDiffArena>();
+
+    return calcFineDiffs(d3lv, selector, v1, v2, eIgnoreFlags, true);
+}
+
+/*
+    Each Diff3Line only touches its own line pair so the lines are handed out to the thread pool in chunks.
+    Chunks are small enough that a few very long lines don't leave the other threads idle.
+*/
+bool Diff3LineList::calcFineDiffs(const Diff3LineVector& d3lv, const e_SrcSelector selector, const std::shared_ptr<LineDataVector>& v1, const std::shared_ptr<LineDataVector>& v2,
+                                  const IgnoreFlags eIgnoreFlags, const bool bLazy)
+{
+    constexpr qsizetype chunkSize = 256;
+
     ProgressScope pp;
-    bool bTextsTotalEqual = true;
-    size_t listSize = size();
-    ProgressProxy::setMaxNofSteps(listSize);
+    const qsizetype lineCount = SafeInt<qsizetype>(d3lv.size());
+    const qsizetype chunkCount = (lineCount + chunkSize - 1) / chunkSize;
+    ProgressProxy::setMaxNofSteps(chunkCount);
+
+    std::atomic<bool> bTextsTotalEqual = true;
+    std::atomic<quint64> fineDiffs = 0;
+    Parallel::forEach(chunkCount, [&](const qsizetype chunk) {
+        if(ProgressProxy::wasCancelled())
+            return;
+
+        const qsizetype end = std::min(lineCount, (chunk + 1) * chunkSize);
+        bool bChunkEqual = true;
+        quint64 chunkFineDiffs = 0;
+        for(qsizetype i = chunk * chunkSize; i < end; ++i)
+        {
+            // Arena addresses are never reused.
+            const FineDiffRun* pOldFineDiff = d3lv[i]->getFineDiff(selector);
+            bChunkEqual = d3lv[i]->fineDiff(bChunkEqual, selector, v1, v2, eIgnoreFlags, *mFineDiffArena, bLazy);
 
-    for(Diff3Line &diff: *this)
+            const FineDiffRun* pFineDiff = d3lv[i]->getFineDiff(selector);
+            if(pFineDiff != nullptr && (pFineDiff != pOldFineDiff || pFineDiff == &Diff3Line::m_pendingFineDiff))
+                ++chunkFineDiffs;
+        }
+
+        if(!bChunkEqual)
+            bTextsTotalEqual.store(false, std::memory_order_relaxed);
+        fineDiffs.fetch_add(chunkFineDiffs, std::memory_order_relaxed);
+    });
+
+    mScheduledFineDiffCount += fineDiffs.load();
+    return bTextsTotalEqual.load();
+}
+
+struct Diff3LineList::FineDiffFill {
+    Diff3LineVector d3lv;
+    std::shared_ptr<const LineDataVector> fineDiffData[3][2];
+    std::shared_ptr<FineDiffArena> arena;
+
+    QAtomicInteger<qsizetype> next = 0;
+    // Guards running and setting bStop so no task can start working after stopFineDiffFill returned.
+    QMutex mutex;
+    QWaitCondition finished;
+    qint32 running = 0;
+    std::atomic<bool> bStop = false;
+};
+
+/*
+    The fill gets a pool of its own so it never takes the threads Parallel::forEach and the folder comparison
+    are waiting for. Half the cores are enough for work that only saves time when lines get painted later.
+*/
+static QThreadPool& fineDiffFillPool()
+{
+    static QThreadPool pool;
+    static const bool bInitialized = [] {
+        pool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() / 2));
+        return true;
+    }();
+    Q_UNUSED(bInitialized);
+    return pool;
+}
+
+void Diff3LineList::startFineDiffFill(const Diff3LineVector& d3lv)
+{
+    constexpr qsizetype chunkSize = 64;
+
+    stopFineDiffFill();
+    if(!gOptions->mLazyFineDiff || d3lv.empty() || mFineDiffArena == nullptr)
+        return;
+
+    std::shared_ptr<FineDiffFill> pFill = std::make_shared<FineDiffFill>();
+    pFill->d3lv = d3lv;
+    pFill->arena = mFineDiffArena;
+    for(const e_SrcSelector selector: {e_SrcSelector::A, e_SrcSelector::B, e_SrcSelector::C})
     {
-        bTextsTotalEqual = diff.fineDiff(bTextsTotalEqual, selector, v1, v2, eIgnoreFlags);
-        ProgressProxy::step();
+        for(qint32 side = 0; side < 2; ++side)
+            pFill->fineDiffData[(qint32)selector - (qint32)e_SrcSelector::A][side] = Diff3Line::m_pDiffBufferInfo->getFineDiffData(selector, side);
     }
-    return bTextsTotalEqual;
+    mFineDiffFill = pFill;
+
+    auto work = [pFill]() {
+        {
+            QMutexLocker locker(&pFill->mutex);
+            if(pFill->bStop)
+                return;
+            ++pFill->running;
+        }
+
+        // Checked for every line pair, stopFineDiffFill waits for the pair being diffed right now.
+        const auto bStopped = [&pFill]() { return pFill->bStop.load(std::memory_order_relaxed); };
+        const qsizetype lineCount = SafeInt<qsizetype>(pFill->d3lv.size());
+        for(qsizetype begin = pFill->next.fetchAndAddRelaxed(chunkSize); begin < lineCount && !bStopped(); begin = pFill->next.fetchAndAddRelaxed(chunkSize))
+        {
+            const qsizetype end = std::min(lineCount, begin + chunkSize);
+            for(qsizetype i = begin; i < end && !bStopped(); ++i)
+            {
+                for(const e_SrcSelector selector: {e_SrcSelector::A, e_SrcSelector::B, e_SrcSelector::C})
+                {
+                    const std::shared_ptr<const LineDataVector>(&data)[2] = pFill->fineDiffData[(qint32)selector - (qint32)e_SrcSelector::A];
+                    if(data[0] != nullptr && data[1] != nullptr && !bStopped())
+                        pFill->d3lv[i]->calcPendingFineDiff(selector, data[0], data[1], *pFill->arena);
+                }
+            }
+        }
+
+        QMutexLocker locker(&pFill->mutex);
+        if(--pFill->running == 0)
+            pFill->finished.wakeAll();
+    };
+
+    QThreadPool& pool = fineDiffFillPool();
+    for(qint32 i = 0; i < pool.maxThreadCount(); ++i)
+        pool.start(work);
+}
+
+void Diff3LineList::clear()
+{
+    stopFineDiffFill();
+    mLines.clear();
+    mNext.clear();
+    mPrev.clear();
+    mFirst = mLast = npos;
+
+    if(Diff3Line::m_pDiffBufferInfo->getFineDiffArena() == mFineDiffArena)
+    {
+        Diff3Line::m_pDiffBufferInfo->setFineDiffArena(nullptr);
+        Diff3Line::m_pDiffBufferInfo->clearFineDiffData();
+    }
+    mFineDiffArena.reset();
+}
+
+void Diff3LineList::stopFineDiffFill() const
+{
+    if(mFineDiffFill == nullptr)
+        return;
+
+    QMutexLocker locker(&mFineDiffFill->mutex);
+    mFineDiffFill->bStop = true;
+    while(mFineDiffFill->running > 0)
+        mFineDiffFill->finished.wait(&mFineDiffFill->mutex);
+
+    locker.unlock();
+    mFineDiffFill.reset();
+}
+
+quint64 Diff3LineList::numberOfFineDiffs() const
+{
+    quint64 count = 0;
+    for(const Diff3Line& d3l: *this)
+        count += (d3l.hasFineDiffAB() ? 1 : 0) + (d3l.hasFineDiffBC() ? 1 : 0) + (d3l.hasFineDiffCA() ? 1 : 0);
+
+    return count;
+}
+
+void Diff3LineList::push_back(const Diff3Line& d3l)
+{
+    if(mNext.empty())
+        mLines.push_back(d3l);
+    else
+        insert(end(), d3l);
+}
+
+Diff3LineList::iterator Diff3LineList::insert(const_iterator pos, const Diff3Line& d3l)
+{
+    assert(pos.mList == this);
+    if(pos.mIdx == npos && mNext.empty())
+    {
+        mLines.push_back(d3l);
+        return iterator(this, (qsizetype)mLines.size() - 1);
+    }
+
+    if(mNext.empty())
+        link();
+
+    const qsizetype idx = mLines.size();
+    const qsizetype prev = pos.mIdx == npos ? mLast : mPrev[pos.mIdx];
+    mLines.push_back(d3l);
+    mNext.push_back(pos.mIdx);
+    mPrev.push_back(prev);
+
+    if(prev == npos)
+        mFirst = idx;
+    else
+        mNext[prev] = idx;
+
+    if(pos.mIdx == npos)
+        mLast = idx;
+    else
+        mPrev[pos.mIdx] = idx;
+
+    return iterator(this, idx);
+}
+
+void Diff3LineList::remove(const Diff3Line& d3l)
+{
+    // d3l may be one of our own lines.
+    const Diff3Line value = d3l;
+    unlink();
+    mLines.erase(std::remove(mLines.begin(), mLines.end(), value), mLines.end());
+}
+
+void Diff3LineList::link()
+{
+    assert(mNext.empty());
+    const qsizetype count = mLines.size();
+
+    mNext.resize(count);
+    mPrev.resize(count);
+    for(qsizetype i = 0; i < count; ++i)
+    {
+        mNext[i] = i + 1 < count ? i + 1 : npos;
+        mPrev[i] = i - 1;
+    }
+    mFirst = count > 0 ? 0 : npos;
+    mLast = count - 1;
+}
+
+void Diff3LineList::unlink()
+{
+    if(mNext.empty())
+        return;
+
+    std::vector<Diff3Line> lines;
+    lines.reserve(mLines.size());
+    for(qsizetype i = mFirst; i != npos; i = mNext[i])
+        lines.push_back(mLines[i]);
+    assert(lines.size() == mLines.size());
+
+    mLines = std::move(lines);
+    mNext.clear();
+    mPrev.clear();
+    mFirst = mLast = npos;
 }
 
 // Convert the list to a vector of pointers
 void Diff3LineList::calcDiff3LineVector(Diff3LineVector& d3lv)
 {
+    // Lines handed out here must not move anymore, the vector is in list order from now on.
+    unlink();
+
     d3lv.resize(size());
-    Diff3LineList::iterator i;
-    size_t j = 0;
-    for(i = begin(); i != end(); ++i, ++j)
-    {
-        d3lv[j] = &(*i);
-    }
-    assert(j == d3lv.size());
+    for(size_t j = 0; j < mLines.size(); ++j)
+        d3lv[j] = &mLines[j];
 }
 
 // Just make sure that all input lines are in the output too, exactly once.
@@ -16,11 +16,22 @@
 #include "Logging.h"
 #include "TypeUtils.h"
 
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
 #include <list>
+#include <map>
 #include <memory>
 #include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <QAtomicPointer>
+#include <QByteArray>
+#include <QDeadlineTimer>
+#include <QMutex>
 #include <QString>
 #include <QStringList>
 
@@ -28,7 +39,7 @@ class LineData;
 
 class Options;
 
-using LineDataVector=std::vector<LineData>;
+class LineDataVector;
 
 //e_SrcSelector must be sequential integers with no gaps between Min and Max.
 enum class e_SrcSelector
@@ -147,19 +158,129 @@ class DiffList: public std::list<Diff>
   public:
     using std::list<Diff>::list;
     void calcDiff(const QString& line1, const QString& line2, const qint32 maxSearchRange);
+    void calcDiff(const LineData& line1, const LineData& line2, const qint32 maxSearchRange);
+    // Uses the algorithm selected in the options.
     void runDiff(const std::shared_ptr<const LineDataVector>& p1, const size_t index1, LineRef size1, const std::shared_ptr<const LineDataVector>& p2, const size_t index2, LineRef size2);
+    // Same as runDiff with GnuDiff but without progress. Both ranges must hold text and the list must be empty.
+    void runGnuDiff(const std::shared_ptr<const LineDataVector>& p1, const size_t index1, LineRef size1, const std::shared_ptr<const LineDataVector>& p2, const size_t index2, LineRef size2);
 #ifndef NDEBUG
     void verify(const LineRef size1, const LineRef size2);
 #endif
     void optimize();
+
+    // True if the fast mode for large files was used for any part of this list, it might not be minimal then.
+    [[nodiscard]] bool usedFastMode() const { return mbFastMode; }
+    void setUsedFastMode(const bool bFastMode) { mbFastMode = bFastMode; }
+
+  private:
+    // Middle parts of at least this many lines on both sides together are split at unique lines.
+    static constexpr LineType anchoredDiffMinLines = 100000;
+    // Lines of the first file per part at least.
+    static constexpr LineType anchoredDiffPartLines = 16384;
+
+    bool mbFastMode = false;
+
+    // Runs the selected algorithm on the range. Either side may be empty.
+    void runLineMatching(const std::shared_ptr<const LineDataVector>& p1, const size_t index1, LineRef size1, const std::shared_ptr<const LineDataVector>& p2, const size_t index2, LineRef size2);
+    /*
+        Splits the range at lines that occur exactly once on both sides and are kept in order (patience anchors)
+        and runs the parts in parallel. Returns false without touching the list if there are too few anchors.
+    */
+    bool runAnchoredDiff(const std::shared_ptr<const LineDataVector>& p1, const size_t index1, LineRef size1, const std::shared_ptr<const LineDataVector>& p2, const size_t index2, LineRef size2);
+    // Appends equal lines or changes, merging with the last entry where the format allows.
+    void appendEquals(const LineType count);
+    void appendChange(const quint64 count1, const quint64 count2);
+
+    /*
+        Time for each of the exact and the heuristic character diff of one line pair. The rest of a line is
+        one change if the heuristic runs out as well.
+    */
+    static constexpr qint64 fineDiffTimeBudget = 100; // ms
+    // The exact character diff gives up after this many inserted or removed characters.
+    static constexpr qint32 maxMyersDifferences = 1000;
+
+    template <typename Char1, typename Char2>
+    void calcDiffRange(const Char1* const begin1, const Char1* const p1end, const Char2* const begin2, const Char2* const p2end, const qint32 maxSearchRange);
+    // Returns false and leaves the list empty if the limits are hit, see calcDiffRange.
+    template <typename Char1, typename Char2>
+    bool calcMyersDiff(const Char1* const begin1, const Char1* const p1end, const Char2* const begin2, const Char2* const p2end, const QDeadlineTimer& deadline);
+};
+
+// Packed form of a Diff as stored in a FineDiffArena. Counts are characters within one line.
+struct FineDiffRun
+{
+    qint32 nofEquals = 0;
+    qint32 diff1 = 0;
+    qint32 diff2 = 0;
+
+    bool operator==(const FineDiffRun& b) const { return nofEquals == b.nofEquals && diff1 == b.diff1 && diff2 == b.diff2; }
+};
+
+/*
+    The character differences of one line pair. This is only a view into a FineDiffArena, which stores a header
+    run holding the number of runs in nofEquals followed by the runs themselves.
+*/
+class FineDiffRange
+{
+  private:
+    const FineDiffRun* mBegin = nullptr;
+    const FineDiffRun* mEnd = nullptr;
+
+  public:
+    FineDiffRange() = default;
+    explicit FineDiffRange(const FineDiffRun* pHeader)
+    {
+        if(pHeader != nullptr)
+        {
+            mBegin = pHeader + 1;
+            mEnd = mBegin + pHeader->nofEquals;
+        }
+    }
+
+    // True if the lines are equal or one of them doesn't exist.
+    [[nodiscard]] bool isNull() const { return mBegin == nullptr; }
+
+    [[nodiscard]] const FineDiffRun* begin() const { return mBegin; }
+    [[nodiscard]] const FineDiffRun* end() const { return mEnd; }
+    [[nodiscard]] qsizetype size() const { return mEnd - mBegin; }
+
+    bool operator==(const FineDiffRange& b) const { return isNull() == b.isNull() && std::equal(begin(), end(), b.begin(), b.end()); }
+};
+
+/*
+    Flat storage for the fine diffs of a Diff3LineList. Replaces a std::list node per Diff plus a shared_ptr per
+    line pair. Runs are appended to large blocks that are never moved or freed before the arena itself, so
+    ranges stay valid while other threads keep adding.
+*/
+class FineDiffArena
+{
+  public:
+    // Copies diffList into the arena and returns its header run. Thread safe.
+    [[nodiscard]] const FineDiffRun* add(const DiffList& diffList);
+    // Number of runs stored including headers.
+    [[nodiscard]] qsizetype runCount() const;
+    // Number of diff lists added, one per line pair DiffList::calcDiff ran on.
+    [[nodiscard]] quint64 lineCount() const;
+
+  private:
+    static constexpr qsizetype blockSize = 16 * 1024;
+
+    mutable QMutex mMutex;
+    std::vector<std::unique_ptr<FineDiffRun[]>> mBlocks;
+    FineDiffRun* mCurrentBlock = nullptr;
+    qsizetype mBlockUsed = 0;
+    qsizetype mRunCount = 0;
+    quint64 mLineCount = 0;
 };
 
 class LineData
 {
   private:
     std::shared_ptr<QString> mBuffer;
+    // Used instead of mBuffer when the whole file fits into Latin-1, see SourceData::FileData::preprocess.
+    std::shared_ptr<QByteArray> mLatin1Buffer;
     qsizetype mFirstNonWhiteChar = 0;
-    //This tracks the offset with-in our unicode buffer not the file offset
+    //This tracks the offset with-in our unicode or latin1 buffer not the file offset
     qsizetype mOffset = 0;
     qsizetype mSize = 0;
     bool bContainsPureComment = false;
@@ -181,14 +302,34 @@ class LineData
         bSkipable = inIsSkipable;
         mFirstNonWhiteChar = inFirstNonWhiteChar;
     }
+
+    LineData(const std::shared_ptr<QByteArray>& latin1Buffer, const qsizetype inOffset, qsizetype inSize = 0, qsizetype inFirstNonWhiteChar = 0, bool inIsSkipable = false, const bool inIsPureComment = false)
+    {
+        mLatin1Buffer = latin1Buffer;
+        mOffset = inOffset;
+        mSize = inSize;
+        bContainsPureComment = inIsPureComment;
+        bSkipable = inIsSkipable;
+        mFirstNonWhiteChar = inFirstNonWhiteChar;
+    }
     [[nodiscard]] qsizetype size() const { return mSize; }
     [[nodiscard]] qsizetype getFirstNonWhiteChar() const { return mFirstNonWhiteChar; }
 
     /*
         QString::fromRawData allows us to create a light weight QString backed by the buffer memory.
+        Latin-1 lines are widened on each call, the diff code uses unicodeData()/latin1Data() instead.
     */
-    [[nodiscard]] const QString getLine() const { return QString::fromRawData(mBuffer->data() + mOffset, mSize); }
-    [[nodiscard]] const std::shared_ptr<QString>& getBuffer() const { return mBuffer; }
+    [[nodiscard]] const QString getLine() const
+    {
+        if(mLatin1Buffer != nullptr)
+            return QString::fromLatin1(latin1Data(), mSize);
+        return QString::fromRawData(mBuffer->data() + mOffset, mSize);
+    }
+    [[nodiscard]] bool hasBuffer() const { return mBuffer != nullptr || mLatin1Buffer != nullptr; }
+    [[nodiscard]] bool isLatin1() const { return mLatin1Buffer != nullptr; }
+    // Only valid for the matching storage type, see isLatin1().
+    [[nodiscard]] const QChar* unicodeData() const { return mBuffer->constData() + mOffset; }
+    [[nodiscard]] const char* latin1Data() const { return mLatin1Buffer->constData() + mOffset; }
 
     [[nodiscard]] qsizetype getOffset() const { return mOffset; }
     [[nodiscard]] qint32 width(qint32 tabSize) const; // Calcs width considering tabs.
@@ -204,6 +345,90 @@ class LineData
     [[nodiscard]] static bool equal(const LineData& l1, const LineData& l2);
 };
 
+// Options a line hash depends on, see LineDataVector::lineHashes.
+struct LineHashOptions
+{
+    bool bIgnoreWhiteSpace = true;
+    bool bIgnoreNumbers = false;
+    bool bIgnoreCase = false;
+
+    bool operator==(const LineHashOptions& b) const { return bIgnoreWhiteSpace == b.bIgnoreWhiteSpace && bIgnoreNumbers == b.bIgnoreNumbers && bIgnoreCase == b.bIgnoreCase; }
+};
+
+/*
+    The lines of one input. Also keeps the line hashes used by the line matching, so a file that takes part in
+    several comparisons is only hashed once per load.
+*/
+class LineDataVector: public std::vector<LineData>
+{
+  public:
+    using std::vector<LineData>::vector;
+
+    LineDataVector() = default;
+    LineDataVector(const LineDataVector& other): std::vector<LineData>(other) {}
+    LineDataVector& operator=(const LineDataVector& other)
+    {
+        std::vector<LineData>::operator=(other);
+        dropLineHashes();
+        return *this;
+    }
+    // Moves keep the hashes, they still belong to the moved lines.
+    LineDataVector(LineDataVector&& other) noexcept: std::vector<LineData>(std::move(other))
+    {
+        QMutexLocker locker(&other.mHashMutex);
+        mLineHashes = std::move(other.mLineHashes);
+        other.mLineHashes.clear();
+    }
+    LineDataVector& operator=(LineDataVector&& other) noexcept
+    {
+        if(this == &other)
+            return *this;
+
+        std::vector<LineData>::operator=(std::move(other));
+        std::vector<LineHashes> lineHashes;
+        {
+            QMutexLocker locker(&other.mHashMutex);
+            lineHashes = std::move(other.mLineHashes);
+            other.mLineHashes.clear();
+        }
+        QMutexLocker locker(&mHashMutex);
+        mLineHashes = std::move(lineHashes);
+        return *this;
+    }
+
+    void clear()
+    {
+        std::vector<LineData>::clear();
+        dropLineHashes();
+    }
+
+    /*
+        Hashes of the lines, equal if GnuDiff considers the lines equal with these options. Indexed like the lines
+        but only valid in [first, first + count). Calculated on first use in blocks of lines and kept until the
+        lines are cleared. Safe to call from several threads.
+    */
+    [[nodiscard]] std::shared_ptr<const std::vector<size_t>> lineHashes(const LineHashOptions& options, const size_t first, const size_t count) const;
+    [[nodiscard]] std::shared_ptr<const std::vector<size_t>> lineHashes(const LineHashOptions& options) const { return lineHashes(options, 0, size()); }
+
+  private:
+    static constexpr size_t hashBlockSize = 4096;
+
+    struct LineHashes {
+        LineHashOptions options;
+        std::shared_ptr<std::vector<size_t>> hashes;
+        std::vector<bool> blockDone;
+    };
+
+    void dropLineHashes()
+    {
+        QMutexLocker locker(&mHashMutex);
+        mLineHashes.clear();
+    }
+
+    mutable QMutex mHashMutex;
+    mutable std::vector<LineHashes> mLineHashes;
+};
+
 class ManualDiffHelpList; // A list of corresponding ranges
 
 class Diff3Line;
@@ -218,11 +443,27 @@ class DiffBufferInfo
     std::shared_ptr<const LineDataVector> mLineDataB;
     std::shared_ptr<const LineDataVector> mLineDataC;
     const Diff3LineList* m_pDiff3LineList = nullptr;
+    // Text the fine diffs A/B, B/C and C/A are calculated on. Set by Diff3LineList::fineDiff for lazy evaluation.
+    std::shared_ptr<const LineDataVector> mFineDiffData[3][2];
+    std::shared_ptr<FineDiffArena> mFineDiffArena;
 
   public:
     void init(Diff3LineList* d3ll,
               const std::shared_ptr<const LineDataVector>& pldA, const std::shared_ptr<const LineDataVector>& pldB, const std::shared_ptr<const LineDataVector>& pldC);
 
+    void setFineDiffData(const e_SrcSelector selector, const std::shared_ptr<const LineDataVector>& v1, const std::shared_ptr<const LineDataVector>& v2);
+    // Drops the text of all three pairs, only the pairs in use are set again by the next analysis.
+    void clearFineDiffData();
+    [[nodiscard]] const std::shared_ptr<const LineDataVector>& getFineDiffData(const e_SrcSelector selector, const qint32 side) const
+    {
+        assert(selector == e_SrcSelector::A || selector == e_SrcSelector::B || selector == e_SrcSelector::C);
+        assert(side == 0 || side == 1);
+        return mFineDiffData[(qint32)selector - (qint32)e_SrcSelector::A][side];
+    }
+
+    void setFineDiffArena(const std::shared_ptr<FineDiffArena>& pArena) { mFineDiffArena = pArena; }
+    [[nodiscard]] const std::shared_ptr<FineDiffArena>& getFineDiffArena() const { return mFineDiffArena; }
+
     [[nodiscard]] std::shared_ptr<const LineDataVector> getLineData(e_SrcSelector srcIndex) const
     {
         switch(srcIndex)
@@ -265,18 +506,26 @@ class Diff3Line
     bool bWhiteLineB = false;
     bool bWhiteLineC = false;
 
-    std::shared_ptr<const DiffList> pFineAB; // These are NULL only if completely equal or if either source doesn't exist.
-    std::shared_ptr<const DiffList> pFineBC;
-    std::shared_ptr<const DiffList> pFineCA;
+    /*
+        Header runs in the FineDiffArena of the owning list. These are NULL only if completely equal or if either
+        source doesn't exist. In lazy mode they point to m_pendingFineDiff until first needed, the background fill
+        may replace them at any time.
+    */
+    mutable QAtomicPointer<const FineDiffRun> pFineAB;
+    mutable QAtomicPointer<const FineDiffRun> pFineBC;
+    mutable QAtomicPointer<const FineDiffRun> pFineCA;
+
+    // Placeholder for a fine diff that has not been calculated yet.
+    inline static constexpr FineDiffRun m_pendingFineDiff{};
 
     qint32 mLinesNeededForDisplay = 1;    // Due to wordwrap
     qint32 mSumLinesNeededForDisplay = 0; // For fast conversion to m_diff3WrapLineVector
   public:
     inline static std::shared_ptr<DiffBufferInfo> m_pDiffBufferInfo = std::make_shared<DiffBufferInfo>(); // Needed by this class and only this but inited from KDiff3App::mainInit
 
-    [[nodiscard]] bool hasFineDiffAB() const { return pFineAB != nullptr; }
-    [[nodiscard]] bool hasFineDiffBC() const { return pFineBC != nullptr; }
-    [[nodiscard]] bool hasFineDiffCA() const { return pFineCA != nullptr; }
+    [[nodiscard]] bool hasFineDiffAB() const { return getFineDiff(e_SrcSelector::A) != nullptr; }
+    [[nodiscard]] bool hasFineDiffBC() const { return getFineDiff(e_SrcSelector::B) != nullptr; }
+    [[nodiscard]] bool hasFineDiffCA() const { return getFineDiff(e_SrcSelector::C) != nullptr; }
 
     [[nodiscard]] LineType getLineIndex(e_SrcSelector src) const
     {
@@ -359,9 +608,13 @@ class Diff3Line
     [[nodiscard]] qint32 linesNeededForDisplay() const { return mLinesNeededForDisplay; }
 
     void setLinesNeeded(const qint32 lines) { mLinesNeededForDisplay = lines; }
-    [[nodiscard]] bool fineDiff(bool bTextsTotalEqual, const e_SrcSelector selector, const std::shared_ptr<LineDataVector>& v1, const std::shared_ptr<LineDataVector>& v2, const IgnoreFlags eIgnoreFlags);
+    // With bLazy set only the equality is checked here, the fine diff itself is left for calcPendingFineDiff.
+    [[nodiscard]] bool fineDiff(bool bTextsTotalEqual, const e_SrcSelector selector, const std::shared_ptr<LineDataVector>& v1, const std::shared_ptr<LineDataVector>& v2, const IgnoreFlags eIgnoreFlags,
+                                FineDiffArena& arena, const bool bLazy = false);
+    // Calculates the fine diff of the pair if it is still pending. May be called from several threads at once.
+    FineDiffRange calcPendingFineDiff(const e_SrcSelector selector, const std::shared_ptr<const LineDataVector>& v1, const std::shared_ptr<const LineDataVector>& v2, FineDiffArena& arena) const;
     void getLineInfo(const e_SrcSelector winIdx, const bool isTriple, LineRef& lineIdx,
-                     std::shared_ptr<const DiffList>& pFineDiff1, std::shared_ptr<const DiffList>& pFineDiff2, // return values
+                     FineDiffRange& fineDiff1, FineDiffRange& fineDiff2, // return values
                      ChangeFlags& changed, ChangeFlags& changed2) const;
 
   private:
@@ -377,34 +630,198 @@ class Diff3Line
         return {};
     }
 
-    void setFineDiff(const e_SrcSelector selector, const std::shared_ptr<DiffList>& pDiffList)
+    [[nodiscard]] QAtomicPointer<const FineDiffRun>& fineDiffRef(const e_SrcSelector selector) const
     {
         assert(selector == e_SrcSelector::A || selector == e_SrcSelector::B || selector == e_SrcSelector::C);
         if(selector == e_SrcSelector::A)
-        {
-            pFineAB = pDiffList;
-        }
+            return pFineAB;
         else if(selector == e_SrcSelector::B)
-        {
-            pFineBC = pDiffList;
-        }
-        else if(selector == e_SrcSelector::C)
-        {
-            pFineCA = pDiffList;
-        }
+            return pFineBC;
+
+        return pFineCA;
     }
+
+    // May return &m_pendingFineDiff.
+    [[nodiscard]] const FineDiffRun* getFineDiff(const e_SrcSelector selector) const { return fineDiffRef(selector).loadAcquire(); }
+
+    void setFineDiff(const e_SrcSelector selector, const FineDiffRun* pFineDiff) { fineDiffRef(selector).storeRelease(pFineDiff); }
+
+    void getFineDiffLines(const e_SrcSelector selector, LineRef& k1, LineRef& k2) const;
 };
 
 struct HistoryRange;
 
-class Diff3LineList: public std::list<Diff3Line>
+/*
+    Diff3Lines are kept in one vector so full passes walk contiguous memory. Iterators hold an index into it.
+    calcDiff3LineListUsingAC, calcDiff3LineListUsingBC and correctManualDiffAlignment insert lines in the middle while
+    they walk the list. Such lines are appended to the vector and linked in by index, so iterators stay valid just as
+    they did for std::list. remove() and calcDiff3LineVector() put the vector back in list order and drop the links.
+    Pointers to lines stay valid until the next insert or push_back.
+*/
+class Diff3LineList
 {
   public:
-    using std::list<Diff3Line>::list;
+    template <bool bConst>
+    class Iterator
+    {
+      public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = Diff3Line;
+        using difference_type = qsizetype;
+        using pointer = std::conditional_t<bConst, const Diff3Line*, Diff3Line*>;
+        using reference = std::conditional_t<bConst, const Diff3Line&, Diff3Line&>;
+
+        Iterator() = default;
+        // iterator converts to const_iterator.
+        template <bool bOther, typename = std::enable_if_t<bConst && !bOther>>
+        Iterator(const Iterator<bOther>& other): mList(other.mList), mIdx(other.mIdx) {}
+
+        reference operator*() const
+        {
+            assert(mList != nullptr && mIdx != npos);
+            return mList->mLines[mIdx];
+        }
+        pointer operator->() const { return &**this; }
+
+        Iterator& operator++()
+        {
+            mIdx = mList->nextIndex(mIdx);
+            return *this;
+        }
+        Iterator operator++(int)
+        {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+        Iterator& operator--()
+        {
+            mIdx = mList->prevIndex(mIdx);
+            return *this;
+        }
+        Iterator operator--(int)
+        {
+            Iterator old = *this;
+            --*this;
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const { return mIdx == other.mIdx && mList == other.mList; }
+        bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+      private:
+        friend class Diff3LineList;
+        friend class Iterator<!bConst>;
+        using List = std::conditional_t<bConst, const Diff3LineList, Diff3LineList>;
+
+        Iterator(List* pList, const qsizetype idx): mList(pList), mIdx(idx) {}
+
+        List* mList = nullptr;
+        qsizetype mIdx = npos;
+    };
+
+    using value_type = Diff3Line;
+    using size_type = std::vector<Diff3Line>::size_type;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    /*
+        A running background fill stays with the lines it was started for. Copying stops the fill of the source
+        first, its tasks write to the lines being copied. Pending fine diffs are then calculated on demand.
+    */
+    Diff3LineList() = default;
+    Diff3LineList(std::initializer_list<Diff3Line> lines): mLines(lines) {}
+    Diff3LineList(const Diff3LineList& other) { *this = other; }
+    Diff3LineList(Diff3LineList&& other) = default;
+    Diff3LineList& operator=(const Diff3LineList& other)
+    {
+        stopFineDiffFill();
+        other.stopFineDiffFill();
+        mLines = other.mLines;
+        mNext = other.mNext;
+        mPrev = other.mPrev;
+        mFirst = other.mFirst;
+        mLast = other.mLast;
+        mScheduledFineDiffCount = other.mScheduledFineDiffCount;
+        mFineDiffArena = other.mFineDiffArena;
+        return *this;
+    }
+    Diff3LineList& operator=(Diff3LineList&& other)
+    {
+        stopFineDiffFill();
+        mLines = std::move(other.mLines);
+        mNext = std::move(other.mNext);
+        mPrev = std::move(other.mPrev);
+        mFirst = other.mFirst;
+        mLast = other.mLast;
+        mScheduledFineDiffCount = other.mScheduledFineDiffCount;
+        mFineDiffArena = std::move(other.mFineDiffArena);
+        mFineDiffFill = std::move(other.mFineDiffFill);
+        return *this;
+    }
+    ~Diff3LineList() { stopFineDiffFill(); }
+
+    [[nodiscard]] iterator begin() { return iterator(this, firstIndex()); }
+    [[nodiscard]] iterator end() { return iterator(this, npos); }
+    [[nodiscard]] const_iterator begin() const { return const_iterator(this, firstIndex()); }
+    [[nodiscard]] const_iterator end() const { return const_iterator(this, npos); }
+    [[nodiscard]] const_iterator cbegin() const { return begin(); }
+    [[nodiscard]] const_iterator cend() const { return end(); }
+    [[nodiscard]] reverse_iterator rbegin() { return reverse_iterator(end()); }
+    [[nodiscard]] reverse_iterator rend() { return reverse_iterator(begin()); }
+    [[nodiscard]] const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    [[nodiscard]] const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+    [[nodiscard]] const_reverse_iterator crbegin() const { return rbegin(); }
+    [[nodiscard]] const_reverse_iterator crend() const { return rend(); }
+
+    [[nodiscard]] size_type size() const { return mLines.size(); }
+    [[nodiscard]] bool empty() const { return mLines.empty(); }
+
+    bool operator==(const Diff3LineList& other) const { return size() == other.size() && std::equal(begin(), end(), other.begin()); }
+    bool operator!=(const Diff3LineList& other) const { return !(*this == other); }
+
+    void push_back(const Diff3Line& d3l);
+    // Inserts d3l before pos. Iterators stay valid, references and pointers to lines do not.
+    iterator insert(const_iterator pos, const Diff3Line& d3l);
+    // Removes all lines equal to d3l and puts the rest back in list order.
+    void remove(const Diff3Line& d3l);
+
+    // The background fill must not outlive the lines. Also frees the fine diffs and the text they were calculated on.
+    void clear();
 
     void findHistoryRange(const QRegularExpression& historyStart, bool bThreeFiles, HistoryRange& range) const;
     bool fineDiff(const e_SrcSelector selector, const std::shared_ptr<LineDataVector> &v1, const std::shared_ptr<LineDataVector> &v2, const IgnoreFlags eIgnoreFlags);
+    // Same as above for the lines in d3lv, which must point into this list.
+    bool fineDiff(const Diff3LineVector& d3lv, const e_SrcSelector selector, const std::shared_ptr<LineDataVector>& v1, const std::shared_ptr<LineDataVector>& v2, const IgnoreFlags eIgnoreFlags);
+    /*
+        Same as above without display: the fine diffs stay pending and the data is not registered for painting.
+        Lists that are never shown may use this on any thread, many at a time.
+    */
+    bool fineDiffForStatus(const Diff3LineVector& d3lv, const e_SrcSelector selector, const std::shared_ptr<LineDataVector>& v1, const std::shared_ptr<LineDataVector>& v2, const IgnoreFlags eIgnoreFlags);
+    /*
+        Number of line pairs fineDiff has given a fine diff or marked as pending over the lifetime of this list.
+        Each pair is scheduled at most once per analysis so this grows by no more than numberOfFineDiffs() per run.
+    */
+    [[nodiscard]] quint64 scheduledFineDiffCount() const { return mScheduledFineDiffCount; }
+    /*
+        Number of line pairs DiffList::calcDiff actually ran on since the fine diffs were last cleared, right away
+        or later for pending ones. Copies of the list share the count. Two threads asking for the same pending pair
+        at once may both diff it.
+    */
+    [[nodiscard]] quint64 fineDiffCount() const { return mFineDiffArena != nullptr ? mFineDiffArena->lineCount() : 0; }
+    // Number of line pairs currently holding a fine diff.
+    [[nodiscard]] quint64 numberOfFineDiffs() const;
     void calcDiff3LineVector(Diff3LineVector& d3lv);
+
+    /*
+        Calculates the fine diffs left pending by a lazy fineDiff on the thread pool while the user looks at the
+        first screen. Lines that get painted earlier are calculated on demand. The lines in d3lv must stay
+        unchanged until stopFineDiffFill, which clear() and the destructor call.
+    */
+    void startFineDiffFill(const Diff3LineVector& d3lv);
+    void stopFineDiffFill() const;
     void calcWhiteDiff3Lines(const std::shared_ptr<const LineDataVector>& pldA, const std::shared_ptr<const LineDataVector>& pldB, const std::shared_ptr<const LineDataVector>& pldC, const bool bIgnoreComments);
 
     void calcDiff3LineListUsingAB(const DiffList* pDiffListAB);
@@ -455,6 +872,48 @@ class Diff3LineList: public std::list<Diff3Line>
             return SafeInt<LineType>(size());
         }
     }
+
+  private:
+    struct FineDiffFill;
+
+    static constexpr qsizetype npos = -1;
+
+    [[nodiscard]] qsizetype firstIndex() const { return mNext.empty() ? (mLines.empty() ? npos : 0) : mFirst; }
+    [[nodiscard]] qsizetype lastIndex() const { return mNext.empty() ? (qsizetype)mLines.size() - 1 : mLast; }
+    [[nodiscard]] qsizetype nextIndex(const qsizetype idx) const
+    {
+        assert(idx != npos);
+        if(mNext.empty())
+            return idx + 1 < (qsizetype)mLines.size() ? idx + 1 : npos;
+        return mNext[idx];
+    }
+    [[nodiscard]] qsizetype prevIndex(const qsizetype idx) const
+    {
+        if(idx == npos)
+            return lastIndex();
+        return mNext.empty() ? idx - 1 : mPrev[idx];
+    }
+
+    // Starts keeping the order in mNext and mPrev, needed before the first insert in the middle.
+    void link();
+    // Moves the lines into list order so the links can be dropped.
+    void unlink();
+
+    bool calcFineDiffs(const Diff3LineVector& d3lv, const e_SrcSelector selector, const std::shared_ptr<LineDataVector>& v1, const std::shared_ptr<LineDataVector>& v2,
+                       const IgnoreFlags eIgnoreFlags, const bool bLazy);
+
+    std::vector<Diff3Line> mLines;
+    // Empty while mLines is in list order, the common case.
+    std::vector<qsizetype> mNext;
+    std::vector<qsizetype> mPrev;
+    qsizetype mFirst = npos;
+    qsizetype mLast = npos;
+
+    quint64 mScheduledFineDiffCount = 0;
+    // Shared with copies of the list, their lines point into it as well.
+    std::shared_ptr<FineDiffArena> mFineDiffArena;
+    // Stopping a fill leaves the lines as they are, so it is done on const lists too.
+    mutable std::shared_ptr<FineDiffFill> mFineDiffFill;
 };
 
 struct HistoryRange
@@ -613,6 +1072,62 @@ class ManualDiffHelpEntry
 };
 
 // A list of corresponding ranges
+/*
+    Remembers the diffs of the ranges between manual alignments for one pair of inputs. After an alignment is
+    added or removed only the ranges next to it have to be diffed again. The line data is not watched, so the
+    owner must clear the cache whenever the inputs are reloaded.
+*/
+class DiffSegmentCache
+{
+  public:
+    void clear() { mSegments.clear(); }
+    [[nodiscard]] bool empty() const { return mSegments.empty(); }
+    [[nodiscard]] size_t size() const { return mSegments.size(); }
+
+  private:
+    friend class ManualDiffHelpList;
+
+    struct Key {
+        size_t index1;
+        LineType size1;
+        size_t index2;
+        LineType size2;
+
+        bool operator<(const Key& b) const { return std::tie(index1, size1, index2, size2) < std::tie(b.index1, b.size1, b.index2, b.size2); }
+    };
+
+    struct Segment {
+        DiffList diffList;
+        bool bUsed = true;
+    };
+
+    // Options that change the result of the line matching.
+    struct LineMatchingOptions {
+        qint32 diffAlgorithm = -1;
+        bool bTryHard = false;
+        bool bIgnoreNumbers = false;
+        bool bFastLargeFiles = false;
+        bool bAnchoredDiff = false;
+
+        bool operator==(const LineMatchingOptions& b) const
+        {
+            return diffAlgorithm == b.diffAlgorithm && bTryHard == b.bTryHard && bIgnoreNumbers == b.bIgnoreNumbers && bFastLargeFiles == b.bFastLargeFiles &&
+                   bAnchoredDiff == b.bAnchoredDiff;
+        }
+        bool operator!=(const LineMatchingOptions& b) const { return !(*this == b); }
+    };
+
+    // Drops everything if the options changed since the last run.
+    void startRun();
+    // Drops the ranges not used since startRun.
+    void finishRun();
+    // Sets diffList to the diff of the range, only running it if the range is not cached.
+    void runDiff(const std::shared_ptr<const LineDataVector>& p1, const size_t index1, LineRef size1, const std::shared_ptr<const LineDataVector>& p2, const size_t index2, LineRef size2, DiffList& diffList);
+
+    std::map<Key, Segment> mSegments;
+    LineMatchingOptions mOptions;
+};
+
 class ManualDiffHelpList: public std::list<ManualDiffHelpEntry>
 {
   public:
@@ -621,8 +1136,9 @@ class ManualDiffHelpList: public std::list<ManualDiffHelpEntry>
     [[nodiscard]] bool isValidMove(LineRef line1, LineRef line2, e_SrcSelector winIdx1, e_SrcSelector winIdx2) const;
     void insertEntry(e_SrcSelector winIdx, LineRef firstLine, LineRef lastLine);
 
+    // If pCache is given the diffs of ranges that did not change since the last call are taken from there.
     void runDiff(const std::shared_ptr<LineDataVector>& p1, LineRef size1, const std::shared_ptr<LineDataVector>& p2, LineRef size2, DiffList& diffList,
-                 e_SrcSelector winIdx1, e_SrcSelector winIdx2);
+                 e_SrcSelector winIdx1, e_SrcSelector winIdx2, DiffSegmentCache* pCache = nullptr);
 };
 
 /** Returns the number of equivalent spaces at position outPos.
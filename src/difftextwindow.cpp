@@ -163,7 +163,7 @@ class DiffTextWindowData
 
     void writeLine(
         RLPainter& p,
-        const std::shared_ptr<const DiffList>& pLineDiff1, const std::shared_ptr<const DiffList>& pLineDiff2, const LineRef& line,
+        const FineDiffRange& lineDiff1, const FineDiffRange& lineDiff2, const LineRef& line,
         const ChangeFlags whatChanged, const ChangeFlags whatChanged2, const LineRef& srcLineIdx,
         qint32 wrapLineOffset, qint32 wrapLineLength, bool bWrapLine, const QRect& invalidRect);
 
@@ -1058,8 +1058,8 @@ void DiffTextWindowData::prepareTextLayout(QTextLayout& textLayout, qint32 visib
 */
 void DiffTextWindowData::writeLine(
     RLPainter& p,
-    const std::shared_ptr<const DiffList>& pLineDiff1,
-    const std::shared_ptr<const DiffList>& pLineDiff2,
+    const FineDiffRange& lineDiff1,
+    const FineDiffRange& lineDiff2,
     const LineRef& line,
     const ChangeFlags whatChanged,
     const ChangeFlags whatChanged2,
@@ -1102,8 +1102,8 @@ void DiffTextWindowData::writeLine(
         return;
 
     ChangeFlags changed = whatChanged;
-    if(pLineDiff1 != nullptr) changed |= AChanged;
-    if(pLineDiff2 != nullptr) changed |= BChanged;
+    if(!lineDiff1.isNull()) changed |= AChanged;
+    if(!lineDiff2.isNull()) changed |= BChanged;
 
     QColor penColor = gOptions->foregroundColor();
     p.setPen(penColor);
@@ -1139,7 +1139,7 @@ void DiffTextWindowData::writeLine(
             }
         }
         QVector<ChangeFlags> charChanged(pld->size());
-        Merger merger(pLineDiff1, pLineDiff2);
+        Merger merger(lineDiff1, lineDiff2);
         while(!merger.isEndReached() && i < pld->size())
         {
             charChanged[i] = merger.whatChanged();
@@ -1330,18 +1330,18 @@ void DiffTextWindow::draw(RLPainter& p, const QRect& invalidRect, const qint32 b
         {
             d3l = (*d->diff3LineVector())[line];
         }
-        std::shared_ptr<const DiffList> pFineDiff1;
-        std::shared_ptr<const DiffList> pFineDiff2;
+        FineDiffRange fineDiff1;
+        FineDiffRange fineDiff2;
         ChangeFlags changed = NoChange;
         ChangeFlags changed2 = NoChange;
 
         LineRef srcLineIdx;
-        d3l->getLineInfo(getWindowIndex(), KDiff3App::isTripleDiff(), srcLineIdx, pFineDiff1, pFineDiff2, changed, changed2);
+        d3l->getLineInfo(getWindowIndex(), KDiff3App::isTripleDiff(), srcLineIdx, fineDiff1, fineDiff2, changed, changed2);
 
         d->writeLine(
             p, // QPainter
-            pFineDiff1,
-            pFineDiff2,
+            fineDiff1,
+            fineDiff2,
             line, // Line on the screen
             changed,
             changed2,
@@ -12,23 +12,29 @@
 
 #include "compat.h"
 #include "CompositeIgnoreList.h"
+#include "ContentHashCache.h"
 #include "defmac.h"
 #include "DirectoryInfo.h"
+#include "FileAnalysis.h"
 #include "guiutils.h"
 #include "kdiff3.h"
 #include "Logging.h"
 #include "MergeFileInfos.h"
 #include "options.h"
+#include "Parallel.h"
 #include "PixMapUtils.h"
 #include "progress.h"
 #include "TypeUtils.h"
 #include "Utils.h"
 
+#include <algorithm>
 #include <map>
 #include <memory>
+#include <vector>
 
 #include <QAction>
 #include <QApplication>
+#include <QAtomicInteger>
 #include <QDialogButtonBox>
 #include <QDir>
 #include <QElapsedTimer>
@@ -42,6 +48,8 @@
 #include <QStyledItemDelegate>
 #include <QTextEdit>
 #include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
 
 #include <KLocalizedString>
 #include <KMessageBox>
@@ -301,6 +309,9 @@ class DirectoryMergeWindow::DirectoryMergeWindowPrivate: public QAbstractItemMod
 
     t_fileMergeMap m_fileMergeMap;
 
+    // Compares or analyses local files in prepareListView().
+    QThreadPool m_comparisonPool;
+
   public:
     DirectoryMergeWindow* mWindow;
     KDiff3App& m_app;
@@ -487,6 +498,12 @@ QVariant DirectoryMergeWindow::DirectoryMergeWindowPrivate::data(const QModelInd
                 }
             }
         }
+        else if(role == Qt::ToolTipRole)
+        {
+            // How the files were found equal or different.
+            if((s_NameCol == index.column() || s_OpStatusCol == index.column()) && !pMFI->compareStatus().isEmpty())
+                return pMFI->compareStatus();
+        }
         else if(role == Qt::DecorationRole)
         {
             if(s_NameCol == index.column())
@@ -1324,18 +1341,71 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareListView()
     t.start();
     ProgressProxy::setMaxNofSteps(nrOfFiles);
 
+    /*
+        Comparing local files needs nothing but the files, so these run on the comparison pool first. A binary
+        comparison is mostly waiting for the disk, hence more threads than cores. Full analysis is done without
+        widgets unless the options need the GUI. Everything else, like files that go through KIO, is compared
+        one by one below.
+    */
+    const bool bParallel = !gOptions->m_bDmFullAnalysis || FileAnalysis::isPossible();
+    std::vector<MergeFileInfos*> allFiles;
+    std::vector<qsizetype> parallelFiles;
+    allFiles.reserve(nrOfFiles);
     for(MergeFileInfos& mfi: m_fileMergeMap)
     {
+        if(bParallel && mfi.isLocal())
+            parallelFiles.push_back(SafeInt<qsizetype>(allFiles.size()));
+        allFiles.push_back(&mfi);
+    }
+
+    std::vector<QStringList> fileErrors(allFiles.size());
+    // Not std::vector<bool>, the workers write neighbouring elements.
+    std::vector<char> bCompared(allFiles.size(), false);
+    QAtomicInteger<qint32> nofErrors = 0;
+    m_comparisonPool.setMaxThreadCount(gOptions->m_bDmFullAnalysis ? QThread::idealThreadCount() : std::clamp(2 * QThread::idealThreadCount(), 2, 16));
+    ProgressProxy::setInformation(i18n("Comparing files..."), false);
+    Parallel::forEach(
+        parallelFiles.size(), [this, &allFiles, &parallelFiles, &fileErrors, &bCompared, &nofErrors](const qsizetype i) {
+            const qsizetype idx = parallelFiles[i];
+            if(nofErrors.loadRelaxed() < 30 && !ProgressProxy::wasCancelled())
+            {
+                if(!allFiles[idx]->compareFilesAndCalcAges(fileErrors[idx], mWindow))
+                    nofErrors.fetchAndAddRelaxed(SafeInt<qint32>(fileErrors[idx].size()));
+                bCompared[idx] = true;
+            }
+        },
+        &m_comparisonPool);
+    currentIdx = SafeInt<qint32>(currentIdx + parallelFiles.size());
+
+    // The tree is built in order, so errors are reported and counted as if the files were compared here.
+    for(size_t idx = 0; idx < allFiles.size(); ++idx)
+    {
+        MergeFileInfos& mfi = *allFiles[idx];
         const QString& fileName = mfi.subPath();
 
-        ProgressProxy::setInformation(
-            i18n("Processing %1 / %2\n%3", currentIdx, nrOfFiles, fileName), currentIdx, false);
         if(ProgressProxy::wasCancelled()) break;
-        ++currentIdx;
 
-        // The comparisons and calculations for each file take place here.
-        if(!mfi.compareFilesAndCalcAges(errors, mWindow) && errors.size() >= 30)
-            break;
+        if(bCompared[idx])
+        {
+            for(const QString& error: fileErrors[idx])
+            {
+                //Limit size of error list in memory.
+                if(errors.size() < 30)
+                    errors.append(error);
+            }
+            if(!fileErrors[idx].isEmpty() && errors.size() >= 30)
+                break;
+        }
+        else
+        {
+            ProgressProxy::setInformation(
+                i18n("Processing %1 / %2\n%3", currentIdx, nrOfFiles, fileName), currentIdx, false);
+            ++currentIdx;
+
+            // The comparisons and calculations for each file take place here.
+            if(!mfi.compareFilesAndCalcAges(errors, mWindow) && errors.size() >= 30)
+                break;
+        }
 
         // Get dirname from fileName: Search for "/" from end:
         qsizetype pos = fileName.lastIndexOf(u'/');
@@ -1371,6 +1441,9 @@ void DirectoryMergeWindow::DirectoryMergeWindowPrivate::prepareListView()
         mfi.updateAge();
     }
 
+    if(gOptions->m_bDmHashCache)
+        ContentHashCache::instance().save();
+
     if(errors.size() > 0)
     {
         if(errors.size() < 15)
@@ -26,6 +26,7 @@
 #include <sys/stat.h>
 
 #ifndef Q_OS_WIN
+#include <sys/mman.h>
 #include <unistd.h>
 #endif
 #include <utility>                        // for move
@@ -842,6 +843,32 @@ bool FileAccess::readFile(void* pDestBuffer, qint64 maxLength)
     return success;
 }
 
+std::shared_ptr<const FileMapping> FileAccess::mapForReading(const bool bSequential) const
+{
+    if(!isLocal() || !isNormal() || size() <= 0)
+        return nullptr;
+
+    std::shared_ptr<FileMapping> mapping = std::make_shared<FileMapping>();
+    mapping->mFile.setFileName(absoluteFilePath());
+    if(!mapping->mFile.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    mapping->mSize = mapping->mFile.size();
+    mapping->mData = mapping->mSize > 0 ? mapping->mFile.map(0, mapping->mSize) : nullptr;
+    if(mapping->mData == nullptr)
+        return nullptr;
+
+#ifndef Q_OS_WIN
+    // Only a hint, nothing to do if it is not taken.
+    if(bSequential)
+        ::madvise(mapping->mData, mapping->mSize, MADV_SEQUENTIAL);
+#else
+    Q_UNUSED(bSequential);
+#endif
+
+    return mapping;
+}
+
 bool FileAccess::writeFile(const void* pSrcBuffer, qint64 length)
 {
     ProgressScope pp;
@@ -1001,6 +1028,27 @@ qint64 FileAccess::read(char* data, const qint64 maxlen)
     return len;
 }
 
+bool FileAccess::seek(const qint64 pos)
+{
+    setStatusText("");
+
+    bool r = false;
+    if(m_localCopy.isEmpty() && realFile != nullptr)
+    {
+        r = realFile->seek(pos);
+        if(!r)
+            setStatusText(i18nc("@info:status %1 is the path, %2 is the error message", "Error reading from %1. %2", absoluteFilePath(), realFile->errorString()));
+    }
+    else
+    {
+        r = tmpFile->seek(pos);
+        if(!r)
+            setStatusText(i18nc("@info:status %1 is the path, %2 is the error message", "Error reading from %1. %2", absoluteFilePath(), tmpFile->errorString()));
+    }
+
+    return r;
+}
+
 void FileAccess::close()
 {
     if(m_localCopy.isEmpty() && realFile != nullptr)
@@ -13,6 +13,7 @@
 
 #include "DirectoryList.h"
 
+#include <memory>
 #include <type_traits>
 
 #include <QDateTime>
@@ -29,6 +30,28 @@
 class FileAccessJobHandler;
 class DefaultFileAccessJobHandler;
 class IgnoreList;
+
+/*
+    Read only memory mapping of a local file as returned by FileAccess::mapForReading.
+    The mapping is released when the last reference goes away.
+*/
+class FileMapping
+{
+  public:
+    FileMapping() = default;
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    [[nodiscard]] const char* data() const { return reinterpret_cast<const char*>(mData); }
+    [[nodiscard]] qint64 size() const { return mSize; }
+
+  private:
+    friend class FileAccess;
+
+    QFile mFile; // Closing the file unmaps the data.
+    uchar* mData = nullptr;
+    qint64 mSize = 0;
+};
 /*
   Defining a function as virtual in FileAccess is intended to allow testing sub classes to be written
   more easily. This way the test can use a moc class that emulates the needed conditions with no
@@ -99,6 +122,9 @@ class FileAccess
     }
 
     virtual bool readFile(void* pDestBuffer, qint64 maxLength);
+    // Returns nullptr for remote or empty files, use readFile for those.
+    // bSequential tells the system the data is read once from start to end, so it can read ahead further.
+    [[nodiscard]] std::shared_ptr<const FileMapping> mapForReading(bool bSequential = false) const;
     virtual bool writeFile(const void* pSrcBuffer, qint64 length);
     bool listDir(DirectoryList* pDirList, bool bRecursive, bool bFindHidden,
                  const QString& filePattern, const QString& fileAntiPattern,
@@ -134,6 +160,7 @@ class FileAccess
     bool open(const QFile::OpenMode flags);
 
     qint64 read(char* data, const qint64 maxlen);
+    bool seek(const qint64 pos);
     void close();
 
     [[nodiscard]] const QString& errorString() const;
@@ -35,18 +35,6 @@
 #include <stdlib.h>
 
 
-static GNULineRef *xvec, *yvec;  /* Vectors being compared. */
-static GNULineRef *fdiag;        /* Vector, indexed by diagonal, containing
-                   1 + the X coordinate of the point furthest
-                   along the given diagonal in the forward
-                   search of the edit matrix. */
-static GNULineRef *bdiag;        /* Vector, indexed by diagonal, containing
-                   the X coordinate of the point furthest
-                   along the given diagonal in the backward
-                   search of the edit matrix. */
-static GNULineRef too_expensive; /* Edit scripts longer than this are too
-                   expensive to compute.  */
-
 #define SNAKE_LIMIT 20 /* Snakes bigger than this are considered `big'.  */
 
 struct partition {
@@ -409,6 +397,7 @@ void GnuDiff::discard_confusing_lines(file_data filevec[])
     /* Mark to be discarded each line that matches no line of the other file.
      If a line matches many lines, mark it as provisionally discardable.  */
 
+    GNULineRef unmatched = 0;
     for(f = 0; f < 2; ++f)
     {
         size_t end = filevec[f].buffered_lines;
@@ -430,12 +419,24 @@ void GnuDiff::discard_confusing_lines(file_data filevec[])
                 continue;
             nmatch = counts[equivs[i]];
             if(nmatch == 0)
-                discards[i] = 1;
+                discards[i] = 1, ++unmatched;
             else if(nmatch > (GNULineRef)many)
                 discards[i] = 2;
         }
     }
 
+    /* Lines that match nothing are changes in any edit script, so UNMATCHED
+     is a cheap lower bound of the edit distance.  Big or very different
+     inputs are compared with the heuristics, this must be decided before
+     the lines are discarded below.  */
+    if(large_file_lines != 0 &&
+       (filevec[0].buffered_lines + filevec[1].buffered_lines > large_file_lines || unmatched > large_file_changes))
+    {
+        large_file_mode = true;
+        speed_large_files = true;
+        minimal = false;
+    }
+
     /* Don't really discard the provisional lines except when they occur
      in a run of discardables, with nonprovisionals at the beginning
      and end.  */
@@ -565,8 +566,8 @@ void GnuDiff::discard_confusing_lines(file_data filevec[])
         filevec[f].nondiscarded_lines = j;
     }
 
-    free(discarded[0]);
-    free(equiv_count[0]);
+    xfree(discarded[0]);
+    xfree(equiv_count[0]);
 }
 
 /* Adjust inserts/deletes of identical lines to join changes
@@ -806,6 +807,8 @@ GnuDiff::change *GnuDiff::diff_2_files(comparison *cmp)
         for(; diags != 0; diags >>= 2)
             too_expensive <<= 1;
         too_expensive = std::max((GNULineRef)256, too_expensive);
+        if(large_file_mode && large_file_cost != 0)
+            too_expensive = std::min(large_file_cost, too_expensive);
 
         files[0] = cmp->file[0];
         files[1] = cmp->file[1];
@@ -813,7 +816,7 @@ GnuDiff::change *GnuDiff::diff_2_files(comparison *cmp)
         compareseq(0, cmp->file[0].nondiscarded_lines,
                    0, cmp->file[1].nondiscarded_lines, minimal);
 
-        free(fdiag - (cmp->file[1].nondiscarded_lines + 1));
+        xfree(fdiag - (cmp->file[1].nondiscarded_lines + 1));
 
         /* Modify the results slightly to make them prettier
      in cases where that can validly be done.  */
@@ -825,14 +828,14 @@ GnuDiff::change *GnuDiff::diff_2_files(comparison *cmp)
 
         script = build_script(cmp->file);
 
-        free(cmp->file[0].undiscarded);
+        xfree(cmp->file[0].undiscarded);
 
-        free(flag_space);
+        xfree(flag_space);
 
         for(f = 0; f < 2; ++f)
         {
-            free(cmp->file[f].equivs);
-            free(cmp->file[f].linbuf + cmp->file[f].linbuf_base);
+            xfree(cmp->file[f].equivs);
+            xfree(cmp->file[f].linbuf + cmp->file[f].linbuf_base);
         }
     }
 
@@ -26,11 +26,13 @@
 #include <sys/types.h>
 
 #include <algorithm>
+#include <cstddef>
 #include <ctype.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <type_traits>
+#include <vector>
 
 #include <stdio.h>
 
@@ -46,18 +48,61 @@ static_assert(sizeof(GNULineRef) >= sizeof(ptrdiff_t), "GNULineRef must be able
 //Platforms failing this test are not offically supported by KDiff3.
 static_assert(sizeof(size_t) == sizeof(ptrdiff_t), "size_t must be match size of ptrdiff_t as this is assumed.");
 
+struct equivclass;
+struct partition;
 
+/*
+    Memory of one comparison. All of GnuDiff's working storage and the resulting edit script come from here
+    and are released at once with the arena. Blocks of the standard size are kept per thread afterwards, so
+    many small comparisons in a row hardly touch malloc.
+*/
+class GnuDiffArena
+{
+  public:
+    GnuDiffArena() = default;
+    ~GnuDiffArena();
+    GnuDiffArena(const GnuDiffArena &) = delete;
+    GnuDiffArena &operator=(const GnuDiffArena &) = delete;
+
+    // These return nullptr if out of memory.
+    void *allocate(size_t n);
+    void *reallocate(void *p, size_t n);
+    // Big allocations have a block of their own that is given back here, others wait for the arena.
+    void release(void *p);
+
+  private:
+    static constexpr size_t blockSize = 64 * 1024;
+    static constexpr size_t headerSize = alignof(std::max_align_t);
+
+    struct Block {
+        char *data;
+        size_t size;
+        size_t used;
+        bool bDedicated;
+    };
+
+    static size_t roundUp(size_t n) { return (n + headerSize - 1) / headerSize * headerSize; }
+    static size_t &sizeOf(void *p) { return *(size_t *)((char *)p - headerSize); }
+    std::vector<Block>::iterator findDedicated(void *p);
+
+    std::vector<Block> blocks;
+};
+
+/*
+    All state of a comparison lives in the GnuDiff object so separate objects can be used from several threads
+    at the same time.
+*/
 class GnuDiff
 {
   public:
     /* Variables for command line options */
 
     /* Nonzero if output cannot be generated for identical files.  */
-    bool no_diff_means_no_output;
+    bool no_diff_means_no_output = false;
 
     /* Number of lines of context to show in each set of diffs.
    This is zero when context is not to be shown.  */
-    GNULineRef context;
+    GNULineRef context = 0;
 
     /* The significance of white space during comparisons.  */
     enum
@@ -73,26 +118,38 @@ class GnuDiff
 
         /* Ignore all horizontal white space (-w).  */
         IGNORE_ALL_SPACE
-    } ignore_white_space;
+    } ignore_white_space = IGNORE_NO_WHITE_SPACE;
 
     /* Ignore changes that affect only numbers. (J. Eibl)  */
-    bool bIgnoreNumbers;
-    bool bIgnoreWhiteSpace;
+    bool bIgnoreNumbers = false;
+    bool bIgnoreWhiteSpace = false;
 
     /* Files can be compared byte-by-byte, as if they were binary.
    This depends on various options.  */
-    bool files_can_be_treated_as_binary;
+    bool files_can_be_treated_as_binary = false;
 
     /* Ignore differences in case of letters (-i).  */
-    bool ignore_case;
+    bool ignore_case = false;
 
     /* Use heuristics for better speed with large files with a small
    density of changes.  */
-    bool speed_large_files;
+    bool speed_large_files = false;
 
     /* Don't discard lines.  This makes things slower (sometimes much
    slower) but will find a guaranteed minimal set of changes.  */
-    bool minimal;
+    bool minimal = false;
+
+    /* Switch to speed_large_files and drop minimal once the files together have more
+   lines than this, or more lines that match nothing in the other file than
+   LARGE_FILE_CHANGES.  Zero disables the switch.  */
+    GNULineRef large_file_lines = 0;
+    GNULineRef large_file_changes = 0;
+
+    /* Upper bound for TOO_EXPENSIVE once the switch was made, zero for none.  */
+    GNULineRef large_file_cost = 0;
+
+    /* Set by diff_2_files if the switch was made, the result may not be minimal then.  */
+    bool large_file_mode = false;
 
     /* The result of comparison is an "edit script": a chain of `struct change'.
    Each `struct change' represents one place where some lines are deleted
@@ -122,6 +179,10 @@ class GnuDiff
         /* Buffer in which text of file is read.  */
         const QChar *buffer;
 
+        /* Used instead of buffer if the text is stored as Latin-1.
+       Both files of a comparison must use the same kind of buffer.  */
+        const char *latin1Buffer;
+
         /* Allocated size of buffer, in QChars.  Always a multiple of
        sizeof(*buffer).  */
         size_t bufsize;
@@ -129,8 +190,14 @@ class GnuDiff
         /* Number of valid bytes now in the buffer.  */
         size_t buffered;
 
-        /* Array of pointers to lines in the file.  */
-        const QChar **linbuf;
+        /* Precomputed hash of each line from the start of the buffer, or null to
+       hash while splitting.  Both files of a comparison must either have
+       them or not, see LineDataVector::lineHashes.  */
+        const size_t *line_hashes;
+
+        /* Array of pointers to lines in the file.
+       These point into buffer or latin1Buffer.  */
+        const void **linbuf;
 
         /* linbuf_base <= buffered_lines <= valid_lines <= alloc_lines.
        linebuf[linbuf_base ... buffered_lines - 1] are possibly differing.
@@ -139,14 +206,14 @@ class GnuDiff
         GNULineRef linbuf_base, buffered_lines, valid_lines, alloc_lines;
 
         /* Pointer to end of prefix of this file to ignore when hashing.  */
-        const QChar *prefix_end;
+        const void *prefix_end;
 
         /* Count of lines in the prefix.
        There are this many lines in the file before linbuf[0].  */
         GNULineRef prefix_lines;
 
         /* Pointer to start of suffix of this file to ignore when hashing.  */
-        const QChar *suffix_begin;
+        const void *suffix_begin;
 
         /* Vector, indexed by line number, containing an equivalence code for
        each line.  It is this vector that is actually compared with that
@@ -196,11 +263,27 @@ class GnuDiff
     bool read_files(file_data[], bool);
 
     /* util.c */
-    bool lines_differ(const QChar *, size_t, const QChar *, size_t);
+    template <typename CharT>
+    bool lines_differ(const CharT *, size_t, const CharT *, size_t);
     void *zalloc(size_t);
 
   private:
     // gnudiff_analyze.cpp
+
+    /* Vectors being compared.  */
+    GNULineRef *xvec = nullptr, *yvec = nullptr;
+
+    /* Vector, indexed by diagonal, containing 1 + the X coordinate of the point
+   furthest along the given diagonal in the forward search of the edit matrix.  */
+    GNULineRef *fdiag = nullptr;
+
+    /* Vector, indexed by diagonal, containing the X coordinate of the point
+   furthest along the given diagonal in the backward search of the edit matrix.  */
+    GNULineRef *bdiag = nullptr;
+
+    /* Edit scripts longer than this are too expensive to compute.  */
+    GNULineRef too_expensive = 0;
+
     GNULineRef diag(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim, bool find_minimal, struct partition *part) const;
     void compareseq(GNULineRef xoff, GNULineRef xlim, GNULineRef yoff, GNULineRef ylim, bool find_minimal);
     void discard_confusing_lines(file_data filevec[]);
@@ -210,13 +293,37 @@ class GnuDiff
     change *build_script(file_data const filevec[]);
 
     // gnudiff_io.cpp
+
+    /* Hash-table: array of buckets, each being a chain of equivalence classes.
+   buckets[-1] is reserved for incomplete lines.  */
+    GNULineRef *buckets = nullptr;
+
+    /* Number of buckets in the hash table array, not counting buckets[-1].  */
+    size_t nbuckets = 0;
+
+    /* Array in which the equivalence classes are allocated.
+   The bucket-chains go through the elements in this array.
+   The number of an equivalence class is its index in this array.  */
+    equivclass *equivs = nullptr;
+
+    /* Index of first free element in the array `equivs'.  */
+    GNULineRef equivs_index = 0;
+
+    /* Number of elements allocated in the array `equivs'.  */
+    GNULineRef equivs_alloc = 0;
+
     GNULineRef guess_lines(GNULineRef n, size_t s, size_t t);
+    template <typename CharT>
     void find_and_hash_each_line(file_data *current);
+    template <typename CharT>
     void find_identical_ends(file_data filevec[]);
 
     // gnudiff_xmalloc.cpp
+    GnuDiffArena arena;
+
     void *xmalloc(size_t n);
     void *xrealloc(void *p, size_t n);
+    void xfree(void *p);
     void xalloc_die();
 }; // class GnuDiff
 
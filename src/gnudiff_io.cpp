@@ -15,8 +15,10 @@
 
 #include "gnudiff_diff.h"
 
+#include "LineScanner.h"
 #include "Utils.h"
 
+#include <assert.h>
 #include <stdlib.h>
 #include <type_traits>
 
@@ -37,28 +39,10 @@ static_assert(std::is_unsigned<hash_value>::value, "hash_value must be signed.")
 struct equivclass {
     GNULineRef next;   /* Next item in this bucket.  */
     hash_value hash;   /* Hash of lines in this class.  */
-    const QChar *line; /* A line that fits this class.  */
+    const void *line;  /* A line that fits this class.  */
     size_t length;     /* That line's length, not counting its newline.  */
 };
 
-/* Hash-table: array of buckets, each being a chain of equivalence classes.
-   buckets[-1] is reserved for incomplete lines.  */
-static GNULineRef *buckets;
-
-/* Number of buckets in the hash table array, not counting buckets[-1].  */
-static size_t nbuckets;
-
-/* Array in which the equivalence classes are allocated.
-   The bucket-chains go through the elements in this array.
-   The number of an equivalence class is its index in this array.  */
-static equivclass *equivs;
-
-/* Index of first free element in the array `equivs'.  */
-static GNULineRef equivs_index;
-
-/* Number of elements allocated in the array `equivs'.  */
-static GNULineRef equivs_alloc;
-
 /* Check for binary files and compare them for exact identity.  */
 
 /* Return 1 if BUF contains a non text character.
@@ -66,18 +50,33 @@ static GNULineRef equivs_alloc;
 
 #define binary_file_p(buf, size) (memchr(buf, 0, size) != 0)
 
+/* Lines are either QChar or Latin-1 text, see file_data::latin1Buffer.
+   Both are hashed and compared by their UTF-16 value.  */
+static inline QChar toQChar(QChar c) { return c; }
+static inline QChar toQChar(char c) { return QChar::fromLatin1(c); }
+
+template <typename CharT>
+static const CharT *bufferOf(const GnuDiff::file_data &f);
+
+template <>
+const QChar *bufferOf<QChar>(const GnuDiff::file_data &f) { return f.buffer; }
+
+template <>
+const char *bufferOf<char>(const GnuDiff::file_data &f) { return f.latin1Buffer; }
+
 /* Compare two lines (typically one from each input file)
    according to the command line options.
    For efficiency, this is invoked only when the lines do not match exactly
    but an option like -i might cause us to ignore the difference.
    Return nonzero if the lines differ.  */
 
-bool GnuDiff::lines_differ(const QChar *s1, size_t len1, const QChar *s2, size_t len2)
+template <typename CharT>
+bool GnuDiff::lines_differ(const CharT *s1, size_t len1, const CharT *s2, size_t len2)
 {
-    const QChar *t1 = s1;
-    const QChar *t2 = s2;
-    const QChar *s1end = s1 + len1;
-    const QChar *s2end = s2 + len2;
+    const CharT *t1 = s1;
+    const CharT *t2 = s2;
+    const CharT *s1end = s1 + len1;
+    const CharT *s2end = s2 + len2;
 
     for(;; ++t1, ++t2)
     {
@@ -87,15 +86,15 @@ bool GnuDiff::lines_differ(const QChar *s1, size_t len1, const QChar *s2, size_t
         else
         {
             while(t1 != s1end &&
-                  ((bIgnoreWhiteSpace && isspace((unsigned char)t1->unicode())) ||
-                   (bIgnoreNumbers && (t1->isDigit() || *t1 == u'-' || *t1 == u'.'))))
+                  ((bIgnoreWhiteSpace && isspace((unsigned char)toQChar(*t1).unicode())) ||
+                   (bIgnoreNumbers && (toQChar(*t1).isDigit() || *t1 == u'-' || *t1 == u'.'))))
             {
                 ++t1;
             }
 
             while(t2 != s2end &&
-                  ((bIgnoreWhiteSpace && isspace((unsigned char)t2->unicode())) ||
-                   (bIgnoreNumbers && (t2->isDigit() || *t2 == u'-' || *t2 == u'.'))))
+                  ((bIgnoreWhiteSpace && isspace((unsigned char)toQChar(*t2).unicode())) ||
+                   (bIgnoreNumbers && (toQChar(*t2).isDigit() || *t2 == u'-' || *t2 == u'.'))))
             {
                 ++t2;
             }
@@ -104,7 +103,7 @@ bool GnuDiff::lines_differ(const QChar *s1, size_t len1, const QChar *s2, size_t
             {
                 if(ignore_case)
                 { /* Lowercase comparison. */
-                    if(t1->toLower() == t2->toLower())
+                    if(toQChar(*t1).toLower() == toQChar(*t2).toLower())
                         continue;
                 }
                 else if(*t1 == *t2)
@@ -124,16 +123,17 @@ bool GnuDiff::lines_differ(const QChar *s1, size_t len1, const QChar *s2, size_t
 /* Split the file into lines, simultaneously computing the equivalence
    class for each line.  */
 
+template <typename CharT>
 void GnuDiff::find_and_hash_each_line(file_data *current)
 {
     hash_value h;
-    const QChar *p = current->prefix_end;
+    const CharT *p = (const CharT *)current->prefix_end;
     QChar c;
     GNULineRef i, *bucket;
     size_t length;
 
     /* Cache often-used quantities in local variables to help the compiler.  */
-    const QChar **linbuf = current->linbuf;
+    const void **linbuf = current->linbuf;
     GNULineRef alloc_lines = current->alloc_lines;
     GNULineRef line = 0;
     GNULineRef linbuf_base = current->linbuf_base;
@@ -141,58 +141,59 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
     equivclass *eqs = equivs;
     GNULineRef eqs_index = equivs_index;
     GNULineRef eqs_alloc = equivs_alloc;
-    const QChar *suffix_begin = current->suffix_begin;
-    const QChar *bufend = current->buffer + current->buffered;
+    const CharT *suffix_begin = (const CharT *)current->suffix_begin;
+    const CharT *bufend = bufferOf<CharT>(*current) + current->buffered;
     bool diff_length_compare_anyway =
         ignore_white_space != IGNORE_NO_WHITE_SPACE || bIgnoreNumbers;
     bool same_length_diff_contents_compare_anyway =
         diff_length_compare_anyway | ignore_case;
+    const size_t *line_hashes = current->line_hashes ? current->line_hashes + current->prefix_lines : nullptr;
 
     while(p < suffix_begin)
     {
-        const QChar *ip = p;
+        const CharT *ip = p;
 
         h = 0;
 
         /* Hash this line until we find a newline or bufend is reached.  */
-        if(ignore_case)
+        const CharT *eol = LineScanner::findNewLine(p, bufend);
+        if(line_hashes)
+        {
+            h = line_hashes[line];
+            p = eol;
+        }
+        else if(ignore_case)
             switch(ignore_white_space)
             {
                 case IGNORE_ALL_SPACE:
-                    while(p < bufend && !Utils::isEndOfLine(c = *p))
+                    for(; p < eol; ++p)
                     {
+                        c = toQChar(*p);
                         if(!(isspace((unsigned char)c.unicode()) || (bIgnoreNumbers && (c.isDigit() || c == u'-' || c == u'.'))))
                             h = HASH(h, c.toLower().unicode());
-                        ++p;
                     }
                     break;
 
                 default:
-                    while(p < bufend && !Utils::isEndOfLine(c = *p))
-                    {
-                        h = HASH(h, c.toLower().unicode());
-                        ++p;
-                    }
+                    for(; p < eol; ++p)
+                        h = HASH(h, toQChar(*p).toLower().unicode());
                     break;
             }
         else
             switch(ignore_white_space)
             {
                 case IGNORE_ALL_SPACE:
-                    while(p < bufend && !Utils::isEndOfLine(c = *p))
+                    for(; p < eol; ++p)
                     {
+                        c = toQChar(*p);
                         if(!(isspace((unsigned char)c.unicode()) || (bIgnoreNumbers && (c.isDigit() || c == u'-' || c == u'.'))))
                             h = HASH(h, c.unicode());
-                        ++p;
                     }
                     break;
 
                 default:
-                    while(p < bufend && !Utils::isEndOfLine(c = *p))
-                    {
-                        h = HASH(h, c.unicode());
-                        ++p;
-                    }
+                    for(; p < eol; ++p)
+                        h = HASH(h, toQChar(*p).unicode());
                     break;
             }
 
@@ -221,7 +222,7 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
             }
             else if(eqs[i].hash == h)
             {
-                const QChar *eqline = eqs[i].line;
+                const CharT *eqline = (const CharT *)eqs[i].line;
 
                 /* Reuse existing class if lines_differ reports the lines
                equal.  */
@@ -230,7 +231,7 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
                     /* Reuse existing equivalence class if the lines are identical.
            This detects the common case of exact identity
            faster than lines_differ would.  */
-                    if(memcmp(eqline, ip, length * sizeof(QChar)) == 0)
+                    if(memcmp(eqline, ip, length * sizeof(CharT)) == 0)
                         break;
                     if(!same_length_diff_contents_compare_anyway)
                         continue;
@@ -251,7 +252,7 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
             alloc_lines = 2 * alloc_lines - linbuf_base;
             cureqs = (GNULineRef *)xrealloc(cureqs, alloc_lines * sizeof(*cureqs));
             linbuf += linbuf_base;
-            linbuf = (const QChar **)xrealloc(linbuf,
+            linbuf = (const void **)xrealloc(linbuf,
                                               (alloc_lines - linbuf_base) * sizeof(size_t));
             linbuf -= linbuf_base;
         }
@@ -274,7 +275,7 @@ void GnuDiff::find_and_hash_each_line(file_data *current)
                 xalloc_die();
             alloc_lines = 2 * alloc_lines - linbuf_base;
             linbuf += linbuf_base;
-            linbuf = (const QChar **)xrealloc(linbuf,
+            linbuf = (const void **)xrealloc(linbuf,
                                               (alloc_lines - linbuf_base) * sizeof(size_t));
             linbuf -= linbuf_base;
         }
@@ -317,17 +318,18 @@ GnuDiff::guess_lines(GNULineRef n, size_t s, size_t t)
 /* Given a vector of two file_data objects, find the identical
    prefixes and suffixes of each object.  */
 
+template <typename CharT>
 void GnuDiff::find_identical_ends(file_data filevec[])
 {
     /* Find identical prefix.  */
-    const QChar *p0, *p1, *buffer0, *buffer1;
-    p0 = buffer0 = filevec[0].buffer;
-    p1 = buffer1 = filevec[1].buffer;
+    const CharT *p0, *p1, *buffer0, *buffer1;
+    p0 = buffer0 = bufferOf<CharT>(filevec[0]);
+    p1 = buffer1 = bufferOf<CharT>(filevec[1]);
     size_t n0, n1;
     n0 = filevec[0].buffered;
     n1 = filevec[1].buffered;
-    const QChar *const pEnd0 = p0 + n0;
-    const QChar *const pEnd1 = p1 + n1;
+    const CharT *const pEnd0 = p0 + n0;
+    const CharT *const pEnd1 = p1 + n1;
 
     if(p0 == p1)
         /* The buffers are the same; sentinels won't work.  */
@@ -358,13 +360,13 @@ void GnuDiff::find_identical_ends(file_data filevec[])
     p0 = buffer0 + n0;
     p1 = buffer1 + n1;
 
-    const QChar *end0, *beg0;
+    const CharT *end0, *beg0;
     end0 = p0; /* Addr of last char in file 0.  */
 
     /* Get value of P0 at which we should stop scanning backward:
       this is when either P0 or P1 points just past the last char
       of the identical prefix.  */
-    beg0 = filevec[0].prefix_end + (n0 < n1 ? 0 : n0 - n1);
+    beg0 = (const CharT *)filevec[0].prefix_end + (n0 < n1 ? 0 : n0 - n1);
 
     /* Scan back until chars don't match or we reach that point.  */
     for(; p0 != beg0; p0--, p1--)
@@ -406,13 +408,13 @@ void GnuDiff::find_identical_ends(file_data filevec[])
      Handle 1 more line than the context says (because we count 1 too many),
      rounded up to the next power of 2 to speed index computation.  */
 
-    const QChar **linbuf0, **linbuf1;
+    const void **linbuf0, **linbuf1;
     GNULineRef alloc_lines0, alloc_lines1;
     GNULineRef buffered_prefix, prefix_count, prefix_mask;
     GNULineRef middle_guess, suffix_guess;
     if(no_diff_means_no_output && context < (GNULineRef)(GNULINEREF_MAX / 4) && context < (GNULineRef)(n0))
     {
-        middle_guess = guess_lines(0, 0, p0 - filevec[0].prefix_end);
+        middle_guess = guess_lines(0, 0, p0 - (const CharT *)filevec[0].prefix_end);
         suffix_guess = guess_lines(0, 0, buffer0 + n0 - p0);
         for(prefix_count = 1; prefix_count <= context; prefix_count *= 2)
             continue;
@@ -426,13 +428,13 @@ void GnuDiff::find_identical_ends(file_data filevec[])
 
     prefix_mask = prefix_count - 1;
     GNULineRef lines = 0;
-    linbuf0 = (const QChar **)xmalloc(alloc_lines0 * sizeof(size_t));
+    linbuf0 = (const void **)xmalloc(alloc_lines0 * sizeof(size_t));
     p0 = buffer0;
 
     /* If the prefix is needed, find the prefix lines.  */
     if(!(no_diff_means_no_output && filevec[0].prefix_end == p0 && filevec[1].prefix_end == p1))
     {
-        end0 = filevec[0].prefix_end;
+        end0 = (const CharT *)filevec[0].prefix_end;
         while(p0 != end0)
         {
             GNULineRef l = lines++ & prefix_mask;
@@ -441,7 +443,7 @@ void GnuDiff::find_identical_ends(file_data filevec[])
                 if((GNULineRef)(GNULINEREF_MAX / (2 * sizeof(size_t))) <= alloc_lines0)
                     xalloc_die();
                 alloc_lines0 *= 2;
-                linbuf0 = (const QChar **)xrealloc(linbuf0, alloc_lines0 * sizeof(size_t));
+                linbuf0 = (const void **)xrealloc(linbuf0, alloc_lines0 * sizeof(size_t));
             }
             linbuf0[l] = p0;
             while(p0 < pEnd0 && !Utils::isEndOfLine(*p0++))
@@ -452,12 +454,12 @@ void GnuDiff::find_identical_ends(file_data filevec[])
 
     /* Allocate line buffer 1.  */
 
-    middle_guess = guess_lines(lines, p0 - buffer0, p1 - filevec[1].prefix_end);
+    middle_guess = guess_lines(lines, p0 - buffer0, p1 - (const CharT *)filevec[1].prefix_end);
     suffix_guess = guess_lines(lines, p0 - buffer0, buffer1 + n1 - p1);
     alloc_lines1 = buffered_prefix + middle_guess + std::min(context, suffix_guess);
     if(alloc_lines1 < buffered_prefix || (GNULineRef)(GNULINEREF_MAX / sizeof(size_t)) <= alloc_lines1)
         xalloc_die();
-    linbuf1 = (const QChar **)xmalloc(alloc_lines1 * sizeof(size_t));
+    linbuf1 = (const void **)xmalloc(alloc_lines1 * sizeof(size_t));
 
     GNULineRef i;
     if(buffered_prefix != lines)
@@ -471,7 +473,7 @@ void GnuDiff::find_identical_ends(file_data filevec[])
 
     /* Initialize line buffer 1 from line buffer 0.  */
     for(i = 0; i < buffered_prefix; ++i)
-        linbuf1[i] = linbuf0[i] - buffer0 + buffer1;
+        linbuf1[i] = (const CharT *)linbuf0[i] - buffer0 + buffer1;
 
     /* Record the line buffer, adjusted so that
      linbuf[0] points at the first differing line.  */
@@ -507,7 +509,13 @@ bool GnuDiff::read_files(file_data filevec[], bool /*pretend_binary*/)
 {
     GNULineRef i;
 
-    find_identical_ends(filevec);
+    const bool bLatin1 = filevec[0].latin1Buffer != nullptr;
+    assert(bLatin1 == (filevec[1].latin1Buffer != nullptr));
+
+    if(bLatin1)
+        find_identical_ends<char>(filevec);
+    else
+        find_identical_ends<QChar>(filevec);
 
     equivs_alloc = filevec[0].alloc_lines + filevec[1].alloc_lines + 1;
     if((GNULineRef)(GNULINEREF_MAX / sizeof(*equivs)) <= equivs_alloc)
@@ -529,12 +537,17 @@ bool GnuDiff::read_files(file_data filevec[], bool /*pretend_binary*/)
     buckets++;
 
     for(i = 0; i < 2; ++i)
-        find_and_hash_each_line(&filevec[i]);
+    {
+        if(bLatin1)
+            find_and_hash_each_line<char>(&filevec[i]);
+        else
+            find_and_hash_each_line<QChar>(&filevec[i]);
+    }
 
     filevec[0].equiv_max = filevec[1].equiv_max = equivs_index;
 
-    free(equivs);
-    free(buckets - 1);
+    xfree(equivs);
+    xfree(buckets - 1);
 
     return false;
 }
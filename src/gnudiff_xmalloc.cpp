@@ -17,6 +17,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <vector>
+
 #ifndef EXIT_FAILURE
 #define EXIT_FAILURE 1
 #endif
@@ -36,14 +39,136 @@ void GnuDiff::xalloc_die()
     exit(EXIT_FAILURE);
 }
 
-/* Allocate N bytes of memory dynamically, with error checking.  */
+namespace {
+/* Standard size blocks of finished comparisons on this thread.  */
+struct SpareBlocks {
+    static constexpr size_t max = 16;
+    std::vector<char *> blocks;
+
+    ~SpareBlocks()
+    {
+        for(char *b: blocks)
+            free(b);
+    }
+};
+
+thread_local SpareBlocks spareBlocks;
+} // namespace
+
+GnuDiffArena::~GnuDiffArena()
+{
+    for(const Block &b: blocks)
+    {
+        if(!b.bDedicated && spareBlocks.blocks.size() < SpareBlocks::max)
+            spareBlocks.blocks.push_back(b.data);
+        else
+            free(b.data);
+    }
+}
+
+void *GnuDiffArena::allocate(size_t n)
+{
+    const size_t need = headerSize + roundUp(n);
+    char *p;
+
+    if(need > blockSize / 4)
+    {
+        /* Big ones get a block of their own that can be resized and released.
+       It goes in front of the current block, which is still being filled.  */
+        p = (char *)malloc(need);
+        if(p == nullptr)
+            return nullptr;
+        blocks.insert(blocks.empty() ? blocks.end() : blocks.end() - 1, {p, need, need, true});
+    }
+    else
+    {
+        if(blocks.empty() || blocks.back().bDedicated || blocks.back().size - blocks.back().used < need)
+        {
+            char *data;
+            if(!spareBlocks.blocks.empty())
+            {
+                data = spareBlocks.blocks.back();
+                spareBlocks.blocks.pop_back();
+            }
+            else if((data = (char *)malloc(blockSize)) == nullptr)
+                return nullptr;
+            blocks.push_back({data, blockSize, 0, false});
+        }
+
+        Block &b = blocks.back();
+        p = b.data + b.used;
+        b.used += need;
+    }
+
+    p += headerSize;
+    sizeOf(p) = n;
+    return p;
+}
+
+std::vector<GnuDiffArena::Block>::iterator GnuDiffArena::findDedicated(void *p)
+{
+    return std::find_if(blocks.begin(), blocks.end(), [p](const Block &b) { return b.bDedicated && b.data + headerSize == p; });
+}
+
+void *GnuDiffArena::reallocate(void *p, size_t n)
+{
+    if(p == nullptr)
+        return allocate(n);
+
+    const size_t old = sizeOf(p);
+    if(headerSize + roundUp(n) > blockSize / 4)
+    {
+        auto it = findDedicated(p);
+        if(it != blocks.end())
+        {
+            char *data = (char *)realloc(it->data, headerSize + roundUp(n));
+            if(data == nullptr)
+                return nullptr;
+            it->data = data;
+            it->size = it->used = headerSize + roundUp(n);
+            sizeOf(data + headerSize) = n;
+            return data + headerSize;
+        }
+    }
+    else if(!blocks.empty() && !blocks.back().bDedicated)
+    {
+        /* The last allocation of the current block can grow in place.  */
+        Block &b = blocks.back();
+        if((char *)p + roundUp(old) == b.data + b.used && b.used - roundUp(old) + roundUp(n) <= b.size)
+        {
+            b.used = b.used - roundUp(old) + roundUp(n);
+            sizeOf(p) = n;
+            return p;
+        }
+    }
+
+    void *q = allocate(n);
+    if(q == nullptr)
+        return nullptr;
+    memcpy(q, p, std::min(old, n));
+    release(p);
+    return q;
+}
+
+void GnuDiffArena::release(void *p)
+{
+    if(p == nullptr || headerSize + roundUp(sizeOf(p)) <= blockSize / 4)
+        return;
+
+    auto it = findDedicated(p);
+    if(it != blocks.end())
+    {
+        free(it->data);
+        blocks.erase(it);
+    }
+}
+
+/* Allocate N bytes of memory from the arena, with error checking.  */
 
 void *
 GnuDiff::xmalloc(size_t n)
 {
-    void *p;
-
-    p = malloc(n == 0 ? 1 : n); // There are systems where malloc returns 0 for n==0.
+    void *p = arena.allocate(n);
     if(p == nullptr)
         xalloc_die();
     return p;
@@ -55,12 +180,20 @@ GnuDiff::xmalloc(size_t n)
 void *
 GnuDiff::xrealloc(void *p, size_t n)
 {
-    p = realloc(p, n == 0 ? 1 : n);
+    p = arena.reallocate(p, n);
     if(p == nullptr)
         xalloc_die();
     return p;
 }
 
+/* Give memory back early.  Everything else goes with the arena.  */
+
+void
+GnuDiff::xfree(void *p)
+{
+    arena.release(p);
+}
+
 /* Yield a new block of SIZE bytes, initialized to zero.  */
 
 void *
@@ -173,7 +173,18 @@ KDiff3App::KDiff3App(QWidget* pParent, const QString& name, KDiff3Shell* pKDiff3
         }
         else
         {
-            s = m_pOptionDialog->parseOptions(KDiff3Shell::parser->values("cs"));
+            QStringList configSettings = KDiff3Shell::parser->values("cs");
+            if(KDiff3Shell::parser->isSet("diff-algorithm"))
+            {
+                const QString algorithm = KDiff3Shell::parser->value("diff-algorithm");
+                if(algorithm == u"gnu")
+                    configSettings.append(QStringLiteral("DiffAlgorithm=%1").arg((qint32)eDiffAlgorithmGnuDiff));
+                else if(algorithm == u"histogram")
+                    configSettings.append(QStringLiteral("DiffAlgorithm=%1").arg((qint32)eDiffAlgorithmHistogram));
+                else
+                    s = i18n("Unknown diff algorithm \"%1\".", algorithm) + u'\n';
+            }
+            s += m_pOptionDialog->parseOptions(configSettings);
             title = i18n("Config Option Error:");
         }
         if(!s.isEmpty())
@@ -665,13 +676,15 @@ void KDiff3App::completeInit()
                 if(pSD != nullptr)
                 {
                     // Save this file directly, not via the merge result window.
+                    // Read before the backup renames the output away, it may be the input itself.
+                    bSuccess = pSD->loadRawData();
                     FileAccess fa(m_outputFilename);
-                    if(gOptions->m_bDmCreateBakFiles && fa.exists())
+                    if(bSuccess && gOptions->m_bDmCreateBakFiles && fa.exists())
                     {
                         fa.createBackup(".orig");
                     }
 
-                    bSuccess = pSD->saveNormalDataAs(m_outputFilename);
+                    bSuccess = bSuccess && pSD->saveNormalDataAs(m_outputFilename);
                     if(!bSuccess)
                         KMessageBox::error(this, i18n("Saving failed."));
                 }
@@ -315,6 +315,7 @@ public Q_SLOTS:
 
   private:
     void mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFlags = InitFlag::defaultFlags);
+    void loadInputs(const bool bUseCurrentEncoding);
     void resetDiffData();
     void mainWindowEnable(bool bEnable);
     void wheelEvent(QWheelEvent* pWheelEvent) override;
@@ -428,6 +429,10 @@ public Q_SLOTS:
     Diff3LineList m_diff3LineList;
     Diff3LineVector mDiff3LineVector;
     ManualDiffHelpList m_manualDiffHelpList;
+    // Diffs between the manual alignments, kept until the inputs are loaded again.
+    DiffSegmentCache mDiffCache12;
+    DiffSegmentCache mDiffCache23;
+    DiffSegmentCache mDiffCache13;
 
     LineType m_neededLines = 0;
     LineType m_DTWHeight = 0;
@@ -440,6 +445,7 @@ public Q_SLOTS:
 
     bool m_bFinishMainInit = false;
     bool m_bLoadFiles = false;
+    bool m_bUsedFastDiff = false; // The fast mode for large files was needed for the last diff.
 
     KDiff3Shell* m_pKDiff3Shell = nullptr;
     bool m_bAutoFlag = false;
@@ -9,6 +9,8 @@
 // clang-format on
 
 #include "kdiff3_shell.h"
+#include "options.h"
+#include "StreamingDiff.h"
 #include "TypeUtils.h"
 #include "version.h"
 
@@ -74,12 +76,87 @@ void initialiseCmdLineArgs(QCommandLineParser* cmdLineParser)
     }
 }
 
+/*
+    Handles --stream without creating any windows. Exit codes are those of diff: 0 if the files are equal,
+    1 if they differ and 2 on trouble.
+*/
+qint32 runStreamingDiff(const QCommandLineParser* cmdLineParser)
+{
+    QTextStream errorStream(stderr);
+
+    QStringList files = cmdLineParser->positionalArguments();
+    if(cmdLineParser->isSet("base"))
+        files.prepend(cmdLineParser->value("base"));
+    if(files.count() != 2)
+    {
+        errorStream << i18n("Option --stream needs exactly two files.") << "\n";
+        return 2;
+    }
+
+    qint64 windowSize = StreamingDiff::defaultWindowSize;
+    if(cmdLineParser->isSet("stream-window"))
+    {
+        bool bOk = false;
+        const QString value = cmdLineParser->value("stream-window");
+        const qint64 mebibytes = value.toLongLong(&bOk);
+        if(!bOk || mebibytes <= 0 || mebibytes > 1024 * 1024)
+        {
+            errorStream << i18n("Invalid window size \"%1\".", value) << "\n";
+            return 2;
+        }
+        windowSize = mebibytes * 1024 * 1024;
+    }
+
+    const QString algorithm = cmdLineParser->value("diff-algorithm");
+    if(algorithm == u"histogram")
+        gOptions->mDiffAlgorithm = eDiffAlgorithmHistogram;
+    else if(!algorithm.isEmpty() && algorithm != u"gnu")
+    {
+        errorStream << i18n("Unknown diff algorithm \"%1\".", algorithm) << "\n";
+        return 2;
+    }
+
+    QString outputName = cmdLineParser->value("output");
+    if(outputName.isEmpty())
+        outputName = cmdLineParser->value("out");
+
+    QFile out;
+    bool bOpened;
+    if(outputName.isEmpty())
+        bOpened = out.open(stdout, QIODevice::WriteOnly);
+    else
+    {
+        out.setFileName(outputName);
+        bOpened = out.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    if(!bOpened)
+    {
+        errorStream << i18n("Could not open \"%1\" for writing: %2", outputName, out.errorString()) << "\n";
+        return 2;
+    }
+
+    StreamingDiff streamingDiff(files[0], files[1], windowSize);
+    if(!streamingDiff.run(out))
+    {
+        errorStream << streamingDiff.errorString() << "\n";
+        return 2;
+    }
+    return streamingDiff.hasDifferences() ? 1 : 0;
+}
+
 qint32 main(qint32 argc, char* argv[])
 {
     constexpr QLatin1String appName("kdiff3");
     //Synchronize qt HiDPI behavior on all versions/platforms
     QGuiApplication::setHighDpiScaleFactorRoundingPolicy(Qt::HighDpiScaleFactorRoundingPolicy::PassThrough);
 
+    // --stream runs without GUI, also where there is no display.
+    for(qint32 i = 1; i < argc; ++i)
+    {
+        if(qstrcmp(argv[i], "--stream") == 0 && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     QApplication app(argc, argv); // KAboutData and QCommandLineParser depend on this being setup.
     KLocalizedString::setApplicationDomain(appName.data());
 
@@ -129,7 +206,10 @@ qint32 main(qint32 argc, char* argv[])
     cmdLineParser->addOption(QCommandLineOption({u8"L", u8"fname"}, i18n("Alternative visible name replacement. Supply this once for every input."), u8"alias"));
     cmdLineParser->addOption(QCommandLineOption(u8"cs", i18n("Override a config setting. Use once for every setting. E.g.: --cs \"AutoAdvance=1\""), u8"string"));
     cmdLineParser->addOption(QCommandLineOption(u8"confighelp", i18n("Show list of config settings and current values.")));
+    cmdLineParser->addOption(QCommandLineOption(u8"diff-algorithm", i18n("Line matching algorithm: \"gnu\" or \"histogram\". Same as --cs \"DiffAlgorithm=...\"."), u8"name"));
     cmdLineParser->addOption(QCommandLineOption(u8"config", i18n("Use a different config file."), u8"file"));
+    cmdLineParser->addOption(QCommandLineOption(u8"stream", i18n("Compare two files of any size without GUI, one window at a time. Writes the differences to the output file or stdout like diff does.")));
+    cmdLineParser->addOption(QCommandLineOption(u8"stream-window", i18n("Window size in MiB for --stream. Memory use is a few times this. Default: %1", StreamingDiff::defaultWindowSize / (1024 * 1024)), u8"MiB"));
 
     // other command options
     cmdLineParser->addPositionalArgument(u8"[File1]", i18n("file1 to open (base, if not specified via --base)"));
@@ -178,6 +258,9 @@ qint32 main(qint32 argc, char* argv[])
 
     aboutData.processCommandLine(cmdLineParser);
 
+    if(cmdLineParser->isSet("stream"))
+        return runStreamingDiff(cmdLineParser);
+
     /*
         This short segment is wrapped in a lambda to delay KDiff3Shell construction until
         after the main event loop starts. Thus allowing us to avoid std::exit as much as
@@ -10,34 +10,31 @@
 
 #include "merger.h"
 
-#include <list>
-#include <memory>
-
-Merger::Merger(const std::shared_ptr<const DiffList>& pDiffList1, const std::shared_ptr<const DiffList>& pDiffList2):
-    md1(pDiffList1, 0), md2(pDiffList2, 1)
+Merger::Merger(const FineDiffRange& fineDiff1, const FineDiffRange& fineDiff2):
+    md1(fineDiff1, 0), md2(fineDiff2, 1)
 {
 }
 
-Merger::MergeData::MergeData(const std::shared_ptr<const DiffList>& p, qint32 i)
+Merger::MergeData::MergeData(const FineDiffRange& inFineDiff, qint32 i)
 {
     idx = i;
-    pDiffList = p;
-    if(p != nullptr)
+    fineDiff = inFineDiff;
+    if(!fineDiff.isNull())
     {
-        it = p->begin();
+        it = fineDiff.begin();
         update();
     }
 }
 
 bool Merger::MergeData::eq() const
 {
-    return pDiffList == nullptr || d.numberOfEquals() > 0;
+    return fineDiff.isNull() || d.numberOfEquals() > 0;
 }
 
 bool Merger::MergeData::isEnd() const
 {
-    return (pDiffList == nullptr || (it == pDiffList->end() && d.numberOfEquals() == 0 &&
-                                     (idx == 0 ? d.diff1() == 0 : d.diff2() == 0)));
+    return (fineDiff.isNull() || (it == fineDiff.end() && d.numberOfEquals() == 0 &&
+                                  (idx == 0 ? d.diff1() == 0 : d.diff2() == 0)));
 }
 
 void Merger::MergeData::update()
@@ -49,9 +46,9 @@ void Merger::MergeData::update()
     else if(idx == 1 && d.diff2() > 0)
         d.adjustDiff2(-1);
 
-    while(d.numberOfEquals() == 0 && ((idx == 0 && d.diff1() == 0) || (idx == 1 && d.diff2() == 0)) && pDiffList != nullptr && it != pDiffList->end())
+    while(d.numberOfEquals() == 0 && ((idx == 0 && d.diff1() == 0) || (idx == 1 && d.diff2() == 0)) && !fineDiff.isNull() && it != fineDiff.end())
     {
-        d = *it;
+        d = Diff(it->nofEquals, it->diff1, it->diff2);
         ++it;
     }
 }
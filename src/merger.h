@@ -13,12 +13,10 @@
 
 #include "diff.h"
 
-#include <memory>
-
 class Merger
 {
   public:
-    Merger(const std::shared_ptr<const DiffList>& pDiffList1, const std::shared_ptr<const DiffList>& pDiffList2);
+    Merger(const FineDiffRange& fineDiff1, const FineDiffRange& fineDiff2);
 
     /** Go one step. */
     void next();
@@ -37,13 +35,13 @@ class Merger
     class MergeData
     {
       private:
-        DiffList::const_iterator it;
-        std::shared_ptr<const DiffList> pDiffList;
+        const FineDiffRun* it = nullptr;
+        FineDiffRange fineDiff;
         Diff d;
         qint32 idx;
 
       public:
-        MergeData(const std::shared_ptr<const DiffList>& p, qint32 i);
+        MergeData(const FineDiffRange& inFineDiff, qint32 i);
         [[nodiscard]] bool eq() const;
         void update();
         [[nodiscard]] bool isEnd() const;
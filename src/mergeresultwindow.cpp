@@ -356,24 +356,7 @@ void MergeResultWindow::merge(bool bAutoSolve, e_SrcSelector defaultSelector, bo
             Q_EMIT noRelevantChangesDetected();
     }
 
-    qint32 nrOfSolvedConflicts = 0;
-    qint32 nrOfUnsolvedConflicts = 0;
-    qint32 nrOfWhiteSpaceConflicts = 0;
-
-    for(const MergeBlock& mb: m_mergeBlockList)
-    {
-        if(mb.isConflict())
-            ++nrOfUnsolvedConflicts;
-        else if(mb.isDelta())
-            ++nrOfSolvedConflicts;
-
-        if(mb.isWhiteSpaceConflict())
-            ++nrOfWhiteSpaceConflicts;
-    }
-
-    m_pTotalDiffStatus->setUnsolvedConflicts(nrOfUnsolvedConflicts);
-    m_pTotalDiffStatus->setSolvedConflicts(nrOfSolvedConflicts);
-    m_pTotalDiffStatus->setWhitespaceConflicts(nrOfWhiteSpaceConflicts);
+    m_mergeBlockList.countConflicts(*m_pTotalDiffStatus);
 
     m_cursorXPos = 0;
     m_cursorOldXPixelPos = 0;
@@ -866,6 +866,19 @@ void OptionDialog::setupDiffPage()
     label->setToolTip(i18nc("Tool Tip", "This pre-processor is only used during line matching.\n(See the docs for details.)"));
     ++line;
 
+    label = new QLabel(i18n("Line matching algorithm:"), page);
+    gbox->addWidget(label, line, 0);
+    OptionComboBox* pDiffAlgorithm = new OptionComboBox(eDiffAlgorithmGnuDiff, "DiffAlgorithm", (qint32*)&gOptions->mDiffAlgorithm, page);
+    gbox->addWidget(pDiffAlgorithm, line, 1);
+    pDiffAlgorithm->insertItem(eDiffAlgorithmGnuDiff, i18n("GNU diff"));
+    pDiffAlgorithm->insertItem(eDiffAlgorithmHistogram, i18n("Histogram"));
+
+    label->setToolTip(i18nc("Tool Tip",
+        "GNU diff finds a minimal set of changes.\n"
+        "Histogram aligns lines that occur rarely first. This is often faster and gives\n"
+        "better results for moved or generated code. (Default is GNU diff.)"));
+    ++line;
+
     OptionCheckBox* pTryHard = new OptionCheckBox(i18n("Try hard (slower)"), true, "TryHard", &gOptions->m_bTryHard, page);
     gbox->addWidget(pTryHard, line, 0, 1, 2);
 
@@ -874,6 +887,24 @@ void OptionDialog::setupDiffPage()
         "The analysis of big files will be much slower."));
     ++line;
 
+    OptionCheckBox* pFastLargeFiles = new OptionCheckBox(i18n("Fast mode for large files"), true, "FastLargeFiles", &gOptions->mFastLargeFiles, page);
+    gbox->addWidget(pFastLargeFiles, line, 0, 1, 2);
+
+    pFastLargeFiles->setToolTip(i18nc("Tool Tip",
+        "Use faster heuristics for very large files or files with very many changes,\n"
+        "even if \"Try hard\" is enabled. The result might not be the smallest set of changes.\n"
+        "The status bar tells when this happened."));
+    ++line;
+
+    OptionCheckBox* pAnchoredDiff = new OptionCheckBox(i18n("Split large files at unique lines"), true, "AnchoredDiff", &gOptions->mAnchoredDiff, page);
+    gbox->addWidget(pAnchoredDiff, line, 0, 1, 2);
+
+    pAnchoredDiff->setToolTip(i18nc("Tool Tip",
+        "Split very large files at lines that occur only once in both files\n"
+        "and compare the parts on several processor cores at the same time.\n"
+        "Moved lines across the split points are not found."));
+    ++line;
+
     OptionCheckBox* pDiff3AlignBC = new OptionCheckBox(i18n("Align B and C for 3 input files"), false, "Diff3AlignBC", &gOptions->m_bDiff3AlignBC, page);
     gbox->addWidget(pDiff3AlignBC, line, 0, 1, 2);
 
@@ -883,6 +914,24 @@ void OptionDialog::setupDiffPage()
         "(Default is off.)"));
     ++line;
 
+    OptionCheckBox* pCompactTextStorage = new OptionCheckBox(i18n("Compact storage for 8-bit text"), true, "CompactTextStorage", &gOptions->mCompactTextStorage, page);
+    gbox->addWidget(pCompactTextStorage, line, 0, 1, 2);
+
+    pCompactTextStorage->setToolTip(i18nc("Tool Tip",
+        "Keep files that only contain Latin-1 characters as 8-bit text.\n"
+        "This halves the memory needed and speeds up the comparison.\n"
+        "(Default is on.)"));
+    ++line;
+
+    OptionCheckBox* pLazyFineDiff = new OptionCheckBox(i18n("Calculate character differences on demand"), true, "LazyFineDiff", &gOptions->mLazyFineDiff, page);
+    gbox->addWidget(pLazyFineDiff, line, 0, 1, 2);
+
+    pLazyFineDiff->setToolTip(i18nc("Tool Tip",
+        "Show the result as soon as the lines are aligned and find the differences\n"
+        "within changed lines in the background or when they are first shown.\n"
+        "(Default is on.)"));
+    ++line;
+
     topLayout->addStretch(10);
 }
 
@@ -1236,6 +1285,15 @@ void OptionDialog::setupDirectoryMergePage()
 
     ++line;
 
+    OptionCheckBox* pHashCache = new OptionCheckBox(i18n("Remember file contents between comparisons"), true, "HashCache", &gOptions->m_bDmHashCache, page);
+    gbox->addWidget(pHashCache, line, 0, 1, 2);
+
+    pHashCache->setToolTip(i18nc("Tool Tip",
+        "Keeps a hash of each compared local file in the cache folder.\n"
+        "Files unchanged since then are compared without reading them again.\n"
+        "Only used by the binary comparison."));
+    ++line;
+
     // Some two Dir-options: Affects only the default actions.
     OptionCheckBox* pSyncMode = new OptionCheckBox(i18n("Synchronize folders"), false, "SyncMode", &gOptions->m_bDmSyncMode, page);
 
@@ -43,6 +43,13 @@ enum e_LineEndStyle
     eLineEndStyleConflict   // User must resolve manually
 };
 
+// Line matching engine used by DiffList::runDiff.
+enum e_DiffAlgorithm
+{
+    eDiffAlgorithmGnuDiff = 0,
+    eDiffAlgorithmHistogram
+};
+
 class Options
 {
   public:
@@ -188,6 +195,11 @@ class Options
     bool m_bHorizDiffWindowSplitting = true;
     bool m_bShowInfoDialogs = true;
     bool m_bDiff3AlignBC = false;
+    bool mCompactTextStorage = true;
+    bool mLazyFineDiff = true;
+    e_DiffAlgorithm mDiffAlgorithm = eDiffAlgorithmGnuDiff;
+    bool mFastLargeFiles = true;
+    bool mAnchoredDiff = true;
 
     qint32  m_whiteSpace2FileMergeDefault = 0;
     qint32  m_whiteSpace3FileMergeDefault = 0;
@@ -230,6 +242,7 @@ class Options
     bool m_bDmTrustDate = false;
     bool m_bDmTrustDateFallbackToBinary = false;
     bool m_bDmTrustSize = false;
+    bool m_bDmHashCache = true;
     bool m_bDmCopyNewer = false;
     //bool m_bDmShowOnlyDeltas;
     bool m_bDmShowIdenticalFiles = true;
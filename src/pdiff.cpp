@@ -18,6 +18,7 @@
 #include "kdiff3_shell.h"
 #include "Logging.h"
 #include "optiondialog.h"
+#include "Parallel.h"
 #include "progress.h"
 #include "Utils.h"
 
@@ -25,6 +26,7 @@
 #include "smalldialogs.h"
 
 #include <algorithm>
+#include <array>
 #include <cstdio>
 #include <list>
 #include <typeinfo>
@@ -69,6 +71,51 @@ void KDiff3App::resetDiffData()
     m_diff3LineList.clear();
     mDiff3LineVector.clear();
     m_manualDiffHelpList.clear();
+    mDiffCache12.clear();
+    mDiffCache23.clear();
+    mDiffCache13.clear();
+}
+
+/*
+    Reads A, B and C if given. The files are independent of each other so they are loaded at the same time
+    unless a preprocessor command is set or a file needs KIO. Both have to run on the GUI thread, KIO jobs need
+    its event loop and a failing preprocessor command disables itself in gOptions.
+*/
+void KDiff3App::loadInputs(const bool bUseCurrentEncoding)
+{
+    const std::array<std::shared_ptr<SourceData>, 3> sources = {m_sd1, m_sd2, m_sd3};
+    const std::array<QByteArray, 3> encodings = {gOptions->mEncodingA, gOptions->mEncodingB, gOptions->mEncodingC};
+    const std::array<bool, 3> autoDetect = {gOptions->mAutoDetectA, gOptions->mAutoDetectB, gOptions->mAutoDetectC};
+    const std::array<QString, 3> messages = {i18nc("Status message", "Loading A: %1", m_sd1->getFilename()),
+                                             i18nc("Status message", "Loading B: %1", m_sd2->getFilename()),
+                                             i18nc("Status message", "Loading C: %1", m_sd3->getFilename())};
+    const qsizetype count = m_sd3->isEmpty() ? 2 : 3;
+
+    auto load = [&](const qsizetype i) {
+        qCInfo(kdiffMain) << messages[i];
+
+        if(bUseCurrentEncoding)
+            sources[i]->readAndPreprocess(sources[i]->getEncoding(), false);
+        else
+            sources[i]->readAndPreprocess(encodings[i], autoDetect[i]);
+    };
+
+    const bool bParallel = gOptions->m_PreProcessorCmd.isEmpty() && gOptions->m_LineMatchingPreProcessorCmd.isEmpty() &&
+                           std::all_of(sources.cbegin(), sources.cbegin() + count, [](const std::shared_ptr<SourceData>& sd) { return sd->isLocal(); });
+    if(bParallel)
+    {
+        ProgressProxy::setInformation(i18nc("Status message", "Loading input files"));
+        Parallel::forEach(count, load);
+    }
+    else
+    {
+        for(qsizetype i = 0; i < count; ++i)
+        {
+            ProgressProxy::setInformation(messages[i]);
+            load(i);
+            ProgressProxy::step();
+        }
+    }
 }
 
 void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFlags)
@@ -133,25 +180,8 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
             ProgressProxy::setMaxNofSteps(9); // Read 3 files, 3 comparisons, 3 finediffs
 
         // First get all input data.
-        ProgressProxy::setInformation(i18nc("Status message", "Loading A: %1", m_sd1->getFilename()));
-        qCInfo(kdiffMain) << "Loading A: " << m_sd1->getFilename();
-
-        if(bUseCurrentEncoding)
-            m_sd1->readAndPreprocess(m_sd1->getEncoding(), false);
-        else
-            m_sd1->readAndPreprocess(gOptions->mEncodingA, gOptions->mAutoDetectA);
-
-        ProgressProxy::step();
-
-        ProgressProxy::setInformation(i18nc("Status message", "Loading B: %1", m_sd2->getFilename()));
-        qCInfo(kdiffMain) << "Loading B: " << m_sd2->getFilename();
-
-        if(bUseCurrentEncoding)
-            m_sd2->readAndPreprocess(m_sd2->getEncoding(), false);
-        else
-            m_sd2->readAndPreprocess(gOptions->mEncodingB, gOptions->mAutoDetectB);
+        loadInputs(bUseCurrentEncoding);
 
-        ProgressProxy::step();
         mErrors.append(m_sd1->getErrors());
         mErrors.append(m_sd2->getErrors());
     }
@@ -167,6 +197,7 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
     }
 
     pTotalDiffStatus->reset();
+    m_bUsedFastDiff = false;
 
     if(mErrors.isEmpty() && !bFirstRun)
     {
@@ -181,7 +212,8 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
                 {
                     ProgressProxy::setInformation(i18nc("Status message", "Diff: A <-> B"));
                     qCInfo(kdiffMain) << "Diff: A <-> B";
-                    m_manualDiffHelpList.runDiff(m_sd1->getLineDataForDiff(), m_sd1->lineCount(), m_sd2->getLineDataForDiff(), m_sd2->lineCount(), m_diffList12, e_SrcSelector::A, e_SrcSelector::B);
+                    m_manualDiffHelpList.runDiff(m_sd1->getLineDataForDiff(), m_sd1->lineCount(), m_sd2->getLineDataForDiff(), m_sd2->lineCount(), m_diffList12, e_SrcSelector::A, e_SrcSelector::B, &mDiffCache12);
+                    m_bUsedFastDiff = m_diffList12.usedFastMode();
 
                     ProgressProxy::step();
 
@@ -202,61 +234,44 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
             }
             else
             {
-                if(bLoadFiles)
-                {
-                    ProgressProxy::setInformation(i18nc("Status message", "Loading C: %1", m_sd3->getFilename()));
-                    qCInfo(kdiffMain) << "Loading C: " << m_sd3->getFilename();
-
-                    if(bUseCurrentEncoding)
-                        m_sd3->readAndPreprocess(m_sd3->getEncoding(), false);
-                    else
-                        m_sd3->readAndPreprocess(gOptions->mEncodingC, gOptions->mAutoDetectC);
-
-                    ProgressProxy::step();
-                }
-
                 pTotalDiffStatus->setBinaryEqualAB(m_sd1->isBinaryEqualWith(m_sd2));
                 pTotalDiffStatus->setBinaryEqualAC(m_sd1->isBinaryEqualWith(m_sd3));
                 pTotalDiffStatus->setBinaryEqualBC(m_sd3->isBinaryEqualWith(m_sd2));
 
-                ProgressProxy::setInformation(i18nc("Status message", "Diff: A <-> B"));
-                qCInfo(kdiffMain) << "Diff: A <-> B";
-
-                if(m_sd1->isText() && m_sd2->isText())
-                {
-                    m_manualDiffHelpList.runDiff(m_sd1->getLineDataForDiff(), m_sd1->lineCount(), m_sd2->getLineDataForDiff(), m_sd2->lineCount(), m_diffList12, e_SrcSelector::A, e_SrcSelector::B);
-
+                ProgressProxy::setInformation(i18nc("Status message", "Diff: A <-> B, A <-> C, B <-> C"));
+                qCInfo(kdiffMain) << "Diff: A <-> B, A <-> C, B <-> C";
+
+                const bool bTextAB = m_sd1->isText() && m_sd2->isText();
+                const bool bTextAC = m_sd1->isText() && m_sd3->isText();
+                const bool bTextBC = m_sd2->isText() && m_sd3->isText();
+
+                // The three comparisons don't depend on each other, only combining them below has to be done in order.
+                Parallel::forEach(3, [&](const qsizetype i) {
+                    if(i == 0 && bTextAB)
+                        m_manualDiffHelpList.runDiff(m_sd1->getLineDataForDiff(), m_sd1->lineCount(), m_sd2->getLineDataForDiff(), m_sd2->lineCount(), m_diffList12, e_SrcSelector::A, e_SrcSelector::B, &mDiffCache12);
+                    else if(i == 1 && bTextAC)
+                        m_manualDiffHelpList.runDiff(m_sd1->getLineDataForDiff(), m_sd1->lineCount(), m_sd3->getLineDataForDiff(), m_sd3->lineCount(), m_diffList13, e_SrcSelector::A, e_SrcSelector::C, &mDiffCache13);
+                    else if(i == 2 && bTextBC)
+                        m_manualDiffHelpList.runDiff(m_sd2->getLineDataForDiff(), m_sd2->lineCount(), m_sd3->getLineDataForDiff(), m_sd3->lineCount(), m_diffList23, e_SrcSelector::B, e_SrcSelector::C, &mDiffCache23);
+                });
+                m_bUsedFastDiff = (bTextAB && m_diffList12.usedFastMode()) || (bTextAC && m_diffList13.usedFastMode()) || (bTextBC && m_diffList23.usedFastMode());
+
+                if(bTextAB)
                     m_diff3LineList.calcDiff3LineListUsingAB(&m_diffList12);
-                }
-                ProgressProxy::step();
-
-                ProgressProxy::setInformation(i18nc("Status message", "Diff: A <-> C"));
-                qCInfo(kdiffMain) << "Diff: A <-> C";
 
-                if(m_sd1->isText() && m_sd3->isText())
+                if(bTextAC)
                 {
-                    m_manualDiffHelpList.runDiff(m_sd1->getLineDataForDiff(), m_sd1->lineCount(), m_sd3->getLineDataForDiff(), m_sd3->lineCount(), m_diffList13, e_SrcSelector::A, e_SrcSelector::C);
-
                     m_diff3LineList.calcDiff3LineListUsingAC(&m_diffList13);
                     m_diff3LineList.correctManualDiffAlignment(&m_manualDiffHelpList);
                     m_diff3LineList.calcDiff3LineListTrim(m_sd1->getLineDataForDiff(), m_sd2->getLineDataForDiff(), m_sd3->getLineDataForDiff(), &m_manualDiffHelpList);
                 }
-                ProgressProxy::step();
 
-                ProgressProxy::setInformation(i18nc("Status message", "Diff: B <-> C"));
-                qCInfo(kdiffMain) << "Diff: B <-> C";
-
-                if(m_sd2->isText() && m_sd3->isText())
+                if(bTextBC && gOptions->m_bDiff3AlignBC)
                 {
-                    m_manualDiffHelpList.runDiff(m_sd2->getLineDataForDiff(), m_sd2->lineCount(), m_sd3->getLineDataForDiff(), m_sd3->lineCount(), m_diffList23, e_SrcSelector::B, e_SrcSelector::C);
-                    if(gOptions->m_bDiff3AlignBC)
-                    {
-                        m_diff3LineList.calcDiff3LineListUsingBC(&m_diffList23);
-                        m_diff3LineList.correctManualDiffAlignment(&m_manualDiffHelpList);
-                        m_diff3LineList.calcDiff3LineListTrim(m_sd1->getLineDataForDiff(), m_sd2->getLineDataForDiff(), m_sd3->getLineDataForDiff(), &m_manualDiffHelpList);
-                    }
+                    m_diff3LineList.calcDiff3LineListUsingBC(&m_diffList23);
+                    m_diff3LineList.correctManualDiffAlignment(&m_manualDiffHelpList);
+                    m_diff3LineList.calcDiff3LineListTrim(m_sd1->getLineDataForDiff(), m_sd2->getLineDataForDiff(), m_sd3->getLineDataForDiff(), &m_manualDiffHelpList);
                 }
-                ProgressProxy::step();
 
                 if(!gOptions->m_bDiff3AlignBC)
                 {
@@ -265,43 +280,38 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
                     m_diff3LineList.debugLineCheck(m_sd3->lineCount(), e_SrcSelector::C);
                 }
 
+                // One fine diff per pair, the vector of lines is shared by all three.
+                Diff3LineVector d3lv;
+                m_diff3LineList.calcDiff3LineVector(d3lv);
+                const quint64 scheduledBefore = m_diff3LineList.scheduledFineDiffCount();
+                const quint64 diffedBefore = m_diff3LineList.fineDiffCount();
+
                 ProgressProxy::setInformation(i18nc("Status message", "Linediff: A <-> B"));
                 qCInfo(kdiffMain) << "Linediff: A <-> B";
                 if(m_sd1->hasData() && m_sd2->hasData() && m_sd1->isText() && m_sd2->isText())
-                    pTotalDiffStatus->setTextEqualAB(m_diff3LineList.fineDiff(e_SrcSelector::A, m_sd1->getLineDataForDisplay(), m_sd2->getLineDataForDisplay(), eIgnoreFlags));
+                    pTotalDiffStatus->setTextEqualAB(m_diff3LineList.fineDiff(d3lv, e_SrcSelector::A, m_sd1->getLineDataForDisplay(), m_sd2->getLineDataForDisplay(), eIgnoreFlags));
                 ProgressProxy::step();
 
                 ProgressProxy::setInformation(i18nc("Status message", "Linediff: B <-> C"));
                 qCInfo(kdiffMain) << "Linediff: B <-> C";
                 if(m_sd2->hasData() && m_sd3->hasData() && m_sd2->isText() && m_sd3->isText())
-                    pTotalDiffStatus->setTextEqualBC(m_diff3LineList.fineDiff(e_SrcSelector::B, m_sd2->getLineDataForDisplay(), m_sd3->getLineDataForDisplay(), eIgnoreFlags));
+                    pTotalDiffStatus->setTextEqualBC(m_diff3LineList.fineDiff(d3lv, e_SrcSelector::B, m_sd2->getLineDataForDisplay(), m_sd3->getLineDataForDisplay(), eIgnoreFlags));
                 ProgressProxy::step();
 
                 ProgressProxy::setInformation(i18nc("Status message", "Linediff: A <-> C"));
                 qCInfo(kdiffMain) << "Linediff: A <-> C";
                 if(m_sd1->hasData() && m_sd3->hasData() && m_sd1->isText() && m_sd3->isText())
-                    pTotalDiffStatus->setTextEqualAC(m_diff3LineList.fineDiff(e_SrcSelector::C, m_sd3->getLineDataForDisplay(), m_sd1->getLineDataForDisplay(), eIgnoreFlags));
-
-                if(!gOptions->m_bDiff3AlignBC)
-                {
-                    m_diff3LineList.debugLineCheck(m_sd2->lineCount(), e_SrcSelector::B);
-                    m_diff3LineList.debugLineCheck(m_sd3->lineCount(), e_SrcSelector::C);
-                }
-
-                ProgressProxy::setInformation(i18nc("Status message", "Linediff: A <-> B"));
-                if(m_sd1->hasData() && m_sd2->hasData() && m_sd1->isText() && m_sd2->isText())
-                    pTotalDiffStatus->setTextEqualAB(m_diff3LineList.fineDiff(e_SrcSelector::A, m_sd1->getLineDataForDisplay(), m_sd2->getLineDataForDisplay(), eIgnoreFlags));
+                    pTotalDiffStatus->setTextEqualAC(m_diff3LineList.fineDiff(d3lv, e_SrcSelector::C, m_sd3->getLineDataForDisplay(), m_sd1->getLineDataForDisplay(), eIgnoreFlags));
                 ProgressProxy::step();
 
-                ProgressProxy::setInformation(i18nc("Status message", "Linediff: B <-> C"));
-                if(m_sd3->hasData() && m_sd2->hasData() && m_sd3->isText() && m_sd2->isText())
-                    pTotalDiffStatus->setTextEqualBC(m_diff3LineList.fineDiff(e_SrcSelector::B, m_sd2->getLineDataForDisplay(), m_sd3->getLineDataForDisplay(), eIgnoreFlags));
-                ProgressProxy::step();
+                const quint64 scheduled = m_diff3LineList.scheduledFineDiffCount() - scheduledBefore;
+                const quint64 diffed = m_diff3LineList.fineDiffCount() - diffedBefore;
+                qCInfo(kdiffMain) << "Linediff: " << scheduled << " line pairs scheduled, " << diffed << " diffed";
+                // A pair scheduled twice would replace its fine diff and count once more.
+                assert(scheduled == m_diff3LineList.numberOfFineDiffs());
+                // Without lazy fine diffs every scheduled pair is diffed right away.
+                assert(gOptions->mLazyFineDiff || diffed == scheduled);
 
-                ProgressProxy::setInformation(i18nc("Status message", "Linediff: A <-> C"));
-                if(m_sd1->hasData() && m_sd3->hasData() && m_sd1->isText() && m_sd3->isText())
-                    pTotalDiffStatus->setTextEqualAC(m_diff3LineList.fineDiff(e_SrcSelector::C, m_sd3->getLineDataForDisplay(), m_sd1->getLineDataForDisplay(), eIgnoreFlags));
-                ProgressProxy::step();
                 if(m_sd1->getSizeBytes() == 0)
                 {
                     pTotalDiffStatus->setTextEqualAB(false);
@@ -347,6 +357,7 @@ void KDiff3App::mainInit(TotalDiffStatus* pTotalDiffStatus, const InitFlags inFl
 
         m_diff3LineList.calcWhiteDiff3Lines(m_sd1->getLineDataForDiff(), m_sd2->getLineDataForDiff(), m_sd3->getLineDataForDiff(), gOptions->ignoreComments());
         m_diff3LineList.calcDiff3LineVector(mDiff3LineVector);
+        m_diff3LineList.startFineDiffFill(mDiff3LineVector);
     }
 
     // Calc needed lines for display
@@ -658,6 +669,9 @@ void KDiff3App::slotFinishMainInit()
     {
         m_pDiffTextWindow1->setFocus();
     }
+
+    if(m_bUsedFastDiff)
+        slotStatusMsg(i18n("Fast mode for large files was used, the differences shown might not be minimal."));
 }
 
 void KDiff3App::resizeEvent(QResizeEvent* e)
@@ -128,6 +128,10 @@ void ProgressDialog::setStayHidden(bool bStayHidden)
 
 void ProgressDialog::push()
 {
+    // Only wasCancelled() is supported from worker threads, see Parallel.
+    if(!isGuiThread())
+        return;
+
     ProgressLevelData pld;
     if(!m_progressStack.empty())
     {
@@ -175,6 +179,9 @@ void ProgressDialog::endBackgroundTask()
 
 void ProgressDialog::pop(bool bRedrawUpdate)
 {
+    if(!isGuiThread())
+        return;
+
     if(!m_progressStack.empty())
     {
         m_progressStack.pop_back();
@@ -190,6 +197,9 @@ void ProgressDialog::pop(bool bRedrawUpdate)
 
 void ProgressDialog::setInformation(const QString& info, qint32 current, bool bRedrawUpdate)
 {
+    if(!isGuiThread())
+        return;
+
     if(m_progressStack.empty())
         return;
 
@@ -200,6 +210,9 @@ void ProgressDialog::setInformation(const QString& info, qint32 current, bool bR
 
 void ProgressDialog::setInformation(const QString& info, bool bRedrawUpdate)
 {
+    if(!isGuiThread())
+        return;
+
     if(m_progressStack.empty())
         return;
 
@@ -209,6 +222,9 @@ void ProgressDialog::setInformation(const QString& info, bool bRedrawUpdate)
 
 void ProgressDialog::setMaxNofSteps(const quint64 maxNofSteps)
 {
+    if(!isGuiThread())
+        return;
+
     if(m_progressStack.empty() || maxNofSteps == 0)
         return;
 
@@ -237,6 +253,9 @@ void ProgressDialog::setInformationImp(const QString& info)
 
 void ProgressDialog::addNofSteps(const quint64 nofSteps)
 {
+    if(!isGuiThread())
+        return;
+
     if(m_progressStack.empty())
         return;
 
@@ -246,6 +265,10 @@ void ProgressDialog::addNofSteps(const quint64 nofSteps)
 
 void ProgressDialog::step(bool bRedrawUpdate)
 {
+    // A worker would advance whatever level the GUI thread is at, its own levels are never pushed.
+    if(!isGuiThread())
+        return;
+
     if(m_progressStack.empty())
         return;
 
@@ -256,6 +279,9 @@ void ProgressDialog::step(bool bRedrawUpdate)
 
 void ProgressDialog::setCurrent(quint64 subCurrent, bool bRedrawUpdate)
 {
+    if(!isGuiThread())
+        return;
+
     if(m_progressStack.empty())
         return;
 
@@ -267,6 +293,9 @@ void ProgressDialog::setCurrent(quint64 subCurrent, bool bRedrawUpdate)
 
 void ProgressDialog::clear()
 {
+    if(!isGuiThread())
+        return;
+
     if(m_progressStack.empty())
         return;
 
@@ -280,6 +309,9 @@ void ProgressDialog::clear()
 // Requirement: 0 < dMin < dMax < 1
 void ProgressDialog::setRangeTransformation(double dMin, double dMax)
 {
+    if(!isGuiThread())
+        return;
+
     if(m_progressStack.empty())
         return;
 
@@ -291,6 +323,9 @@ void ProgressDialog::setRangeTransformation(double dMin, double dMax)
 
 void ProgressDialog::setSubRangeTransformation(double dMin, double dMax)
 {
+    if(!isGuiThread())
+        return;
+
     if(m_progressStack.empty())
         return;
 
@@ -14,6 +14,7 @@
 #include "ProgressProxy.h"
 #include "ui_progressdialog.h"
 
+#include <atomic>
 #include <list>
 
 #include <QDialog>
@@ -80,6 +81,7 @@ class ProgressDialog: public QDialog
     void killJob();
 
   private:
+    [[nodiscard]] bool isGuiThread() const { return QThread::currentThread() == m_pGuiThread; }
     void setInformationImp(const QString& info);
     void initConnections();
 
@@ -112,7 +114,7 @@ class ProgressDialog: public QDialog
 
     QElapsedTimer m_t1;
     QElapsedTimer m_t2;
-    bool m_bWasCancelled = false;
+    std::atomic<bool> m_bWasCancelled = false;
     e_CancelReason m_eCancelReason = eNone;
     KJob* m_pJob = nullptr;
     QString m_currentJobInfo; // Needed if the job doesn't stop after a reasonable time.